@@ -7,6 +7,22 @@
 
 #define AT24C32_I2C_ADDR 0x57
 #define AT24C32_START_ADDR 0x0000
+#define AT24C32_PAGE_SIZE  32
+
+/* The Wire TX buffer also holds the 2 address bytes of a write, a full page does not fit in it */
+#ifdef BUFFER_LENGTH
+#define AT24C32_WRITE_CHUNK (BUFFER_LENGTH - 2)
+#else
+#define AT24C32_WRITE_CHUNK (30)
+#endif
+
+/* Memory map, every region starts on its own page */
+#define NVM_PUMP_CYCLES_ADDR (AT24C32_START_ADDR)           /* 2 x PumpCycleTime */
+#define NVM_SCHEDULE_ADDR    (AT24C32_START_ADDR + 0x0020)  /* SCHEDULE_MAX_WINDOWS x ScheduleWindow */
+#define NVM_FLOW_TOTALS_ADDR (AT24C32_START_ADDR + 0x0040)  /* FLOW_NUM_PUMPS x uint32_t liters */
+#define NVM_CRASH_ADDR       (AT24C32_START_ADDR + 0x0060)  /* Last CrashRecord and uint16_t crash count */
+#define NVM_BLACKBOX_ADDR    (AT24C32_START_ADDR + 0x0080)  /* BlackBoxHeader and BLACKBOX_RING_ENTRIES x BlackBoxRun, up to 0x017F */
+#define NVM_DEMAND_PROFILE_ADDR (AT24C32_START_ADDR + 0x0180)  /* DemandProfileImage, up to 0x01BF */
 
 void I2C_EEPROM_WriteBytes(uint16_t eeaddress, const uint8_t* data, uint16_t length);
 void I2C_EEPROM_ReadBytes(uint16_t eeaddress, uint8_t* data, uint16_t length);
@@ -0,0 +1,23 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <Arduino.h>
+
+/* The ADC runs free at 125 kHz (prescaler 128), about 9600 conversions per second shared by the channels */
+#define ADC_SAMPLER_MAX_CHANNELS (2)
+#define ADC_SAMPLER_OVERSAMPLE   (64)  /* Conversions summed into one decimated block */
+#define ADC_SAMPLER_RING_SIZE    (8)   /* Blocks kept per channel, power of two */
+#define ADC_SAMPLER_NO_CHANNEL   (0xFF)
+
+/* Sums of the samples of one or more decimated blocks */
+struct AdcSums {
+    uint32_t sum;
+    uint32_t sumSq;
+    uint16_t count;
+};
+
+uint8_t AdcSampler_AddChannel(uint8_t pin);
+void AdcSampler_Begin();
+void AdcSampler_GetSums(uint8_t index, AdcSums &sums);
+
+#endif
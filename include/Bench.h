@@ -0,0 +1,56 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+#include "utilities.h"
+
+/* Cycle counting instrumentation, set by the bench build environment. The same image runs on a board
+ * or under simavr and prints a JSON report on the serial port every BENCH_REPORT_MS */
+#ifndef BENCH_ENABLED
+#define BENCH_ENABLED (0)
+#endif
+
+#if BENCH_ENABLED && !SERIAL_LOG_ENABLED
+#error "The benchmark report is printed on the serial port, it cannot be built with a bus on the USART"
+#endif
+
+#define BENCH_REPORT_MS (5000UL)
+
+/* Allowed excess of a stage maximum over its budget in Bench.cpp before the report fails */
+#ifndef BENCH_TOLERANCE_PCT
+#define BENCH_TOLERANCE_PCT (10UL)
+#endif
+
+/* Measured stages of the main loop */
+enum BenchStage_t {
+    BENCH_LOOP,           /* Whole loop iteration without the idle sleep, its maximum is the worst-case latency */
+    BENCH_POLL_SENSORS,
+    BENCH_CONTROL_TICK,
+    BENCH_BUTTONS,        /* Button events and the menu updates they trigger */
+    BENCH_RENDER,         /* Display frame */
+    BENCH_NVM_SAVE,       /* Deferred EEPROM saves */
+    BENCH_MODE_SELECTION, /* Kernels, one measurement per call */
+    BENCH_CTRL_SENSORS,
+    BENCH_CTRL_TIMER,
+    BENCH_SENSOR_POLL,    /* DigitalSensor::PollSensorState() */
+    BENCH_FORMAT_DATETIME,
+    BENCH_STAGE_COUNT
+};
+
+#if BENCH_ENABLED
+#define BENCH_BEGIN(stage)  uint32_t benchStart_##stage = Bench_Cycles()
+#define BENCH_END(stage)    Bench_Record(stage, Bench_Cycles() - benchStart_##stage)
+#define BENCH_I2C_BYTES(n)  Bench_CountI2cBytes(n)
+#else
+#define BENCH_BEGIN(stage)
+#define BENCH_END(stage)
+#define BENCH_I2C_BYTES(n)
+#endif
+
+void Bench_Begin();
+uint32_t Bench_Cycles();
+void Bench_Record(BenchStage_t stage, uint32_t cycles);
+void Bench_CountI2cBytes(uint16_t bytes);
+void Bench_Report(uint32_t nowMs);
+
+#endif
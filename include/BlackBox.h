@@ -0,0 +1,80 @@
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+#include <Arduino.h>
+
+#define BLACKBOX_RING_ENTRIES  (96)      /* Runs kept in SRAM, 2 bytes each */
+#define BLACKBOX_TICK_MS       (50UL)    /* Resolution of the run lengths, the fastest sensor poll */
+#define BLACKBOX_POST_MS       (60000UL) /* Recorded after a trigger before the ring is saved */
+#define BLACKBOX_MAGIC         (0xB10C)
+
+/* Bits of a sample, one per poll */
+#define BLACKBOX_WELL_EMPTY    (0x01)
+#define BLACKBOX_CISTERN_EMPTY (0x02)
+#define BLACKBOX_PUMP1_ON      (0x04)
+#define BLACKBOX_PUMP2_ON      (0x08)
+#define BLACKBOX_FAULT         (0x10)   /* Sensor plausibility fault latched */
+#define BLACKBOX_NO_FLOW       (0x20)   /* Pump energized without flow */
+#define BLACKBOX_MANUAL_MODE   (0x40)
+#define BLACKBOX_BUTTON        (0x80)   /* Mode or pump selection button pressed */
+
+enum BlackBoxCause_t {
+    BLACKBOX_CAUSE_NONE,
+    BLACKBOX_CAUSE_FAULT,
+    BLACKBOX_CAUSE_DRY_RUN,
+    BLACKBOX_CAUSE_MANUAL
+};
+
+/* Run of identical samples: the sample and how long it lasted in BLACKBOX_TICK_MS, stored as is in the EEPROM */
+struct BlackBoxRun {
+    uint8_t sample;
+    uint8_t ticks;
+};
+
+/* Stored in the EEPROM in front of the runs, oldest run first */
+struct BlackBoxHeader {
+    uint16_t magic;
+    uint16_t seq;            /* Incidents recorded since the EEPROM was erased */
+    uint8_t cause;           /* BlackBoxCause_t */
+    uint8_t runCount;
+    uint8_t preRunCount;     /* Runs before the trigger */
+    uint8_t reserved;
+    uint32_t triggerTime;    /* Unix time of the trigger */
+    uint32_t triggerMs;      /* millis() at the trigger */
+};
+
+/**
+ * Flight recorder of the sensor poll. Every poll snapshot is run-length encoded in an SRAM
+ * ring, so minutes of stable levels take a few runs. On a trigger the recording goes on for
+ * BLACKBOX_POST_MS, or until half of the ring holds runs after the trigger, then the ring is
+ * frozen until Save() copies it to the EEPROM, from where Report() prints it on serial.
+ */
+class BlackBox
+{
+private:
+    BlackBoxRun ring[BLACKBOX_RING_ENTRIES];
+    uint8_t head = 0;          /* Next run written */
+    uint8_t count = 0;
+    uint8_t postCount = 0;     /* Runs closed since the trigger */
+    bool started = false;
+    uint8_t sample = 0;        /* Sample of the open run */
+    uint32_t runStartMs = 0;
+    uint8_t cause = BLACKBOX_CAUSE_NONE;
+    uint32_t triggerMs = 0;
+    bool savePending = false;
+    uint16_t seq = 0;
+
+    void CloseRun(uint8_t ticks);
+    void EndCapture(uint32_t nowMs);
+public:
+    void Load();
+    void Record(uint8_t newSample, uint32_t nowMs);
+    bool Trigger(BlackBoxCause_t reason, uint32_t nowMs);
+    bool isCapturing();
+    bool isSavePending();
+    void Save(uint32_t unixTime, uint32_t nowMs);
+    void Report();
+    static const char *getCauseName(uint8_t cause);
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef BUTTON_EVENTS_H
+#define BUTTON_EVENTS_H
+
+#include <Arduino.h>
+#include "Sensors.h"
+
+#define BUTTON_EVENTS_QUEUE_SIZE   (16)   /* Must be a power of two */
+#define BUTTON_EVENTS_MAX_BUTTONS  (8)
+
+#define BUTTON_LONG_PRESS_MS       (1000) /* Hold time that raises a long-press event */
+#define BUTTON_REPEAT_DELAY_MS     (500)  /* Hold time before the first auto-repeat */
+#define BUTTON_REPEAT_SLOW_MS      (250)  /* Auto-repeat period for the first repeats */
+#define BUTTON_REPEAT_MEDIUM_MS    (100)  /* Auto-repeat period after BUTTON_REPEAT_SLOW_COUNT repeats */
+#define BUTTON_REPEAT_FAST_MS      (50)   /* Auto-repeat period after BUTTON_REPEAT_MEDIUM_COUNT repeats */
+#define BUTTON_REPEAT_SLOW_COUNT   (4)
+#define BUTTON_REPEAT_MEDIUM_COUNT (14)
+
+/* Navigation push buttons, in the order they are registered to ButtonEvents */
+enum ButtonId_t {
+    BTN_UP,
+    BTN_DOWN,
+    BTN_LEFT,
+    BTN_RIGHT,
+    BTN_OK,
+    BTN_ESC,
+    BTN_NONE
+};
+
+enum ButtonEventType_t {
+    BTN_EVT_PRESS,      /* Debounced rising edge */
+    BTN_EVT_RELEASE,    /* Debounced falling edge */
+    BTN_EVT_LONG_PRESS, /* Button held for BUTTON_LONG_PRESS_MS, raised once per press */
+    BTN_EVT_REPEAT      /* Button held, raised with an accelerating period */
+};
+
+struct ButtonEvent {
+    uint8_t button; /* ButtonId_t */
+    uint8_t type;   /* ButtonEventType_t */
+};
+
+/**
+ * Turns the debounced levels of a set of DigitalSensor push buttons into a queue of
+ * press, release, long-press and auto-repeat events. Events are queued until the menu
+ * code drains them, so no press is lost regardless of how often the display is refreshed.
+ */
+class ButtonEvents
+{
+private:
+    struct ButtonTrack {
+        uint32_t pressTime;
+        uint32_t nextRepeatTime;
+        uint8_t repeatCount;
+        bool prevState;
+        bool longPressSent;
+    };
+
+    DigitalSensor *const *buttons;
+    uint8_t numButtons;
+    uint8_t repeatMask;
+    ButtonTrack track[BUTTON_EVENTS_MAX_BUTTONS];
+    ButtonEvent queue[BUTTON_EVENTS_QUEUE_SIZE];
+    uint8_t head = 0;
+    uint8_t tail = 0;
+    uint8_t droppedCount = 0;
+
+    void PushEvent(uint8_t button, ButtonEventType_t type);
+    uint16_t RepeatPeriod(uint8_t repeatCount);
+public:
+    ButtonEvents(DigitalSensor *const *buttons, uint8_t numButtons, uint8_t repeatMask);
+    void UpdateEvents(uint32_t nowMs);
+    bool PopEvent(ButtonEvent &event);
+    bool isEmpty();
+    uint8_t getDroppedCount();
+};
+
+#endif
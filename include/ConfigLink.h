@@ -0,0 +1,90 @@
+#ifndef CONFIG_LINK_H
+#define CONFIG_LINK_H
+
+#include <stdint.h>
+
+/* Frame processing only, without any hardware access, so the host provisioning tool builds it too.
+ * Frame: CONFIG_LINK_SYNC1, CONFIG_LINK_SYNC2, command, payload length, payload, CRC-16 (Modbus, low
+ * byte first) of the command, length and payload. The sync bytes are not ASCII, so the frames can
+ * share the port with the text log. A response carries the command | CONFIG_CMD_RESPONSE, and a
+ * payload made of a CONFIG_STATUS_* byte followed by the data of the command */
+#define CONFIG_LINK_SYNC1        (0xA5)
+#define CONFIG_LINK_SYNC2        (0x5A)
+#define CONFIG_LINK_PAYLOAD_MAX  (32)
+#define CONFIG_LINK_FRAME_MAX    (CONFIG_LINK_PAYLOAD_MAX + 6)
+#define CONFIG_LINK_TIMEOUT_MS   (500UL)    /* A frame not completed within this time is dropped */
+
+#define CONFIG_CMD_READ          (0x01)     /* No payload, answered with the ConfigImage stored in the EEPROM */
+#define CONFIG_CMD_WRITE         (0x02)     /* ConfigImage, applied and saved to the EEPROM */
+#define CONFIG_CMD_SET_TIME      (0x03)     /* uint32_t local time in seconds since 1970, little endian */
+#define CONFIG_CMD_RESPONSE      (0x80)
+
+#define CONFIG_STATUS_OK         (0x00)
+#define CONFIG_STATUS_BAD_CRC    (0x01)
+#define CONFIG_STATUS_BAD_LENGTH (0x02)
+#define CONFIG_STATUS_BAD_VALUE  (0x03)
+#define CONFIG_STATUS_BAD_CMD    (0x04)
+#define CONFIG_STATUS_VERSION    (0x05)     /* Image of another firmware version */
+
+#define CONFIG_IMAGE_VERSION     (1)
+#define CONFIG_NUM_PUMPS         (2)
+#define CONFIG_NUM_WINDOWS       (4)        /* SCHEDULE_MAX_WINDOWS */
+#define CONFIG_TIME_MIN          (946684800UL)  /* 2000-01-01, the DS3231 range */
+#define CONFIG_TIME_MAX          (4102444799UL) /* 2099-12-31 23:59:59 */
+
+/* Complete configuration of a board, same fields as PumpCycleTime and ScheduleWindow */
+struct ConfigImage {
+    uint8_t version;
+    struct {
+        uint8_t hour;
+        uint8_t minute;
+        uint8_t second;
+    } cycles[CONFIG_NUM_PUMPS];
+    struct {
+        uint8_t days;         /* Bit 0 = Sunday .. bit 6 = Saturday, 0 = window not used */
+        uint8_t startHour;
+        uint8_t startMinute;
+        uint8_t endHour;
+        uint8_t endMinute;
+    } windows[CONFIG_NUM_WINDOWS];
+};
+
+/**
+ * Access to the configuration of the application. The image read is the one stored in the
+ * EEPROM, so reading it back after a write verifies what the board will start with.
+ */
+struct ConfigLinkHandlers {
+    void (*readImage)(ConfigImage &image);
+    void (*writeImage)(const ConfigImage &image);  /* Called with a validated image */
+    void (*setTime)(uint32_t localTime);           /* Called with a validated time */
+};
+
+enum ConfigLinkResult_t {
+    CONFIG_LINK_NONE,     /* Frame not complete yet */
+    CONFIG_LINK_FRAME,    /* Frame received */
+    CONFIG_LINK_BAD_CRC   /* Frame received with a bad CRC */
+};
+
+/**
+ * Finds the frames in a byte stream, the bytes outside of a frame are skipped. The command and
+ * payload of a received frame stay valid until the next byte is fed.
+ */
+class ConfigLinkParser
+{
+private:
+    uint8_t frame[CONFIG_LINK_FRAME_MAX];
+    uint8_t length = 0;
+    uint32_t lastByteMs = 0;
+public:
+    ConfigLinkResult_t Feed(uint8_t byte, uint32_t nowMs);
+    uint8_t getCommand() const;
+    uint8_t getPayloadLength() const;
+    const uint8_t *getPayload() const;
+};
+
+uint8_t ConfigLink_BuildFrame(uint8_t command, const uint8_t *payload, uint8_t payloadLength, uint8_t *frame);
+uint8_t ConfigLink_ValidateImage(const ConfigImage &image);
+uint8_t ConfigLink_HandleFrame(const ConfigLinkHandlers &handlers, const ConfigLinkParser &parser, ConfigLinkResult_t result,
+                               uint8_t *response);
+
+#endif
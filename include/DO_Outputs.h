@@ -10,6 +10,7 @@ private:
 public:
     DO_Outputs(uint8_t pin); 
     void setOutputPin(bool state);
+    bool getOutputPin();
     uint8_t getPin();
 };
 
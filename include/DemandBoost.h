@@ -0,0 +1,34 @@
+#ifndef DEMAND_BOOST_H
+#define DEMAND_BOOST_H
+
+#include <Arduino.h>
+#include "PumpStats.h"
+
+#define BOOST_DEADLINE_S           (0UL)     /* Fixed boost deadline in seconds of pumping, 0 to learn it from the single pump fills */
+#define BOOST_SIGMA                (2)       /* Learned deadline is the mean fill time plus N standard deviations */
+#define BOOST_MIN_SAMPLES          (5)       /* Single pump fills required before the learned deadline replaces the bootstrap one */
+#define BOOST_BOOTSTRAP_DEADLINE_S (1800UL)  /* Deadline used until enough fills were recorded */
+#define BOOST_MIN_DEADLINE_S       (60UL)    /* Shortest deadline allowed */
+
+/**
+ * Decides when the automatic modes run both pumps. A fill that is still going after the
+ * deadline means the cistern is being drained faster than one pump fills it, so the idle
+ * pump is requested too until the cistern is full. The deadline is learned from the
+ * pumping time of the fills done by a single pump, unless BOOST_DEADLINE_S sets it.
+ */
+class DemandBoost
+{
+private:
+    RunningStats fillHistory;   /* Seconds of pumping per single pump fill */
+    bool filling = false;
+    bool active = false;
+    uint32_t pumpingMs = 0;
+    uint32_t lastTickMs = 0;
+public:
+    void Update(bool fillDemand, bool anyPumpOn, uint32_t nowMs);
+    void Abort();
+    bool isActive();
+    uint32_t getDeadlineSeconds();
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef DEMAND_PROFILE_H
+#define DEMAND_PROFILE_H
+
+#include <Arduino.h>
+
+#define DEMAND_HOURS                  (24)
+#define DEMAND_EMA_SHIFT              (2)     /* Day to day weight of each hour: 1 / (1 << shift) */
+#define DEMAND_EVENT_SCALE            (16)    /* Empty events per hour are kept in 1/16 */
+#define DEMAND_MAX_EVENTS             (15)    /* Empty events counted in one hour */
+#define DEMAND_DRAIN_MIN_MINUTES      (10)    /* Pumps off time needed in an hour to measure its drain rate */
+#define DEMAND_MAGIC                  (0xDE11)
+
+#define PREFILL_LOOKAHEAD_H           (2)     /* Hours of demand filled ahead */
+#define PREFILL_SCHEDULE_LOOKAHEAD_H  (8)     /* With pumping windows the peak may be outside of them, so the window fills further ahead */
+#define PREFILL_MIN_EVENTS            (16)    /* Empty events expected in the lookahead that make a peak, in 1/DEMAND_EVENT_SCALE */
+#define PREFILL_MIN_DRAIN_PCT         (30)    /* Level drop expected in the lookahead that makes a peak */
+#define PREFILL_START_PCT             (70)    /* A top-up starts below this level, above the low mark of the float switch */
+#define PREFILL_TARGET_PCT            (90)    /* and ends at this level, at or below the high mark of the float switch */
+#define PREFILL_FLOAT_TOLERANCE_PCT   (10)    /* Level error allowed when the float switch flips at its high mark */
+
+/* Stored in the EEPROM as is */
+struct DemandProfileImage {
+    uint16_t magic;
+    uint8_t emptyEvents[DEMAND_HOURS];   /* Cistern empty events of each hour of the day, in 1/DEMAND_EVENT_SCALE */
+    uint8_t drainPct[DEMAND_HOURS];      /* Level drop of each hour of the day with the pumps off, in %/h */
+};
+
+/**
+ * Learns when the water is used from the RTC hour: the cistern empty events and the drain rate of
+ * each hour of the day are averaged over the days and persisted in the EEPROM. When a peak is
+ * expected in the next hours the cistern is topped up from the level transducer beforehand, so the
+ * pumps are not catching up while the cistern is empty. The empty events become rare once the
+ * top-ups work, the drain rates keep the prediction.
+ * The float switch reads empty from its low mark and full again from its high mark, so it reads
+ * full during a top-up. The transducer is checked against it each time it flips, and top-ups are
+ * only requested while the last check agreed.
+ */
+class DemandProfile
+{
+private:
+    DemandProfileImage profile;
+    int8_t hour = -1;            /* Hour being measured, -1 until the first MinuteTick() */
+    uint8_t events = 0;          /* Empty events of the current hour */
+    uint16_t drainPct = 0;       /* Level drop of the current hour with the pumps off */
+    uint8_t offMinutes = 0;      /* Minutes of the current hour with the pumps off and a valid level */
+    uint8_t lastLevelPct = 0;
+    bool levelTracked = false;
+    bool cisternWasEmpty = false;
+    uint32_t lastUpdateMs = 0;
+    uint32_t emptyMs = 0;        /* Time with the cistern empty since the last save */
+    bool peakAhead = false;
+    bool prefilling = false;
+    bool levelPlausible = false;  /* The level agreed with the last float switch flip */
+    bool floatSeen = false;
+    bool floatWasEmpty = false;
+    bool savePending = false;
+
+    void CloseHour();
+    static uint8_t Average(uint8_t average, uint8_t sample);
+public:
+    DemandProfile();
+    void Load();
+    void Save();
+    bool isSavePending();
+    void Update(bool cisternEmpty, uint32_t nowMs);
+    void MinuteTick(uint8_t nowHour, bool pumpsOn, bool levelValid, uint8_t levelPct, bool scheduleEnabled);
+    bool UpdatePrefill(bool levelValid, uint8_t levelPct, bool cisternEmpty);
+    bool isPeakAhead();
+    bool isPrefilling();
+    void Report();
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stdint.h>
+
+/* Latency tracing only, without any hardware access, so it also builds on a PC.
+ * Histogram bin i counts the latencies below TRACE_BIN0_MS << i, the last bin the longer ones */
+#define TRACE_HIST_BINS    (12)
+#define TRACE_BIN0_MS      (16UL)
+#define TRACE_TIMEOUT_MS   (60000UL)  /* Edge without reaction this long is counted as unanswered */
+
+/* Traced input edges, every control mode stops the pumps running at the edge */
+enum TraceEvent_t {
+    TRACE_CISTERN_FULL,   /* Overflow protection */
+    TRACE_WELL_EMPTY,     /* Dry run protection */
+    TRACE_EVENT_COUNT
+};
+
+/* A traced edge and the time until the outputs reacted */
+struct TraceRecord {
+    uint16_t seq;
+    uint8_t event;
+    uint32_t latencyMs;
+};
+
+/**
+ * Measures the time from a sensor edge seen by the poll to the pump outputs written by the control
+ * tick. Each edge gets a sequence number and is closed when every pump running at the edge was
+ * switched off, or dropped if the sensor reverts first. The latencies are kept in a histogram per
+ * event, with the worst case seen.
+ */
+class EventTrace
+{
+private:
+    struct PendingEdge {
+        uint16_t seq;
+        uint32_t edgeMs;
+        uint8_t pumps;    /* Bit per pump running at the edge, 0 = no edge open */
+    };
+    PendingEdge pending[TRACE_EVENT_COUNT];
+    uint16_t histogram[TRACE_EVENT_COUNT][TRACE_HIST_BINS];
+    uint32_t maxMs[TRACE_EVENT_COUNT];
+    uint16_t unanswered[TRACE_EVENT_COUNT];
+    bool prevActive[TRACE_EVENT_COUNT];
+    bool initialized = false;
+    uint16_t nextSeq = 0;
+    TraceRecord completed[TRACE_EVENT_COUNT];
+    uint8_t completedMask = 0;    /* Bit per event with a record not taken yet */
+
+    void Edge(uint8_t event, bool active, uint8_t pumpsOn, uint32_t nowMs);
+public:
+    EventTrace();
+    void Inputs(bool cisternFull, bool wellEmpty, uint8_t pumpsOn, uint32_t nowMs);
+    void Outputs(uint8_t pumpsOn, uint32_t nowMs);
+    bool TakeCompleted(TraceRecord &record);
+    uint16_t getBinCount(uint8_t event, uint8_t bin);
+    uint32_t getMaxMs(uint8_t event);
+    uint16_t getUnanswered(uint8_t event);
+    static const char *getEventName(uint8_t event);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FLOW_METER_H
+#define FLOW_METER_H
+
+#include <Arduino.h>
+
+#define FLOW_NUM_PUMPS          (2)
+#define FLOW_PULSES_PER_LITER   (450UL)    /* YF-S201 hall-effect meter: 7.5 Hz per L/min */
+#define FLOW_NO_FLOW_TIMEOUT_MS (10000UL)  /* A pump energized this long without pulses is running dry or against a closed valve */
+#define FLOW_RATE_EMA_SHIFT     (2)        /* Flow rate average weight: 1 / (1 << shift) */
+
+/**
+ * Hall-effect flow meter on the pump outlet. The pulses are counted by a pin change interrupt
+ * and converted on every control tick into the flow rate and the liters pumped by each pump,
+ * which are persisted in the EEPROM. A pump that is energized without any flow is reported so
+ * it can be shut off before it burns.
+ */
+class FlowMeter
+{
+private:
+    uint8_t pin;
+    uint32_t liters[FLOW_NUM_PUMPS];
+    uint16_t pulseRemainder[FLOW_NUM_PUMPS];  /* Pulses not yet counted as a whole liter */
+    uint32_t rateMlPerMin = 0;
+    uint32_t lastTickMs = 0;
+    uint32_t lastFlowMs = 0;                  /* Last pulse, or last time the pumps were energized */
+    bool pumpsWereOn = false;
+    bool noFlow = false;
+    bool litersChanged = false;
+    bool savePending = false;
+    uint8_t version = 0;
+
+    void AddPulses(uint8_t pump, uint16_t pulses);
+public:
+    FlowMeter(uint8_t pin);
+    void begin();
+    void Update(bool pump1On, bool pump2On, uint32_t nowMs);
+    bool isNoFlow();
+    uint32_t getRateMlPerMin();
+    uint32_t getLiters(uint8_t pump);
+    uint8_t getVersion();
+    void Load();
+    void Save();
+    bool isSavePending();
+};
+
+#endif
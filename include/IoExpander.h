@@ -0,0 +1,33 @@
+#ifndef IO_EXPANDER_H
+#define IO_EXPANDER_H
+
+#include <Arduino.h>
+
+/* I2C port expanders seen as extra pins: pin numbers from IO_EXPANDER_FIRST_PIN up are not native,
+ * DI_Inputs and DO_Outputs read and write them through the images of the expander ports */
+#define IO_EXPANDER_FIRST_PIN       (64)
+#define IO_EXPANDER_PINS_PER_DEVICE (16)
+#define IO_EXPANDER_MAX_DEVICES     (4)
+#define IO_EXPANDER_NONE            (0xFF)
+#define IO_EXPANDER_NO_INT_PIN      (0xFF)  /* Inputs read on every update instead of on change */
+
+/* Pin number of a bit of an expander, devices are numbered in the order they are added */
+#define IO_EXP_PIN(device, bit) (IO_EXPANDER_FIRST_PIN + (device) * IO_EXPANDER_PINS_PER_DEVICE + (bit))
+
+enum IoExpanderType_t {
+    IO_EXPANDER_MCP23017,  /* 16 pins, ports A (bits 0-7) and B (bits 8-15) */
+    IO_EXPANDER_PCF8574    /* 8 quasi-bidirectional pins, bits 0-7 */
+};
+
+bool IoExpander_IsExpanderPin(uint8_t pin);
+uint8_t IoExpander_Add(IoExpanderType_t type, uint8_t i2cAddr);
+void IoExpander_ConfigurePin(uint8_t pin, bool output);
+void IoExpander_Begin(uint8_t intPin);
+void IoExpander_Update();
+void IoExpander_Flush();
+bool IoExpander_ReadPin(uint8_t pin);
+void IoExpander_WritePin(uint8_t pin, bool state);
+bool IoExpander_GetOutput(uint8_t pin);
+uint16_t IoExpander_GetErrorCount();
+
+#endif
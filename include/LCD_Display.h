@@ -2,8 +2,8 @@
 #define LCD_DISPLAY_H
 
 #include <Arduino.h>
-#include <LiquidCrystal_I2C.h>
 #include <Wire.h>
+#include "PCF8574_Lcd.h"
 
 #define LCD_DISPLAY_I2C_ADDR 0x27 
 #define LCD_DISPLAY_COLS 16       
@@ -11,15 +11,18 @@
 
 class LCD_Display {
 private:
-    LiquidCrystal_I2C lcd;
+    PCF8574_Lcd lcd;
 public:
     LCD_Display(uint8_t lcdAddr, uint8_t lcdCols, uint8_t lcdRows)
         : lcd(lcdAddr, lcdCols, lcdRows) {}
     void init();
     void clearScreen();
     void PrintMessage(const String &message, uint8_t col = 0, uint8_t row = 0);
+    void PrintMessage(const char *message, uint8_t col = 0, uint8_t row = 0);
     void PrintMessage(int value, uint8_t col = 0, uint8_t row = 0);
     void setCursor(uint8_t col, uint8_t row);
+    void writeRow(uint8_t row, const char *text);
+    void setBacklight(bool on);
 };
 
 #endif
\ No newline at end of file
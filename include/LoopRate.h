@@ -0,0 +1,47 @@
+#ifndef LOOP_RATE_H
+#define LOOP_RATE_H
+
+#include <stdint.h>
+
+/* Sensor poll and control tick periods of each loop rate, in ms. The control tick checks in with
+ * the watchdog, so every control period must stay well below its 2 s timeout */
+#define LOOP_RATE_ACTIVE_POLL_MS     (50)    /* A pump is energized: well empty and cistern full are acted on at once */
+#define LOOP_RATE_ACTIVE_CONTROL_MS  (200)
+#define LOOP_RATE_ALERT_POLL_MS      (50)    /* A pump start is pending or the user is at the panel */
+#define LOOP_RATE_ALERT_CONTROL_MS   (500)
+#define LOOP_RATE_IDLE_POLL_MS       (100)   /* Pumps off with nothing to fill, still fast enough for a button press */
+#define LOOP_RATE_IDLE_CONTROL_MS    (1000)
+#define LOOP_RATE_HOLD_MS            (5000UL) /* A faster rate is kept this long after its cause cleared */
+
+enum LoopRate_t {
+    LOOP_RATE_ACTIVE,
+    LOOP_RATE_ALERT,
+    LOOP_RATE_IDLE,
+    LOOP_RATE_COUNT
+};
+
+struct LoopPeriods {
+    uint16_t pollMs;
+    uint16_t controlMs;
+};
+
+/**
+ * Picks the sensor poll and control tick periods of the scheduler from the operating state.
+ * A faster rate is taken as soon as its cause appears, and the rate only steps down once the
+ * cause has been gone for LOOP_RATE_HOLD_MS, so a pump that just stopped or a sensor that is
+ * still settling is watched at the faster rate. Also builds on a PC.
+ */
+class LoopRate
+{
+private:
+    LoopRate_t rate = LOOP_RATE_ACTIVE;
+    uint32_t lastCauseMs = 0;   /* Last time the cause of the current rate was seen */
+public:
+    bool Update(bool pumpOn, bool startPending, bool userActive, uint32_t nowMs);
+    LoopRate_t getRate();
+    uint16_t getPollMs();
+    uint16_t getControlMs();
+    static const char *getRateName(uint8_t rate);
+};
+
+#endif
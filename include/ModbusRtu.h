@@ -0,0 +1,42 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stdint.h>
+
+/* Frame processing only, without any hardware access, so it also builds on a PC */
+#define MODBUS_FRAME_MAX        (64)   /* Longest frame handled, the standard allows 256 bytes */
+#define MODBUS_BROADCAST_ADDR   (0)
+#define MODBUS_CHAR_BITS        (11)   /* Start, 8 data, parity or second stop, stop */
+#define MODBUS_FAST_T35_US      (1750) /* Fixed t3.5 above 19200 baud */
+#define MODBUS_FAST_T15_US      (750)  /* Fixed t1.5 above 19200 baud, longest gap allowed inside a frame */
+
+#define MODBUS_FC_READ_HOLDING  (0x03)
+#define MODBUS_FC_READ_INPUT    (0x04)
+#define MODBUS_FC_WRITE_SINGLE  (0x06)
+#define MODBUS_FC_WRITE_MULTI   (0x10)
+
+#define MODBUS_EX_NONE             (0x00)
+#define MODBUS_EX_ILLEGAL_FUNCTION (0x01)
+#define MODBUS_EX_ILLEGAL_ADDRESS  (0x02)
+#define MODBUS_EX_ILLEGAL_VALUE    (0x03)
+
+/**
+ * Register map of the slave. The accessors read and write the live state of the application,
+ * so there is no register image to keep in sync.
+ */
+struct ModbusRegisterMap {
+    uint16_t numHolding;
+    uint16_t numInput;
+    uint16_t (*readHolding)(uint16_t addr);
+    uint16_t (*readInput)(uint16_t addr);
+    uint8_t (*validateHolding)(uint16_t addr, uint16_t value);  /* MODBUS_EX_NONE if the value may be written */
+    void (*writeHolding)(uint16_t addr, uint16_t value);
+    void (*commitWrites)(void);  /* Called once after the registers of a write request were written */
+};
+
+uint32_t ModbusRtu_T35Us(uint32_t baud);
+uint16_t ModbusRtu_Crc16(const uint8_t *data, uint16_t length);
+uint8_t ModbusRtu_HandleFrame(uint8_t slaveAddr, const ModbusRegisterMap &map,
+                              const uint8_t *request, uint8_t requestLength, uint8_t *response);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef MODBUS_UART_H
+#define MODBUS_UART_H
+
+#include <Arduino.h>
+#include "ModbusRtu.h"
+
+/* RTU transport on the USART0 (pins 0/1) with Timer2 measuring the silent interval, used by
+ * the Modbus slave and by the pump coordination bus. It replaces HardwareSerial, so Serial
+ * must not be used while it is running */
+#define MODBUS_UART_NO_DE_PIN     (0xFF)  /* RS-485 module with automatic direction control */
+#define MODBUS_UART_TIMER_TICK_US (16)    /* Timer2 prescaler 256 */
+
+void ModbusUart_Begin(uint32_t baud, uint8_t dePin);
+uint8_t ModbusUart_TakeFrame(uint8_t *frame);
+void ModbusUart_ReleaseFrame();
+void ModbusUart_Send(const uint8_t *data, uint8_t length);
+uint16_t ModbusUart_GetErrorCount();
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef PCF8574_LCD_H
+#define PCF8574_LCD_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+/* PCF8574 port bits wired to the HD44780 on the common I2C LCD backpacks */
+#define PCF8574_LCD_RS (0x01)
+#define PCF8574_LCD_RW (0x02)
+#define PCF8574_LCD_EN (0x04)
+#define PCF8574_LCD_BL (0x08)
+
+#define PCF8574_LCD_MAX_COLS (20)
+#define PCF8574_LCD_MAX_ROWS (4)
+
+/* Bytes per Wire transmission; the AVR TwoWire buffer holds BUFFER_LENGTH (32) bytes */
+#ifdef BUFFER_LENGTH
+#define PCF8574_LCD_TX_SIZE (BUFFER_LENGTH)
+#else
+#define PCF8574_LCD_TX_SIZE (32)
+#endif
+
+/**
+ * HD44780 driver over a PCF8574 I2C expander in 4-bit mode.
+ * Every nibble is sent as two port writes (EN high, EN low) and the port writes of
+ * consecutive characters are packed into as few Wire transmissions as the buffer allows.
+ * A shadow copy of the display is kept so writeRow() only sends the characters that changed.
+ */
+class PCF8574_Lcd
+{
+private:
+    uint8_t addr;
+    uint8_t cols;
+    uint8_t rows;
+    uint8_t backlightMask = PCF8574_LCD_BL;
+    uint8_t txBuf[PCF8574_LCD_TX_SIZE];
+    uint8_t txLen = 0;
+    char shadow[PCF8574_LCD_MAX_ROWS][PCF8574_LCD_MAX_COLS];
+    uint8_t cursorCol = 0;
+    uint8_t cursorRow = 0;
+
+    void QueueNibble(uint8_t nibble, uint8_t mode);
+    void QueueByte(uint8_t value, uint8_t mode);
+    void Flush();
+    void WriteNibbleNow(uint8_t nibble);
+    void Command(uint8_t cmd);
+public:
+    PCF8574_Lcd(uint8_t lcdAddr, uint8_t lcdCols, uint8_t lcdRows);
+    void begin();
+    void clear();
+    void setCursor(uint8_t col, uint8_t row);
+    void setBacklight(bool on);
+    void write(const char *text);
+    void writeRow(uint8_t row, const char *text);
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef PIN_CHANGE_INT_H
+#define PIN_CHANGE_INT_H
+
+#include <Arduino.h>
+
+/* Port B pin change interrupts: D8..D13 are PCINT0..PCINT5, served by the PCINT0 vector */
+#define PIN_CHANGE_FIRST_PIN (8)
+#define PIN_CHANGE_NUM_PINS  (6)
+
+/* Called from the interrupt with the new level of the pin, must be short */
+typedef void (*PinChangeCallback_t)(bool level);
+
+bool PinChange_Attach(uint8_t pin, PinChangeCallback_t callback);
+void PinChange_Detach(uint8_t pin);
+
+#endif
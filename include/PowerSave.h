@@ -0,0 +1,19 @@
+#ifndef POWER_SAVE_H
+#define POWER_SAVE_H
+
+#include <Arduino.h>
+
+/* Supply current of the board in each state, used with the measured time in each state to report
+ * the average draw. Defaults for a Nano at 16 MHz and 5 V, calibrate them with a meter */
+#define POWER_ACTIVE_UA    (19000UL)  /* CPU running */
+#define POWER_IDLE_UA      (12000UL)  /* CPU in idle sleep, timers, ADC and USART running */
+#define POWER_BACKLIGHT_UA (22000UL)  /* LCD backlight on */
+
+#define POWER_WINDOW_MS    (10000UL)  /* The average is computed over windows of this length */
+
+void PowerSave_Idle();
+void PowerSave_Update(bool backlightOn, uint32_t nowMs);
+uint16_t PowerSave_GetAwakePermille();
+uint16_t PowerSave_GetAverageCurrentX10Ma();
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef PUMP_CONTROL_H
+#define PUMP_CONTROL_H
+
+#include <Arduino.h>
+#include "WellRecovery.h"
+#include "DemandBoost.h"
+#include "PumpStats.h"
+
+enum CtrlModeSel_t {
+    CTRL_AUTO_BY_SENSORS,/* Setting selected using mode's push button */
+    CTRL_MODE_MANUAL,    /* Setting selected using mode's push button */
+    CTRL_AUTO_BY_TIMER   /* Setting selected using display interfaces */
+};
+
+/* Manual activation of each pump using pump's push button */
+enum ManualPumpSel_t {
+    SELECT_PUMP_NONE,
+    SELECT_PUMP_1,
+    SELECT_PUMP_2,
+    SELECT_PUMP_BOTH
+};
+
+#define PUMP_CONTROL_NUM_PUMPS        (2)
+#define PUMP_CONTROL_NOT_COORDINATED  (0xFF)
+#define PUMP_PREFILL_MAX_MS           (300000UL)  /* Longest top-up per float cycle, below the time a pump takes to fill the headroom above the float high mark */
+
+/* Inputs of a control tick, read by the caller from the sensors and the other modules */
+struct PumpControlInputs {
+    bool wellEmpty;
+    bool cisternEmpty;
+    bool pumpSelButton;      /* Manual pump selection button pressed */
+    bool fault;              /* Sensor plausibility fault latched */
+    bool scheduleAllowed;    /* Pumping allowed by the schedule */
+    uint8_t coordAssigned;   /* Bit per pump assigned by the coordinator, PUMP_CONTROL_NOT_COORDINATED if not coordinated */
+    bool prefill;            /* Top up the cistern ahead of a demand peak, the caller ends it at the target level or on an implausible level */
+};
+
+/**
+ * Decides the pump outputs of every control tick in the manual, sensors and timer modes.
+ * The state of each mode is kept in the object, so the decisions only depend on its inputs
+ * and the time, and a new object starts from the power-up state. The caller writes the
+ * outputs from isPumpOn() after each tick.
+ */
+class PumpControl
+{
+private:
+    WellRecovery &wellRecovery;
+    DemandBoost &demandBoost;
+    PumpStats &pumpStats;
+    bool pumpOn[PUMP_CONTROL_NUM_PUMPS] = {false, false};
+
+    /* Mode selection */
+    bool prevModeButton = false;
+    CtrlModeSel_t prevAutoMode = CTRL_AUTO_BY_SENSORS;
+
+    /* Manual mode */
+    bool prevPumpSelButton = false;
+    ManualPumpSel_t manualSel = SELECT_PUMP_NONE;
+
+    /* Pump alternation and fill tracking of the sensors and timer modes */
+    struct FillState {
+        bool usePump1 = true;
+        bool waitingForFull = false;
+        bool lastCisternWasFull = true;
+        bool pumpPausedByWell = false;
+        bool prefilling = false;     /* Sensors mode only, the fill is a top-up */
+        bool prefillSpent = false;   /* Sensors mode only, the top-up of this float cycle was done */
+        uint32_t prefillStartMs = 0; /* Sensors mode only */
+        uint32_t lastSwitchMs = 0;   /* Timer mode only */
+    };
+    FillState sensorsMode;
+    FillState timerMode;
+
+    void RunManual(const PumpControlInputs &in);
+    void RunBySensors(const PumpControlInputs &in, uint32_t nowMs);
+    void RunByTimer(const PumpControlInputs &in, const uint32_t cycleBudgetsMs[PUMP_CONTROL_NUM_PUMPS], uint32_t nowMs);
+    void RunSafeState(uint32_t nowMs);
+public:
+    PumpControl(WellRecovery &wellRecovery, DemandBoost &demandBoost, PumpStats &pumpStats);
+    CtrlModeSel_t SelectMode(CtrlModeSel_t mode, bool modeButton);
+    CtrlModeSel_t Tick(CtrlModeSel_t mode, const PumpControlInputs &in,
+                       const uint32_t cycleBudgetsMs[PUMP_CONTROL_NUM_PUMPS], uint32_t nowMs);
+    bool isPumpOn(uint8_t pump);
+};
+
+#endif
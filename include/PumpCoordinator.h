@@ -0,0 +1,81 @@
+#ifndef PUMP_COORDINATOR_H
+#define PUMP_COORDINATOR_H
+
+#include <stdint.h>
+
+/* Protocol only, without any hardware access, so it also builds on a PC. Frames are delimited by
+ * silence and checked with the Modbus CRC, the bus is shared by the boards feeding the same cistern */
+#define COORD_MAX_NODES          (4)       /* Node ids 1..COORD_MAX_NODES, at most 8 */
+#define COORD_MAX_RUNNING_PUMPS  (2)       /* Pumps of all the nodes allowed to run at the same time */
+#define COORD_ROTATE_MIN         (30UL)    /* Runtime lead in minutes that makes a running pump give way to an idle one */
+#define COORD_TOKEN_HOLD_MS      (100UL)   /* Token holder waits this long before passing it, paces the bus */
+#define COORD_REPLY_TIMEOUT_MS   (200UL)   /* Next node silent this long after the token was passed to it is skipped */
+#define COORD_TOKEN_LOST_MS      (1000UL)  /* Bus silent this long, plus one reply timeout per lower node id, regenerates the token */
+#define COORD_NODE_TIMEOUT_MS    (5000UL)  /* Node not heard this long is considered gone */
+#define COORD_LISTEN_MS          (COORD_TOKEN_LOST_MS + COORD_MAX_NODES * COORD_REPLY_TIMEOUT_MS)  /* After a reset the board only listens this long, a live bus passes the token around within it */
+
+#define COORD_MSG_STATUS         (0x41)    /* Modbus user defined function code range */
+#define COORD_FRAME_LEN          (16)
+
+#if COORD_MAX_NODES > 8
+#error "The assignment bitmap holds 2 pumps for at most 8 nodes"
+#endif
+
+/* Status of a node as last heard on the bus */
+struct CoordNode {
+    uint32_t lastHeardMs;
+    uint32_t runtimeMin[2];  /* Minutes each pump ran since the node started */
+    uint8_t flags;
+    bool heard;
+};
+
+/**
+ * Token passing coordination of the pumps of several boards. Only the token holder transmits:
+ * it broadcasts its status and names the next node id, which answers with its own status, so
+ * the bus never has collisions while every node is alive. A node that does not answer is skipped
+ * by the sender, and a lost token is regenerated by the lowest live node id first.
+ * The lowest node id heard is the coordinator: it assigns the pumps to run, at most
+ * COORD_MAX_RUNNING_PUMPS, to the available pumps with the least runtime, preferring wells that
+ * feed no running pump, and starts one more per token round so the motors never start together.
+ * After a reset a board listens silently for COORD_LISTEN_MS with its pumps off, and takes the
+ * assignment of the coordinator it hears, or else the pumps the other nodes report on, so a reset
+ * coordinator carries on with the pumps already running instead of starting more.
+ */
+class PumpCoordinator
+{
+private:
+    uint8_t nodeId;
+    CoordNode nodes[COORD_MAX_NODES];
+    uint16_t assignment = 0;         /* Bit (node id - 1) * 2 + pump */
+    uint32_t lastAssignmentMs = 0;
+    bool assignmentHeard = false;
+    uint32_t runMs[2] = {0, 0};
+    uint32_t lastUpdateMs = 0;
+    uint32_t lastBusMs = 0;
+    uint32_t tokenMs = 0;
+    uint32_t sentMs = 0;
+    uint8_t pendingNext = 0;         /* Node the token was passed to, 0 = none */
+    bool tokenHeld = false;
+    uint32_t startMs = 0;
+    bool started = false;
+    bool listened = false;
+
+    bool isAlive(uint8_t id, uint32_t nowMs);
+    bool isListening(uint32_t nowMs);
+    uint8_t NextNode(uint8_t after);
+    int8_t PickIdlePump(uint16_t available, uint16_t running);
+    uint16_t ComputeAssignment(uint32_t nowMs);
+    uint8_t BuildFrame(uint8_t next, uint32_t nowMs, uint8_t *frame);
+public:
+    PumpCoordinator(uint8_t id);
+    void UpdateLocal(bool fillDemand, bool pump1Available, bool pump2Available, bool pump1On, bool pump2On, uint32_t nowMs);
+    void HandleFrame(const uint8_t *frame, uint8_t length, uint32_t nowMs);
+    uint8_t Poll(uint32_t nowMs, uint8_t *frame);
+    bool isCoordinator(uint32_t nowMs);
+    bool isCoordinated(uint32_t nowMs);
+    bool isAssigned(uint8_t pump);
+    bool isAnyPumpOn(uint32_t nowMs);
+    uint8_t getNodeCount(uint32_t nowMs);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef PUMP_SCHEDULE_H
+#define PUMP_SCHEDULE_H
+
+#include <Arduino.h>
+#include <RTClib.h>
+
+#define SCHEDULE_MAX_WINDOWS       (4)
+#define SCHEDULE_ALL_DAYS          (0x7F)
+#define SCHEDULE_MINUTES_PER_DAY   (1440U)
+#define SCHEDULE_MINUTES_PER_WEEK  (10080U)
+#define SCHEDULE_CRITICAL_EMPTY_MS (3600000UL) /* Cistern empty this long outside the windows is critically low, pumping is allowed until it is full */
+#define SCHEDULE_ALARM_GRACE_MS    (5000UL)    /* The transition is applied this long after it was due if the RTC alarm interrupt was missed */
+
+/* Weekly pumping window, stored as is in the EEPROM */
+struct ScheduleWindow {
+    uint8_t days;         /* Bit 0 = Sunday .. bit 6 = Saturday, 0 = window not used */
+    uint8_t startHour;
+    uint8_t startMinute;
+    uint8_t endHour;      /* End before start crosses midnight, end equal to start is the whole day */
+    uint8_t endMinute;
+};
+
+/**
+ * Confines the automatic modes to weekly pumping windows, e.g. the off-peak electricity hours.
+ * The windows are only scanned when the schedule changes, the clock is set or a transition is
+ * reached: the result is cached and the time of the next transition is programmed in the RTC
+ * alarm, so the control tick only reads a flag. With no window in use pumping is always allowed.
+ */
+class PumpSchedule
+{
+private:
+    ScheduleWindow windows[SCHEDULE_MAX_WINDOWS];
+    bool enabled = false;
+    bool inWindow = true;
+    bool overrideActive = false;
+    bool recomputePending = true;
+    uint32_t recomputeMs = 0;
+    uint32_t nextTransitionMs = 0;   /* Time from recomputeMs to the next transition, 0 = none */
+    uint32_t cisternEmptySinceMs = 0;
+public:
+    PumpSchedule();
+    void Load();
+    void Save();
+    const ScheduleWindow &getWindow(uint8_t index);
+    void setWindow(uint8_t index, const ScheduleWindow &window);
+    void RequestRecompute();
+    bool isRecomputeDue(uint32_t nowMs);
+    bool Recompute(const DateTime &now, uint32_t nowMs, DateTime &nextTransition);
+    bool isPumpingAllowed(bool cisternEmpty, uint32_t nowMs);
+    bool isEnabled();
+    bool isOverrideActive();
+};
+
+#endif
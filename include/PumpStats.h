@@ -0,0 +1,72 @@
+#ifndef PUMP_STATS_H
+#define PUMP_STATS_H
+
+#include <Arduino.h>
+
+#define PUMP_STATS_NUM_PUMPS     (2)
+#define PUMP_STATS_FRAC_BITS     (4)   /* Mean is kept in 1/16 units */
+#define PUMP_STATS_ALARM_SIGMA   (3)   /* Fill time alarm when a sample is further than N standard deviations from the mean */
+#define PUMP_STATS_ALARM_MIN_N   (5)   /* Samples required before the fill time alarm is evaluated */
+
+/**
+ * Incremental mean and variance of a series of samples (Welford's algorithm) in fixed point,
+ * so no sample history has to be stored.
+ */
+class RunningStats
+{
+private:
+    uint16_t count = 0;
+    int32_t meanFx = 0;   /* Mean, PUMP_STATS_FRAC_BITS fractional bits */
+    uint64_t m2Fx = 0;    /* Sum of squared differences, 2 * PUMP_STATS_FRAC_BITS fractional bits */
+public:
+    void AddSample(uint32_t sample);
+    bool isOutlier(uint32_t sample, uint8_t sigma);
+    uint16_t getCount();
+    uint32_t getMean();
+    uint32_t getMeanFx();
+    uint32_t getStdDev();
+    uint64_t getVarianceFx();
+};
+
+/**
+ * Per pump analytics of the cistern fill cycles: pumping time needed to fill the cistern,
+ * well empty pauses per cycle and pause duration. A pump whose fill time drifts away from
+ * its own history raises an alarm, which is an early sign of a worn pump.
+ */
+class PumpStats
+{
+private:
+    RunningStats fillTime[PUMP_STATS_NUM_PUMPS];    /* Seconds of pumping per fill cycle */
+    RunningStats pauseCount[PUMP_STATS_NUM_PUMPS];  /* Well empty pauses per fill cycle */
+    RunningStats pauseTime[PUMP_STATS_NUM_PUMPS];   /* Seconds per well empty pause */
+    uint8_t alarmFlags = 0;
+    uint8_t version = 0;
+
+    uint8_t cyclePump = 0;
+    bool cycleActive = false;
+    bool cyclePaused = false;
+    bool cycleBoosted = false;
+    uint32_t cycleStartMs = 0;
+    uint32_t pauseStartMs = 0;
+    uint32_t cyclePausedMs = 0;
+    uint8_t cyclePauses = 0;
+
+    void LogPumpStats(uint8_t pump, uint32_t fillSeconds);
+public:
+    void CycleStart(uint8_t pump, uint32_t nowMs);
+    void PauseStart(uint32_t nowMs);
+    void PauseEnd(uint32_t nowMs);
+    void CycleEnd(uint32_t nowMs);
+    void CycleAbort();
+    void MarkCycleBoosted();
+    bool isCycleActive();
+    bool isFillTimeAlarm(uint8_t pump);
+    bool isAnyAlarm();
+    void ClearAlarms();
+    uint8_t getVersion();
+    RunningStats &getFillTime(uint8_t pump);
+    RunningStats &getPauseCount(uint8_t pump);
+    RunningStats &getPauseTime(uint8_t pump);
+};
+
+#endif
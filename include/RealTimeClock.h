@@ -14,6 +14,10 @@ public:
     DateTime GetCurrentDateTime();
     void setDateTime(const DateTime &dt);
     String getFormattedDateTime();
+    static void FormatDateTime(const DateTime &dt, char *buf, size_t bufSize);
+    void EnableAlarmInterrupt();
+    void SetAlarm1(const DateTime &dt);
+    void ClearAlarm1();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef SENSOR_PLAUSIBILITY_H
+#define SENSOR_PLAUSIBILITY_H
+
+#include <Arduino.h>
+#include "PumpStats.h"
+
+/* Latched faults */
+#define FAULT_NONE                  (0x00)
+#define FAULT_CISTERN_FILL_TIMEOUT  (0x01) /* Pumping for longer than the learned fill time, cistern sensor stuck empty or pump not delivering */
+#define FAULT_CISTERN_UNEXPECTED    (0x02) /* Cistern went full with both pumps off, cistern sensor implausible */
+#define FAULT_WELL_STUCK_EMPTY      (0x04) /* Well empty for longer than it ever took to recover, well sensor stuck empty */
+#define FAULT_NO_FLOW               (0x08) /* Pump energized without flow at the flow meter, running dry or against a closed valve */
+
+#define PLAUSIBILITY_SIGMA            (4)         /* Bounds are the learned mean plus N standard deviations */
+#define PLAUSIBILITY_MIN_SAMPLES      (5)         /* Samples required before the learned bounds replace the bootstrap ones */
+#define PLAUSIBILITY_BOOTSTRAP_FILL_S (7200UL)    /* Fill time bound used until enough fills were recorded */
+#define PLAUSIBILITY_BOOTSTRAP_WELL_S (86400UL)   /* Well empty time bound used until enough recoveries were recorded */
+#define PLAUSIBILITY_MIN_FILL_S       (60UL)      /* Shortest fill time bound */
+#define PLAUSIBILITY_MIN_WELL_S       (600UL)     /* Shortest well empty time bound */
+#define PLAUSIBILITY_PUMP_SETTLE_MS   (60000UL)   /* Time after the pumps stop in which the cistern may still reach full */
+
+/**
+ * Cross-checks the well and cistern sensor transitions against the pump state and the
+ * elapsed time. The expected times are learned from the recorded fills and well recoveries.
+ * Detected faults are latched until acknowledged, and while a fault is latched the
+ * automatic modes keep both pumps off.
+ */
+class SensorPlausibility
+{
+private:
+    RunningStats fillHistory;       /* Seconds of pumping per fill */
+    RunningStats wellEmptyHistory;  /* Seconds per well empty period */
+    uint8_t faults = FAULT_NONE;
+
+    bool prevCisternEmpty = false;
+    bool prevWellEmpty = false;
+    bool initialized = false;
+    uint32_t lastTickMs = 0;
+    uint32_t lastPumpOnMs = 0;
+    uint32_t fillPumpingMs = 0;
+    uint32_t wellEmptySinceMs = 0;
+
+    void LatchFault(uint8_t fault);
+    uint32_t LearnedBound(RunningStats &history, uint32_t bootstrapS, uint32_t minS);
+public:
+    void Update(bool wellEmpty, bool cisternEmpty, bool anyPumpOn, bool noFlow, uint32_t nowMs);
+    bool hasFault();
+    uint8_t getFaults();
+    const char *getFaultText();
+    void ClearFaults();
+    uint32_t getFillBoundSeconds();
+    uint32_t getWellEmptyBoundSeconds();
+};
+
+#endif
@@ -2,15 +2,38 @@
 #define SENSORS_H
 
 #include "DI_Inputs.h"
+#include "AdcSampler.h"
 
 class DigitalSensor : public DI_Inputs
 {
 private:
     bool SensorState = false;
+    uint32_t lastActiveTime = 0;
 public:
     DigitalSensor(uint8_t pin) : DI_Inputs(pin){};
     void PollSensorState();
     bool isSensorActive();
 };
 
+/**
+ * Analog sensor sampled in the background by the ADC sampler. Polling only sums the
+ * decimated blocks already collected, it never waits for a conversion. The readings are the
+ * mean voltage, e.g. of a level transducer, and the RMS of the voltage around its mean,
+ * e.g. of a current sensor on an AC motor.
+ */
+class AnalogSensor
+{
+private:
+    uint8_t channel;
+    uint16_t meanMilliVolts = 0;
+    uint16_t rmsMilliVolts = 0;
+    bool ready = false;
+public:
+    AnalogSensor(uint8_t pin) : channel(AdcSampler_AddChannel(pin)) {};
+    void PollSensorState();
+    bool isReady();
+    uint16_t getMilliVolts();
+    uint16_t getRmsMilliVolts();
+};
+
 #endif
\ No newline at end of file
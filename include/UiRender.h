@@ -0,0 +1,45 @@
+#ifndef UI_RENDER_H
+#define UI_RENDER_H
+
+#include <Arduino.h>
+
+#define UI_RENDER_MIN_INTERVAL_MS (100) /* Throttle: minimum time between two display frames */
+
+/* Model values a screen can depend on. Each one carries a version that changes with the value */
+enum UiDependency_t {
+    UI_DEP_MODE,   /* Control mode shown on the main screen */
+    UI_DEP_TIME,   /* RTC time, with one second resolution */
+    UI_DEP_CURSOR, /* Menu selector or edited field position */
+    UI_DEP_FIELDS, /* Values being edited or shown */
+    UI_DEP_ALARMS, /* Active alarms */
+    UI_DEP_COUNT
+};
+
+#define UI_DEP_BIT(dep) (1 << (dep))
+
+/**
+ * Keeps track of which model values changed since they were last drawn, so screens only
+ * reprint the LCD rows whose data actually changed. Drawing is only allowed inside a
+ * frame, and frames are throttled to one every UI_RENDER_MIN_INTERVAL_MS.
+ */
+class UiRender
+{
+private:
+    uint8_t values[UI_DEP_COUNT];
+    uint8_t versions[UI_DEP_COUNT];
+    uint8_t drawnVersions[UI_DEP_COUNT];
+    uint32_t lastFrameMs = 0;
+    bool frameOpen = false;
+public:
+    UiRender();
+    void Invalidate(UiDependency_t dep);
+    void UpdateValue(UiDependency_t dep, uint8_t value);
+    void InvalidateAll();
+    bool BeginFrame(uint32_t nowMs);
+    void EndFrame();
+    bool isFrameOpen();
+    bool NeedsRedraw(uint8_t depMask);
+    void MarkDrawn(uint8_t depMask);
+};
+
+#endif
@@ -3,6 +3,11 @@
 
 #include "LCD_Display.h"
 #include "RealTimeClock.h"
+#include "UiRender.h"
+#include "PumpStats.h"
+#include "PumpSchedule.h"
+#include "FlowMeter.h"
+#include "PumpControl.h"
 #include "utilities.h"
 #include <stdint.h>
 
@@ -13,20 +18,6 @@ struct PumpCycleTime {
     uint8_t second;
 };
 
-enum CtrlModeSel_t {
-    CTRL_AUTO_BY_SENSORS,/* Setting selected using mode's push button */
-    CTRL_MODE_MANUAL,    /* Setting selected using mode's push button */
-    CTRL_AUTO_BY_TIMER   /* Setting selected using display interfaces */
-};
-
-/* Manual activation of each pump using pump's push button */
-enum ManualPumpSel_t {
-    SELECT_PUMP_NONE,
-    SELECT_PUMP_1,
-    SELECT_PUMP_2,
-    SELECT_PUMP_BOTH
-};
-
 enum ScreenMode_t {
     SCREEN_MAIN,            
     SCREEN_MAIN_CFGS,
@@ -34,19 +25,33 @@ enum ScreenMode_t {
     SCREEN_CFG_RTC,   
     SCREEN_CFG_PUMP1_CYCLE,
     SCREEN_CFG_PUMP2_CYCLE,
+    SCREEN_PUMP_STATS,
+    SCREEN_CFG_SCHEDULE,
 };
 
-ScreenMode_t DisplayMain(bool pbOkState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay, String Hour);
-ScreenMode_t DisplayMainCfgs(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, LCD_Display &lcdDisplay);
-ScreenMode_t DisplayCfgControlTypes(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay);
-ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, bool pbLeftState, bool pbRightState, LCD_Display &lcdDisplay, RealTimeClock &rtc_datetime);
+uint8_t ScreenDependencies(ScreenMode_t screen);
+ScreenMode_t DisplayMain(bool pbOkState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay, UiRender &uiRender, const DateTime &now, uint8_t alarmFlags, const char *faultText);
+ScreenMode_t DisplayMainCfgs(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, LCD_Display &lcdDisplay, UiRender &uiRender);
+ScreenMode_t DisplayCfgControlTypes(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay, UiRender &uiRender);
+ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, bool pbLeftState, bool pbRightState, LCD_Display &lcdDisplay, UiRender &uiRender, RealTimeClock &rtc_datetime);
 ScreenMode_t DisplayCfgPump1Cycle(
     bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
     bool pbLeftState, bool pbRightState,
-    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay);
+    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay, UiRender &uiRender);
 
 ScreenMode_t DisplayCfgPump2Cycle(
     bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
     bool pbLeftState, bool pbRightState,
-    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay);
+    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay, UiRender &uiRender);
+
+ScreenMode_t DisplayPumpStats(
+    bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
+    bool pbLeftState, bool pbRightState,
+    PumpStats &pumpStats, FlowMeter &flowMeter, uint16_t pumpCurrentMa, uint8_t cisternLevelPct,
+    uint16_t awakePermille, uint16_t boardCurrentX10Ma, LCD_Display &lcdDisplay, UiRender &uiRender);
+
+ScreenMode_t DisplayCfgSchedule(
+    bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
+    bool pbLeftState, bool pbRightState,
+    PumpSchedule &pumpSchedule, LCD_Display &lcdDisplay, UiRender &uiRender);
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <Arduino.h>
+
+/* Reset causes of a crash record */
+#define CRASH_CAUSE_NONE      (0)
+#define CRASH_CAUSE_WATCHDOG  (1)  /* Watchdog timeout, the program counter was captured */
+#define CRASH_CAUSE_BROWNOUT  (2)  /* Supply below the brown-out level, no program counter */
+
+/* Tasks of the main loop, the one running is kept in the crash record */
+enum WatchdogTask_t {
+    WDT_TASK_SCHEDULER,   /* Main loop between the tasks */
+    WDT_TASK_SETUP,
+    WDT_TASK_POLL,
+    WDT_TASK_CONTROL,
+    WDT_TASK_UI,
+    WDT_TASK_BUS,
+    WDT_TASK_NVM,
+};
+
+/* Tasks that must all check in before the watchdog is fed */
+#define WDT_REQUIRED_TASKS ((1U << WDT_TASK_POLL) | (1U << WDT_TASK_CONTROL) | (1U << WDT_TASK_UI))
+
+/* State at the last reset, kept in RAM that the start-up code does not clear */
+struct CrashRecord {
+    uint8_t cause;
+    uint8_t task;        /* WatchdogTask_t running at the reset */
+    uint16_t pc;         /* Byte address of the interrupted instruction, 0 if unknown */
+    uint32_t loopCount;  /* Main loop iterations since the previous start */
+};
+
+void Watchdog_Begin(void (*safeState)(void));
+bool Watchdog_GetCrash(CrashRecord &record);
+void Watchdog_TaskBegin(WatchdogTask_t task);
+void Watchdog_TaskEnd(WatchdogTask_t task);
+void Watchdog_Feed();
+const char *Watchdog_GetTaskName(uint8_t task);
+
+#endif
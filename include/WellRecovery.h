@@ -0,0 +1,59 @@
+#ifndef WELL_RECOVERY_H
+#define WELL_RECOVERY_H
+
+#include <Arduino.h>
+
+#define WELL_RECOVERY_NUM_PUMPS      (2)
+#define WELL_MIN_OFF_TIME_MS         (30000UL)   /* A stopped pump stays off at least this long */
+#define WELL_RESUME_DELAY_MIN_MS     (10000UL)   /* Shortest time the well must read full before a paused pump resumes */
+#define WELL_RESUME_DELAY_MAX_MS     (1800000UL) /* Longest resume delay reached by the back-off */
+#define WELL_DRY_STREAK_WINDOW_MS    (600000UL)  /* A dry event within this time of the previous one doubles the resume delay, it halves again after this time without one */
+#define WELL_STABLE_RUN_MS           (300000UL)  /* A run this long without a dry event resets the back-off */
+#define PUMP_START_STAGGER_MS        (5000UL)    /* Shortest time between two pump starts, so the motors inrush currents do not add up */
+#define WELL_RECOVERY_EMA_SHIFT      (2)         /* Recovery time average weight: 1 / (1 << shift) */
+#define WELL_DRY_STREAK_MAX          (8)
+
+/**
+ * Gates the pump outputs with the well level to avoid short-cycling the motors when the
+ * well sensor flickers around its threshold. A pump stops as soon as the well reads empty,
+ * the hysteresis is on the restart: it enforces a minimum off time per pump, and a paused
+ * pump is only resumed once the well has read full for a delay that is
+ * learned from how long the well took to recover before, doubled on repeated dry events.
+ * Pump starts are also staggered so both motors never start at the same instant.
+ */
+class WellRecovery
+{
+private:
+    struct PumpTrack {
+        uint32_t startMs;
+        uint32_t stopMs;
+        bool running;
+        bool pausedByWell;
+    };
+
+    PumpTrack pumps[WELL_RECOVERY_NUM_PUMPS];
+    bool wellEmpty = false;
+    uint32_t wellFullSinceMs = 0;
+    uint32_t recoveryEmaMs = WELL_RESUME_DELAY_MIN_MS;
+    uint32_t lastDryMs = 0;
+    uint32_t lastBackoffMs = 0;
+    uint32_t lastStartMs = (uint32_t)(0 - PUMP_START_STAGGER_MS);
+    bool recoveryPending = false;
+    uint8_t dryStreak = 0;
+    uint16_t startCount = 0;
+
+    void StartPump(uint8_t pump, uint32_t nowMs);
+    void StopPump(uint8_t pump, uint32_t nowMs);
+    void RecordDryEvent(uint32_t nowMs);
+public:
+    WellRecovery();
+    void UpdateWell(bool isWellEmpty, uint32_t nowMs);
+    bool RequestPump(uint8_t pump, bool demand, uint32_t nowMs);
+    void TrackPump(uint8_t pump, bool on, uint32_t nowMs);
+    bool isPausedByWell(uint8_t pump);
+    uint32_t getResumeDelayMs();
+    uint32_t getRecoveryTimeMs();
+    uint16_t getStartCount();
+};
+
+#endif
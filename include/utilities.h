@@ -3,7 +3,29 @@
 #ifndef UTILITIES_H
 #define UTILITIES_H
 
+/* Modbus RTU slave on the USART, set by the modbus build environment. The USART then belongs
+ * to the Modbus transport and the serial log is compiled out */
+#ifndef MODBUS_ENABLED
+#define MODBUS_ENABLED (0)
+#endif
+
+/* Pump coordination bus between the boards feeding the same cistern, set by the coord build
+ * environment. It uses the USART like Modbus, so only one of them can be enabled */
+#ifndef COORD_ENABLED
+#define COORD_ENABLED (0)
+#endif
+
+#if MODBUS_ENABLED && COORD_ENABLED
+#error "Modbus and the pump coordination bus share the USART, enable only one of them"
+#endif
+
+#define SERIAL_LOG_ENABLED (!MODBUS_ENABLED && !COORD_ENABLED)
+
+/* Provisioning frames of the host tool, received on the port of the serial log */
+#define CONFIG_LINK_ENABLED (SERIAL_LOG_ENABLED)
+
 void LogSerial(String data, bool IsLog);
 void LogSerialn(String data, bool IsLog);
+uint32_t ISqrt64(uint64_t value);
 
 #endif
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "AT24C32_nvm.h"
+#include "Bench.h"
 
 /**
  * @brief Writes bytes to the I2C EEPROM (AT24C32).
  * This function writes a sequence of bytes to the I2C EEPROM starting from the specified address.
+ * Each transmission stays within a page and within the Wire TX buffer along with the address.
  * @param eeaddress The starting address in the EEPROM to write the data.
  * @param data A pointer to the data buffer to be written to the EEPROM.
  * @param length The number of bytes to write from the data buffer.
@@ -12,11 +14,13 @@ void I2C_EEPROM_WriteBytes(uint16_t eeaddress, const uint8_t* data, uint16_t len
         Wire.beginTransmission(AT24C32_I2C_ADDR);
         Wire.write((int)(eeaddress >> 8));   // MSB
         Wire.write((int)(eeaddress & 0xFF)); // LSB
-        uint8_t bytesThisPage = min(length, 32 - (eeaddress % 32)); // 32-byte page boundary
+        uint8_t bytesThisPage = min(length, AT24C32_PAGE_SIZE - (eeaddress % AT24C32_PAGE_SIZE)); // 32-byte page boundary
+        bytesThisPage = min(bytesThisPage, AT24C32_WRITE_CHUNK);
         for (uint8_t i = 0; i < bytesThisPage; i++) {
             Wire.write(data[i]);
         }
         Wire.endTransmission();
+        BENCH_I2C_BYTES(bytesThisPage + 3);
         delay(5); // Write cycle time
         eeaddress += bytesThisPage;
         data += bytesThisPage;
@@ -42,6 +46,7 @@ void I2C_EEPROM_ReadBytes(uint16_t eeaddress, uint8_t* data, uint16_t length) {
         for (uint8_t i = 0; i < bytesThisRead && Wire.available(); i++) {
             data[i] = Wire.read();
         }
+        BENCH_I2C_BYTES(bytesThisRead + 4);
         eeaddress += bytesThisRead;
         data += bytesThisRead;
         length -= bytesThisRead;
@@ -38,5 +38,5 @@ void DigitalActuator::setState(bool state) {
  * @return True if the actuator is active, false otherwise.
  */
 bool DigitalActuator::getState() {
-    return digitalRead(getPin()) == HIGH;
+    return getOutputPin();
 }
\ No newline at end of file
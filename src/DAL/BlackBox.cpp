@@ -0,0 +1,212 @@
+#include "BlackBox.h"
+#include "AT24C32_nvm.h"
+#include "RealTimeClock.h"
+#include "utilities.h"
+
+#define BLACKBOX_RUNS_PER_LINE (8)
+
+/**
+ * @brief Reads the sequence number of the last incident saved, so the numbering goes on after a reset.
+ */
+void BlackBox::Load() {
+    BlackBoxHeader header;
+    I2C_EEPROM_ReadBytes(NVM_BLACKBOX_ADDR, (uint8_t*)&header, sizeof(header));
+    seq = (header.magic == BLACKBOX_MAGIC) ? header.seq : 0;
+}
+
+/**
+ * @brief Records the snapshot of a sensor poll. A new run starts when the snapshot changes, or when
+ * the open run reaches 255 ticks. Ignored while a capture waits for Save().
+ * @param newSample The BLACKBOX_* bits of the poll.
+ * @param nowMs Current time in milliseconds.
+ */
+void BlackBox::Record(uint8_t newSample, uint32_t nowMs) {
+    if (savePending) {
+        return;
+    }
+    if (!started) {
+        started = true;
+        sample = newSample;
+        runStartMs = nowMs;
+        return;
+    }
+
+    while ((nowMs - runStartMs >= 255 * BLACKBOX_TICK_MS) && !savePending) {
+        CloseRun(255);
+    }
+    if (!savePending && (newSample != sample)) {
+        /** The rounding error is carried by the start of the next run, it does not add up */
+        CloseRun((uint8_t)((nowMs - runStartMs + BLACKBOX_TICK_MS / 2) / BLACKBOX_TICK_MS));
+        sample = newSample;
+    }
+
+    if ((cause != BLACKBOX_CAUSE_NONE) && !savePending && (nowMs - triggerMs >= BLACKBOX_POST_MS)) {
+        EndCapture(nowMs);
+    }
+}
+
+/**
+ * @brief Starts the capture of an incident, the runs after it are recorded for BLACKBOX_POST_MS.
+ * A trigger during a capture is part of the same incident and is ignored.
+ * @param reason The BlackBoxCause_t.
+ * @param nowMs Current time in milliseconds.
+ * @return True if a capture was started.
+ */
+bool BlackBox::Trigger(BlackBoxCause_t reason, uint32_t nowMs) {
+    if ((cause != BLACKBOX_CAUSE_NONE) || !started) {
+        return false;
+    }
+    /** The open run ends at the trigger, so the trigger falls between two runs */
+    while (nowMs - runStartMs >= 255 * BLACKBOX_TICK_MS) {
+        CloseRun(255);
+    }
+    CloseRun((uint8_t)((nowMs - runStartMs + BLACKBOX_TICK_MS / 2) / BLACKBOX_TICK_MS));
+    cause = reason;
+    triggerMs = nowMs;
+    postCount = 0;
+    return true;
+}
+
+/**
+ * @brief Checks if an incident is being captured or waits to be saved.
+ * @return True while capturing.
+ */
+bool BlackBox::isCapturing() {
+    return (cause != BLACKBOX_CAUSE_NONE);
+}
+
+/**
+ * @brief Checks if a captured incident must be saved.
+ * @return True if Save() must be called, false otherwise.
+ */
+bool BlackBox::isSavePending() {
+    return savePending;
+}
+
+/**
+ * @brief Saves the captured incident to the EEPROM, replacing the previous one, and restarts the recording.
+ * @param unixTime Current RTC time, the trigger time is computed back from it.
+ * @param nowMs Current time in milliseconds.
+ */
+void BlackBox::Save(uint32_t unixTime, uint32_t nowMs) {
+    if (!savePending) {
+        return;
+    }
+    BlackBoxHeader header;
+    header.magic = BLACKBOX_MAGIC;
+    header.seq = ++seq;
+    header.cause = cause;
+    header.runCount = count;
+    header.preRunCount = count - postCount;
+    header.reserved = 0;
+    header.triggerTime = unixTime - (nowMs - triggerMs) / 1000;
+    header.triggerMs = triggerMs;
+    I2C_EEPROM_WriteBytes(NVM_BLACKBOX_ADDR, (const uint8_t*)&header, sizeof(header));
+
+    /** The oldest run is written first, the ring wraps at most once */
+    uint8_t first = (uint8_t)((head + BLACKBOX_RING_ENTRIES - count) % BLACKBOX_RING_ENTRIES);
+    uint8_t firstPart = min(count, (uint8_t)(BLACKBOX_RING_ENTRIES - first));
+    uint16_t addr = NVM_BLACKBOX_ADDR + sizeof(header);
+    I2C_EEPROM_WriteBytes(addr, (const uint8_t*)&ring[first], firstPart * sizeof(BlackBoxRun));
+    if (count > firstPart) {
+        I2C_EEPROM_WriteBytes(addr + firstPart * sizeof(BlackBoxRun), (const uint8_t*)ring, (count - firstPart) * sizeof(BlackBoxRun));
+    }
+    LogSerialn("Black box #" + String(seq) + " saved to AT24C32, " + String(count) + " runs", true);
+
+    /** The runs stay in the ring as the history of the next incident */
+    cause = BLACKBOX_CAUSE_NONE;
+    postCount = 0;
+    savePending = false;
+    started = false;
+}
+
+/**
+ * @brief Prints the incident saved in the EEPROM on serial. Each run is printed as the sample in hex
+ * and its length in ticks, and each line starts with its time from the trigger.
+ */
+void BlackBox::Report() {
+    BlackBoxHeader header;
+    I2C_EEPROM_ReadBytes(NVM_BLACKBOX_ADDR, (uint8_t*)&header, sizeof(header));
+    if ((header.magic != BLACKBOX_MAGIC) || (header.runCount > BLACKBOX_RING_ENTRIES) || (header.preRunCount > header.runCount)) {
+        return;
+    }
+
+    char when[20];
+    RealTimeClock::FormatDateTime(DateTime(header.triggerTime), when, sizeof(when));
+    LogSerialn("Black box #" + String(header.seq) + " " + getCauseName(header.cause) + " at " + when + ", " +
+               String(header.runCount) + " runs, " + String(header.preRunCount) + " before the trigger, " +
+               String(BLACKBOX_TICK_MS) + " ms ticks", true);
+
+    uint16_t addr = NVM_BLACKBOX_ADDR + sizeof(header);
+    int32_t tickTime = 0;  /* Time of the first run from the trigger, in ticks */
+    BlackBoxRun runs[BLACKBOX_RUNS_PER_LINE];
+    for (uint8_t i = 0; i < header.preRunCount; i += BLACKBOX_RUNS_PER_LINE) {
+        uint8_t n = min((uint8_t)(header.preRunCount - i), (uint8_t)BLACKBOX_RUNS_PER_LINE);
+        I2C_EEPROM_ReadBytes(addr + i * sizeof(BlackBoxRun), (uint8_t*)runs, n * sizeof(BlackBoxRun));
+        for (uint8_t j = 0; j < n; j++) {
+            tickTime -= runs[j].ticks;
+        }
+    }
+
+    for (uint8_t i = 0; i < header.runCount; i += BLACKBOX_RUNS_PER_LINE) {
+        uint8_t n = min((uint8_t)(header.runCount - i), (uint8_t)BLACKBOX_RUNS_PER_LINE);
+        I2C_EEPROM_ReadBytes(addr + i * sizeof(BlackBoxRun), (uint8_t*)runs, n * sizeof(BlackBoxRun));
+        String line = String((long)(tickTime * (int32_t)BLACKBOX_TICK_MS)) + " ms:";
+        for (uint8_t j = 0; j < n; j++) {
+            line += ((i + j == header.preRunCount) ? " | " : " ") + String(runs[j].sample, HEX) + "x" + String(runs[j].ticks);
+            tickTime += runs[j].ticks;
+        }
+        LogSerialn(line, true);
+    }
+}
+
+/**
+ * @brief Gets the name of a trigger cause for the log.
+ * @param cause The BlackBoxCause_t.
+ * @return The name.
+ */
+const char *BlackBox::getCauseName(uint8_t cause) {
+    switch (cause) {
+        case BLACKBOX_CAUSE_FAULT:   return "fault";
+        case BLACKBOX_CAUSE_DRY_RUN: return "dry_run";
+        case BLACKBOX_CAUSE_MANUAL:  return "manual";
+        default:                     return "none";
+    }
+}
+
+/**
+ * @brief Closes the open run and stores it in the ring, overwriting the oldest run once full.
+ * The next run starts where this one ends. The capture ends once half of the ring holds runs
+ * after the trigger, so the runs before it are kept.
+ * @param ticks Length of the run in BLACKBOX_TICK_MS.
+ */
+void BlackBox::CloseRun(uint8_t ticks) {
+    ring[head].sample = sample;
+    ring[head].ticks = ticks;
+    head = (uint8_t)((head + 1) % BLACKBOX_RING_ENTRIES);
+    if (count < BLACKBOX_RING_ENTRIES) {
+        count++;
+    }
+    runStartMs += (uint32_t)ticks * BLACKBOX_TICK_MS;
+
+    if (cause != BLACKBOX_CAUSE_NONE) {
+        postCount++;
+        if (postCount >= BLACKBOX_RING_ENTRIES / 2) {
+            savePending = true;
+        }
+    }
+}
+
+/**
+ * @brief Ends the capture: closes the open run and freezes the ring until Save().
+ * @param nowMs Current time in milliseconds.
+ */
+void BlackBox::EndCapture(uint32_t nowMs) {
+    while ((nowMs - runStartMs >= 255 * BLACKBOX_TICK_MS) && !savePending) {
+        CloseRun(255);
+    }
+    if (!savePending) {
+        CloseRun((uint8_t)((nowMs - runStartMs + BLACKBOX_TICK_MS / 2) / BLACKBOX_TICK_MS));
+    }
+    savePending = true;
+}
@@ -0,0 +1,113 @@
+#include "ButtonEvents.h"
+
+/**
+ * @brief Constructor for ButtonEvents class.
+ * @param buttons Array of push buttons, indexed by ButtonId_t.
+ * @param numButtons Number of push buttons in the array (up to BUTTON_EVENTS_MAX_BUTTONS).
+ * @param repeatMask Bit mask of the buttons that raise auto-repeat events while held.
+ */
+ButtonEvents::ButtonEvents(DigitalSensor *const *buttons, uint8_t numButtons, uint8_t repeatMask)
+    : buttons(buttons), numButtons(min(numButtons, (uint8_t)BUTTON_EVENTS_MAX_BUTTONS)), repeatMask(repeatMask)
+{
+    memset(track, 0, sizeof(track));
+}
+
+/**
+ * @brief Samples the debounced state of every button and queues the resulting events.
+ * Must be called right after the buttons have been polled.
+ * @param nowMs Current time in milliseconds.
+ */
+void ButtonEvents::UpdateEvents(uint32_t nowMs) {
+    for (uint8_t i = 0; i < numButtons; i++) {
+        ButtonTrack &t = track[i];
+        bool state = buttons[i]->isSensorActive();
+
+        if (state && !t.prevState) {
+            /** Rising edge */
+            t.pressTime = nowMs;
+            t.nextRepeatTime = nowMs + BUTTON_REPEAT_DELAY_MS;
+            t.repeatCount = 0;
+            t.longPressSent = false;
+            PushEvent(i, BTN_EVT_PRESS);
+        } else if (!state && t.prevState) {
+            /** Falling edge */
+            PushEvent(i, BTN_EVT_RELEASE);
+        } else if (state) {
+            /** Button held */
+            if (!t.longPressSent && (nowMs - t.pressTime >= BUTTON_LONG_PRESS_MS)) {
+                t.longPressSent = true;
+                PushEvent(i, BTN_EVT_LONG_PRESS);
+            }
+            if ((repeatMask & (1 << i)) && ((int32_t)(nowMs - t.nextRepeatTime) >= 0)) {
+                PushEvent(i, BTN_EVT_REPEAT);
+                t.nextRepeatTime = nowMs + RepeatPeriod(t.repeatCount);
+                if (t.repeatCount < 0xFF) {
+                    t.repeatCount++;
+                }
+            }
+        }
+        t.prevState = state;
+    }
+}
+
+/**
+ * @brief Gets the next pending event.
+ * @param event Reference where the oldest queued event is stored.
+ * @return True if an event was returned, false if the queue is empty.
+ */
+bool ButtonEvents::PopEvent(ButtonEvent &event) {
+    if (head == tail) {
+        return false;
+    }
+    event = queue[tail];
+    tail = (tail + 1) & (BUTTON_EVENTS_QUEUE_SIZE - 1);
+    return true;
+}
+
+/**
+ * @brief Checks if there are no pending events.
+ * @return True if the queue is empty, false otherwise.
+ */
+bool ButtonEvents::isEmpty() {
+    return head == tail;
+}
+
+/**
+ * @brief Gets the number of events dropped because the queue was full.
+ * @return The dropped events count (saturates at 255).
+ */
+uint8_t ButtonEvents::getDroppedCount() {
+    return droppedCount;
+}
+
+/**
+ * @brief Adds an event to the queue. If the queue is full the event is dropped and counted.
+ * @param button The button that raised the event.
+ * @param type The event type.
+ */
+void ButtonEvents::PushEvent(uint8_t button, ButtonEventType_t type) {
+    uint8_t next = (head + 1) & (BUTTON_EVENTS_QUEUE_SIZE - 1);
+    if (next == tail) {
+        if (droppedCount < 0xFF) {
+            droppedCount++;
+        }
+        return;
+    }
+    queue[head].button = button;
+    queue[head].type = type;
+    head = next;
+}
+
+/**
+ * @brief Gets the auto-repeat period; it shortens the longer the button is held.
+ * @param repeatCount Number of repeat events already raised for the current press.
+ * @return The time in milliseconds until the next repeat event.
+ */
+uint16_t ButtonEvents::RepeatPeriod(uint8_t repeatCount) {
+    if (repeatCount < BUTTON_REPEAT_SLOW_COUNT) {
+        return BUTTON_REPEAT_SLOW_MS;
+    } else if (repeatCount < BUTTON_REPEAT_MEDIUM_COUNT) {
+        return BUTTON_REPEAT_MEDIUM_MS;
+    }
+    return BUTTON_REPEAT_FAST_MS;
+}
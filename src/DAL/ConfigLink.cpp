@@ -0,0 +1,176 @@
+#include "ConfigLink.h"
+#include "ModbusRtu.h"
+#include <string.h>
+
+#define CONFIG_LINK_HEADER (4)  /* Sync bytes, command and payload length */
+
+/**
+ * @brief Feeds a received byte to the parser.
+ * @param byte The byte.
+ * @param nowMs Current time in milliseconds.
+ * @return CONFIG_LINK_FRAME or CONFIG_LINK_BAD_CRC once a whole frame was received, CONFIG_LINK_NONE otherwise.
+ */
+ConfigLinkResult_t ConfigLinkParser::Feed(uint8_t byte, uint32_t nowMs) {
+    if ((length > 0) && (nowMs - lastByteMs > CONFIG_LINK_TIMEOUT_MS)) {
+        length = 0;
+    }
+    lastByteMs = nowMs;
+
+    if (length == 0) {
+        if (byte == CONFIG_LINK_SYNC1) {
+            frame[length++] = byte;
+        }
+        return CONFIG_LINK_NONE;
+    }
+    if (length == 1) {
+        if (byte == CONFIG_LINK_SYNC2) {
+            frame[length++] = byte;
+        } else if (byte != CONFIG_LINK_SYNC1) {
+            length = 0;
+        }
+        return CONFIG_LINK_NONE;
+    }
+
+    frame[length++] = byte;
+    if ((length == CONFIG_LINK_HEADER) && (frame[3] > CONFIG_LINK_PAYLOAD_MAX)) {
+        length = 0;
+        return CONFIG_LINK_NONE;
+    }
+    if ((length < CONFIG_LINK_HEADER) || (length < CONFIG_LINK_HEADER + frame[3] + 2)) {
+        return CONFIG_LINK_NONE;
+    }
+
+    length = 0;
+    uint8_t crcAt = CONFIG_LINK_HEADER + frame[3];
+    uint16_t crc = ModbusRtu_Crc16(&frame[2], crcAt - 2);
+    if ((frame[crcAt] != (crc & 0xFF)) || (frame[crcAt + 1] != (crc >> 8))) {
+        return CONFIG_LINK_BAD_CRC;
+    }
+    return CONFIG_LINK_FRAME;
+}
+
+/**
+ * @brief Gets the command of the last frame.
+ * @return The CONFIG_CMD_* command.
+ */
+uint8_t ConfigLinkParser::getCommand() const {
+    return frame[2];
+}
+
+/**
+ * @brief Gets the payload length of the last frame.
+ * @return The length in bytes.
+ */
+uint8_t ConfigLinkParser::getPayloadLength() const {
+    return frame[3];
+}
+
+/**
+ * @brief Gets the payload of the last frame.
+ * @return Pointer to the first byte of the payload.
+ */
+const uint8_t *ConfigLinkParser::getPayload() const {
+    return &frame[CONFIG_LINK_HEADER];
+}
+
+/**
+ * @brief Builds a frame.
+ * @param command The command, with CONFIG_CMD_RESPONSE set for a response.
+ * @param payload The payload, up to CONFIG_LINK_PAYLOAD_MAX bytes.
+ * @param payloadLength The payload length.
+ * @param frame Buffer of CONFIG_LINK_FRAME_MAX bytes.
+ * @return The frame length.
+ */
+uint8_t ConfigLink_BuildFrame(uint8_t command, const uint8_t *payload, uint8_t payloadLength, uint8_t *frame) {
+    frame[0] = CONFIG_LINK_SYNC1;
+    frame[1] = CONFIG_LINK_SYNC2;
+    frame[2] = command;
+    frame[3] = payloadLength;
+    memcpy(&frame[CONFIG_LINK_HEADER], payload, payloadLength);
+    uint16_t crc = ModbusRtu_Crc16(&frame[2], payloadLength + 2);
+    frame[CONFIG_LINK_HEADER + payloadLength] = crc & 0xFF;
+    frame[CONFIG_LINK_HEADER + payloadLength + 1] = crc >> 8;
+    return CONFIG_LINK_HEADER + payloadLength + 2;
+}
+
+/**
+ * @brief Checks the values of a configuration image, with the same limits as the menus.
+ * @param image The image.
+ * @return CONFIG_STATUS_OK if the image can be applied, the error otherwise.
+ */
+uint8_t ConfigLink_ValidateImage(const ConfigImage &image) {
+    if (image.version != CONFIG_IMAGE_VERSION) {
+        return CONFIG_STATUS_VERSION;
+    }
+    for (uint8_t i = 0; i < CONFIG_NUM_PUMPS; i++) {
+        if ((image.cycles[i].hour > 23) || (image.cycles[i].minute > 59) || (image.cycles[i].second > 59)) {
+            return CONFIG_STATUS_BAD_VALUE;
+        }
+    }
+    for (uint8_t i = 0; i < CONFIG_NUM_WINDOWS; i++) {
+        if ((image.windows[i].days & 0x80) || (image.windows[i].startHour > 23) || (image.windows[i].startMinute > 59) ||
+            (image.windows[i].endHour > 23) || (image.windows[i].endMinute > 59)) {
+            return CONFIG_STATUS_BAD_VALUE;
+        }
+    }
+    return CONFIG_STATUS_OK;
+}
+
+/**
+ * @brief Executes a received frame and builds its response. A frame with a bad CRC is answered
+ * with CONFIG_STATUS_BAD_CRC, so the host retries at once instead of waiting for a timeout.
+ * @param handlers Access to the configuration of the application.
+ * @param parser The parser that received the frame.
+ * @param result The result of ConfigLinkParser::Feed().
+ * @param response Buffer of CONFIG_LINK_FRAME_MAX bytes.
+ * @return The response length.
+ */
+uint8_t ConfigLink_HandleFrame(const ConfigLinkHandlers &handlers, const ConfigLinkParser &parser, ConfigLinkResult_t result,
+                               uint8_t *response) {
+    uint8_t payload[1 + sizeof(ConfigImage)];
+    uint8_t payloadLength = 1;
+    uint8_t command = parser.getCommand();
+    uint8_t length = parser.getPayloadLength();
+    const uint8_t *data = parser.getPayload();
+    uint8_t status = CONFIG_STATUS_OK;
+
+    if (result == CONFIG_LINK_BAD_CRC) {
+        status = CONFIG_STATUS_BAD_CRC;
+    } else if (command == CONFIG_CMD_READ) {
+        if (length != 0) {
+            status = CONFIG_STATUS_BAD_LENGTH;
+        } else {
+            ConfigImage image;
+            handlers.readImage(image);
+            memcpy(&payload[1], &image, sizeof(image));
+            payloadLength += sizeof(image);
+        }
+    } else if (command == CONFIG_CMD_WRITE) {
+        if (length != sizeof(ConfigImage)) {
+            status = CONFIG_STATUS_BAD_LENGTH;
+        } else {
+            ConfigImage image;
+            memcpy(&image, data, sizeof(image));
+            status = ConfigLink_ValidateImage(image);
+            if (status == CONFIG_STATUS_OK) {
+                handlers.writeImage(image);
+            }
+        }
+    } else if (command == CONFIG_CMD_SET_TIME) {
+        if (length != 4) {
+            status = CONFIG_STATUS_BAD_LENGTH;
+        } else {
+            uint32_t localTime = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+            if ((localTime < CONFIG_TIME_MIN) || (localTime > CONFIG_TIME_MAX)) {
+                status = CONFIG_STATUS_BAD_VALUE;
+            } else {
+                handlers.setTime(localTime);
+            }
+        }
+    } else {
+        status = CONFIG_STATUS_BAD_CMD;
+    }
+
+    payload[0] = status;
+    return ConfigLink_BuildFrame(command | CONFIG_CMD_RESPONSE, payload, payloadLength, response);
+}
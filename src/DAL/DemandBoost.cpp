@@ -0,0 +1,75 @@
+#include "DemandBoost.h"
+#include "utilities.h"
+
+/**
+ * @brief Tracks the pumping time of the current fill and engages the boost when it is behind.
+ * Must be called once per control tick by the automatic modes, before the pumps are requested.
+ * @param fillDemand True while the control mode is waiting for the cistern to be full.
+ * @param anyPumpOn True if any pump output is active.
+ * @param nowMs Current time in milliseconds.
+ */
+void DemandBoost::Update(bool fillDemand, bool anyPumpOn, uint32_t nowMs) {
+    uint32_t tickMs = nowMs - lastTickMs;
+    lastTickMs = nowMs;
+
+    if (!fillDemand) {
+        if (filling) {
+            /** Boosted fills are not comparable with single pump fills, only the latter are learned */
+            if (!active && (pumpingMs > 0)) {
+                fillHistory.AddSample(pumpingMs / 1000);
+            } else if (active) {
+                LogSerialn("Boost off after " + String(pumpingMs / 1000) + " s", true);
+            }
+        }
+        Abort();
+        return;
+    }
+
+    if (!filling) {
+        filling = true;
+        pumpingMs = 0;
+        return;
+    }
+
+    if (anyPumpOn) {
+        pumpingMs += tickMs;
+    }
+    if (!active && (pumpingMs / 1000 > getDeadlineSeconds())) {
+        active = true;
+        LogSerialn("Boost on, fill behind " + String(getDeadlineSeconds()) + " s deadline", true);
+    }
+}
+
+/**
+ * @brief Drops the current fill without learning from it, e.g. when the control mode changes.
+ */
+void DemandBoost::Abort() {
+    filling = false;
+    active = false;
+    pumpingMs = 0;
+}
+
+/**
+ * @brief Checks if the idle pump must run together with the selected one.
+ * @return True if the current fill is boosted, false otherwise.
+ */
+bool DemandBoost::isActive() {
+    return active;
+}
+
+/**
+ * @brief Gets the pumping time after which a fill is boosted.
+ * @return The deadline in seconds.
+ */
+uint32_t DemandBoost::getDeadlineSeconds() {
+    if (BOOST_DEADLINE_S > 0) {
+        return BOOST_DEADLINE_S;
+    }
+    if (fillHistory.getCount() < BOOST_MIN_SAMPLES) {
+        return BOOST_BOOTSTRAP_DEADLINE_S;
+    }
+    uint32_t mean = fillHistory.getMean();
+    uint32_t deadline = mean + BOOST_SIGMA * fillHistory.getStdDev();
+    deadline = max(deadline, mean + mean / 4);
+    return max(deadline, BOOST_MIN_DEADLINE_S);
+}
@@ -0,0 +1,203 @@
+#include "DemandProfile.h"
+#include "AT24C32_nvm.h"
+#include "utilities.h"
+
+/**
+ * @brief Constructor for DemandProfile class, nothing learned until Load().
+ */
+DemandProfile::DemandProfile() {
+    memset(&profile, 0, sizeof(profile));
+    profile.magic = DEMAND_MAGIC;
+}
+
+/**
+ * @brief Loads the learned profile from EEPROM, an uninitialized EEPROM starts from an empty profile.
+ */
+void DemandProfile::Load() {
+    DemandProfileImage image;
+    I2C_EEPROM_ReadBytes(NVM_DEMAND_PROFILE_ADDR, (uint8_t*)&image, sizeof(image));
+    if (image.magic == DEMAND_MAGIC) {
+        profile = image;
+        LogSerialn("Demand profile loaded from AT24C32", true);
+    }
+}
+
+/**
+ * @brief Saves the learned profile to EEPROM, once a day.
+ */
+void DemandProfile::Save() {
+    I2C_EEPROM_WriteBytes(NVM_DEMAND_PROFILE_ADDR, (const uint8_t*)&profile, sizeof(profile));
+    LogSerialn("Demand profile saved to AT24C32, cistern empty " + String(emptyMs / 60000UL) + " min since the last save", true);
+    emptyMs = 0;
+    savePending = false;
+}
+
+/**
+ * @brief Checks if the profile must be saved.
+ * @return True if Save() must be called, false otherwise.
+ */
+bool DemandProfile::isSavePending() {
+    return savePending;
+}
+
+/**
+ * @brief Counts the cistern empty events of the current hour and the time with the cistern empty.
+ * Called on every control tick.
+ * @param cisternEmpty True if the cistern sensor reads empty.
+ * @param nowMs Current time in milliseconds.
+ */
+void DemandProfile::Update(bool cisternEmpty, uint32_t nowMs) {
+    if (cisternWasEmpty) {
+        emptyMs += nowMs - lastUpdateMs;
+    } else if (cisternEmpty && (events < DEMAND_MAX_EVENTS)) {
+        events++;
+    }
+    cisternWasEmpty = cisternEmpty;
+    lastUpdateMs = nowMs;
+}
+
+/**
+ * @brief Learns the hour that ended when the RTC hour changes, measures the drain rate and
+ * predicts the demand of the next hours. Called once a minute.
+ * @param nowHour Current RTC hour, 0-23.
+ * @param pumpsOn True if any pump is on, the level only drains with the pumps off.
+ * @param levelValid True if the level transducer is installed and its reading is settled.
+ * @param levelPct Cistern level in percent.
+ * @param scheduleEnabled True if the pumps may only run inside the pumping windows.
+ */
+void DemandProfile::MinuteTick(uint8_t nowHour, bool pumpsOn, bool levelValid, uint8_t levelPct, bool scheduleEnabled) {
+    if (nowHour >= DEMAND_HOURS) {
+        return;
+    }
+    if ((int8_t)nowHour != hour) {
+        /** The first hour after a reset and the hours skipped by setting the RTC are partial, they are not learned */
+        if ((hour >= 0) && (nowHour == (hour + 1) % DEMAND_HOURS)) {
+            CloseHour();
+            if (nowHour == 0) {
+                savePending = true;
+            }
+        }
+        hour = nowHour;
+        events = 0;
+        drainPct = 0;
+        offMinutes = 0;
+        levelTracked = false;
+    }
+
+    /** The level only tells the demand while the pumps are off */
+    if (levelValid && !pumpsOn) {
+        if (levelTracked) {
+            if (levelPct < lastLevelPct) {
+                drainPct += lastLevelPct - levelPct;
+            }
+            offMinutes++;
+        }
+        lastLevelPct = levelPct;
+        levelTracked = true;
+    } else {
+        levelTracked = false;
+    }
+
+    /** The current hour is part of the lookahead, its demand is still to come */
+    uint8_t lookahead = scheduleEnabled ? PREFILL_SCHEDULE_LOOKAHEAD_H : PREFILL_LOOKAHEAD_H;
+    uint16_t expectedEvents = 0;
+    uint16_t expectedDrainPct = 0;
+    for (uint8_t i = 0; i < lookahead; i++) {
+        uint8_t h = (nowHour + i) % DEMAND_HOURS;
+        expectedEvents += profile.emptyEvents[h];
+        expectedDrainPct += profile.drainPct[h];
+    }
+    bool peak = (expectedEvents >= PREFILL_MIN_EVENTS) || (expectedDrainPct >= PREFILL_MIN_DRAIN_PCT);
+    if (peak != peakAhead) {
+        LogSerialn(peak ? "Demand peak ahead, cistern top-up enabled" : "No demand peak ahead", true);
+    }
+    peakAhead = peak;
+}
+
+/**
+ * @brief Decides if the cistern is topped up, from the level with a hysteresis between
+ * PREFILL_START_PCT and PREFILL_TARGET_PCT. A stuck or drifting transducer disagrees with the
+ * float switch when it flips, which stops the top-ups until a later flip agrees. Called on every
+ * control tick.
+ * @param levelValid True if the level transducer is installed and its reading is in range.
+ * @param levelPct Cistern level in percent.
+ * @param cisternEmpty True if the float switch reads empty.
+ * @return True while the cistern must be topped up.
+ */
+bool DemandProfile::UpdatePrefill(bool levelValid, uint8_t levelPct, bool cisternEmpty) {
+    if (floatSeen && (cisternEmpty != floatWasEmpty) && levelValid) {
+        bool plausible = cisternEmpty ? (levelPct < PREFILL_START_PCT)
+                                      : (levelPct + PREFILL_FLOAT_TOLERANCE_PCT >= PREFILL_TARGET_PCT);
+        if (plausible && !levelPlausible) {
+            LogSerialn("Cistern level agrees with the float switch, top-ups enabled", true);
+        } else if (!plausible && levelPlausible) {
+            LogSerialn("Cistern level " + String(levelPct) + "% disagrees with the float switch, top-ups disabled", true);
+        }
+        levelPlausible = plausible;
+    }
+    floatSeen = true;
+    floatWasEmpty = cisternEmpty;
+
+    if (!levelValid || !levelPlausible || !peakAhead || (levelPct >= PREFILL_TARGET_PCT)) {
+        prefilling = false;
+    } else if (levelPct < PREFILL_START_PCT) {
+        prefilling = true;
+    }
+    return prefilling;
+}
+
+/**
+ * @brief Checks if a demand peak is expected in the next hours.
+ * @return True if a peak is ahead.
+ */
+bool DemandProfile::isPeakAhead() {
+    return peakAhead;
+}
+
+/**
+ * @brief Checks if the cistern is being topped up.
+ * @return True while topping up.
+ */
+bool DemandProfile::isPrefilling() {
+    return prefilling;
+}
+
+/**
+ * @brief Prints the learned profile on serial, the empty events and the drain rate of each hour.
+ */
+void DemandProfile::Report() {
+    String events = "Demand empty/16:";
+    String drain = "Demand drain %/h:";
+    for (uint8_t h = 0; h < DEMAND_HOURS; h++) {
+        events += " " + String(profile.emptyEvents[h]);
+        drain += " " + String(profile.drainPct[h]);
+    }
+    LogSerialn(events, true);
+    LogSerialn(drain, true);
+}
+
+/**
+ * @brief Averages the hour that ended into its bin of the profile. Its drain rate is only learned
+ * if the pumps were off long enough to measure it.
+ */
+void DemandProfile::CloseHour() {
+    profile.emptyEvents[hour] = Average(profile.emptyEvents[hour], events * DEMAND_EVENT_SCALE);
+    if (offMinutes >= DEMAND_DRAIN_MIN_MINUTES) {
+        profile.drainPct[hour] = Average(profile.drainPct[hour], (uint8_t)min((uint32_t)drainPct * 60UL / offMinutes, 255UL));
+    }
+}
+
+/**
+ * @brief Moves an average towards a sample by 1 / (1 << DEMAND_EMA_SHIFT) of their difference, rounded
+ * the same way up and down, so the average ends within 1 of a steady sample.
+ * @param average The average.
+ * @param sample The sample of the day.
+ * @return The new average.
+ */
+uint8_t DemandProfile::Average(uint8_t average, uint8_t sample) {
+    const int16_t half = 1 << (DEMAND_EMA_SHIFT - 1);
+    if (sample >= average) {
+        return (uint8_t)(average + ((sample - average + half) >> DEMAND_EMA_SHIFT));
+    }
+    return (uint8_t)(average - ((average - sample + half) >> DEMAND_EMA_SHIFT));
+}
@@ -0,0 +1,144 @@
+#include "EventTrace.h"
+
+/**
+ * @brief Constructor for EventTrace class, no edge open and empty histograms.
+ */
+EventTrace::EventTrace() {
+    for (uint8_t e = 0; e < TRACE_EVENT_COUNT; e++) {
+        pending[e].pumps = 0;
+        maxMs[e] = 0;
+        unanswered[e] = 0;
+        prevActive[e] = false;
+        for (uint8_t b = 0; b < TRACE_HIST_BINS; b++) {
+            histogram[e][b] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Opens a trace on the rising edge of an event, drops it if the event clears before the reaction.
+ * @param event The TraceEvent_t.
+ * @param active True while the event condition is read, e.g. the cistern full.
+ * @param pumpsOn Bit per pump output active.
+ * @param nowMs Current time in milliseconds.
+ */
+void EventTrace::Edge(uint8_t event, bool active, uint8_t pumpsOn, uint32_t nowMs) {
+    PendingEdge &p = pending[event];
+    if (active && !prevActive[event]) {
+        p.seq = nextSeq++;
+        p.edgeMs = nowMs;
+        p.pumps = pumpsOn;
+    } else if (!active) {
+        p.pumps = 0;
+    }
+    prevActive[event] = active;
+}
+
+/**
+ * @brief Tags the sensor edges. Must be called right after the sensors are polled.
+ * @param cisternFull True if the cistern sensor reads full.
+ * @param wellEmpty True if the well sensor reads empty.
+ * @param pumpsOn Bit per pump output active (bit 0 = pump 1).
+ * @param nowMs Current time in milliseconds.
+ */
+void EventTrace::Inputs(bool cisternFull, bool wellEmpty, uint8_t pumpsOn, uint32_t nowMs) {
+    /** The levels read at start-up are not edges */
+    if (!initialized) {
+        prevActive[TRACE_CISTERN_FULL] = cisternFull;
+        prevActive[TRACE_WELL_EMPTY] = wellEmpty;
+        initialized = true;
+        return;
+    }
+    Edge(TRACE_CISTERN_FULL, cisternFull, pumpsOn, nowMs);
+    Edge(TRACE_WELL_EMPTY, wellEmpty, pumpsOn, nowMs);
+}
+
+/**
+ * @brief Closes the traces whose pumps were all switched off. Must be called once the outputs were written.
+ * @param pumpsOn Bit per pump output active (bit 0 = pump 1).
+ * @param nowMs Current time in milliseconds.
+ */
+void EventTrace::Outputs(uint8_t pumpsOn, uint32_t nowMs) {
+    for (uint8_t e = 0; e < TRACE_EVENT_COUNT; e++) {
+        PendingEdge &p = pending[e];
+        if (p.pumps == 0) {
+            continue;
+        }
+        uint32_t latencyMs = nowMs - p.edgeMs;
+        if ((p.pumps & pumpsOn) == 0) {
+            uint8_t bin = 0;
+            while ((bin < TRACE_HIST_BINS - 1) && (latencyMs >= (TRACE_BIN0_MS << bin))) {
+                bin++;
+            }
+            histogram[e][bin]++;
+            if (latencyMs > maxMs[e]) {
+                maxMs[e] = latencyMs;
+            }
+            completed[e].seq = p.seq;
+            completed[e].event = e;
+            completed[e].latencyMs = latencyMs;
+            completedMask |= (1U << e);
+            p.pumps = 0;
+        } else if (latencyMs >= TRACE_TIMEOUT_MS) {
+            unanswered[e]++;
+            p.pumps = 0;
+        }
+    }
+}
+
+/**
+ * @brief Gets a trace closed since the last call, for the log.
+ * @param record Where the trace is stored.
+ * @return True if a trace was stored, false if none is left.
+ */
+bool EventTrace::TakeCompleted(TraceRecord &record) {
+    for (uint8_t e = 0; e < TRACE_EVENT_COUNT; e++) {
+        if (completedMask & (1U << e)) {
+            completedMask &= ~(1U << e);
+            record = completed[e];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Gets a histogram bin.
+ * @param event The TraceEvent_t.
+ * @param bin The bin, latencies below TRACE_BIN0_MS << bin, the last bin the longer ones.
+ * @return The number of traces in the bin.
+ */
+uint16_t EventTrace::getBinCount(uint8_t event, uint8_t bin) {
+    return histogram[event][bin];
+}
+
+/**
+ * @brief Gets the worst latency traced for an event.
+ * @param event The TraceEvent_t.
+ * @return The latency in milliseconds, 0 if none was traced.
+ */
+uint32_t EventTrace::getMaxMs(uint8_t event) {
+    return maxMs[event];
+}
+
+/**
+ * @brief Gets the number of edges the pumps did not react to within TRACE_TIMEOUT_MS.
+ * @param event The TraceEvent_t.
+ * @return The count.
+ */
+uint16_t EventTrace::getUnanswered(uint8_t event) {
+    return unanswered[event];
+}
+
+/**
+ * @brief Gets the name of an event for the log.
+ * @param event The TraceEvent_t.
+ * @return The name.
+ */
+const char *EventTrace::getEventName(uint8_t event) {
+    switch (event) {
+        case TRACE_CISTERN_FULL: return "cistern_full";
+        case TRACE_WELL_EMPTY:   return "well_empty";
+        default:                 return "unknown";
+    }
+}
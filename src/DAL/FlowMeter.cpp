@@ -0,0 +1,172 @@
+#include "FlowMeter.h"
+#include "PinChangeInt.h"
+#include "AT24C32_nvm.h"
+#include "utilities.h"
+#include <util/atomic.h>
+
+#define FLOW_ML_MIN_PER_PULSE_MS (60000000UL / FLOW_PULSES_PER_LITER)  /* mL/min of one pulse per millisecond */
+
+static volatile uint16_t isrPulseCount = 0;
+
+/**
+ * @brief Pin change callback of the flow meter, counts the rising edges.
+ * @param level The new level of the pin.
+ */
+static void OnFlowPulse(bool level) {
+    if (level) {
+        isrPulseCount++;
+    }
+}
+
+/**
+ * @brief Constructor for FlowMeter class.
+ * @param pin The pin of the meter output, must support pin change interrupts.
+ */
+FlowMeter::FlowMeter(uint8_t pin) : pin(pin) {
+    for (uint8_t i = 0; i < FLOW_NUM_PUMPS; i++) {
+        liters[i] = 0;
+        pulseRemainder[i] = 0;
+    }
+}
+
+/**
+ * @brief Starts counting the meter pulses.
+ */
+void FlowMeter::begin() {
+    pinMode(pin, INPUT_PULLUP);
+    if (!PinChange_Attach(pin, OnFlowPulse)) {
+        LogSerialn("Flow meter pin " + String(pin) + " has no pin change interrupt", true);
+    }
+}
+
+/**
+ * @brief Takes the pulses counted since the last call and updates the flow rate, the liters
+ * of each pump and the no flow detection. Must be called once per control tick.
+ * @param pump1On True if the pump 1 output is active.
+ * @param pump2On True if the pump 2 output is active.
+ * @param nowMs Current time in milliseconds.
+ */
+void FlowMeter::Update(bool pump1On, bool pump2On, uint32_t nowMs) {
+    uint16_t pulses;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        pulses = isrPulseCount;
+        isrPulseCount = 0;
+    }
+    uint32_t tickMs = nowMs - lastTickMs;
+    lastTickMs = nowMs;
+    bool anyPumpOn = pump1On || pump2On;
+
+    /** The no flow time starts over every time the pumps are energized, the totals are saved when they stop */
+    if (anyPumpOn && !pumpsWereOn) {
+        lastFlowMs = nowMs;
+    } else if (!anyPumpOn && pumpsWereOn && litersChanged) {
+        savePending = true;
+    }
+    pumpsWereOn = anyPumpOn;
+
+    if (tickMs > 0) {
+        uint32_t oldRateDl = rateMlPerMin / 100;
+        int32_t sampleMlPerMin = (int32_t)(pulses * FLOW_ML_MIN_PER_PULSE_MS / tickMs);
+        rateMlPerMin += (sampleMlPerMin - (int32_t)rateMlPerMin) >> FLOW_RATE_EMA_SHIFT;
+        if (rateMlPerMin / 100 != oldRateDl) {
+            version++;
+        }
+    }
+
+    if (pulses > 0) {
+        lastFlowMs = nowMs;
+        if (pump1On && pump2On) {
+            AddPulses(0, pulses - pulses / 2);
+            AddPulses(1, pulses / 2);
+        } else if (pump1On) {
+            AddPulses(0, pulses);
+        } else if (pump2On) {
+            AddPulses(1, pulses);
+        }
+    }
+
+    bool wasNoFlow = noFlow;
+    noFlow = anyPumpOn && (nowMs - lastFlowMs >= FLOW_NO_FLOW_TIMEOUT_MS);
+    if (noFlow && !wasNoFlow) {
+        LogSerialn("No flow for " + String(FLOW_NO_FLOW_TIMEOUT_MS / 1000) + " s with a pump on", true);
+    }
+}
+
+/**
+ * @brief Checks if a pump is energized without flow.
+ * @return True if no pulse was counted for FLOW_NO_FLOW_TIMEOUT_MS while a pump is on, false otherwise.
+ */
+bool FlowMeter::isNoFlow() {
+    return noFlow;
+}
+
+/**
+ * @brief Gets the averaged flow rate.
+ * @return The flow rate in mL/min.
+ */
+uint32_t FlowMeter::getRateMlPerMin() {
+    return rateMlPerMin;
+}
+
+/**
+ * @brief Gets the total liters pumped by a pump.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @return The liters pumped.
+ */
+uint32_t FlowMeter::getLiters(uint8_t pump) {
+    return liters[pump];
+}
+
+/**
+ * @brief Gets a counter that changes every time the liters or the flow rate shown with 0.1 L/min resolution change.
+ * @return The flow meter version.
+ */
+uint8_t FlowMeter::getVersion() {
+    return version;
+}
+
+/**
+ * @brief Loads the liters pumped from EEPROM, an uninitialized EEPROM starts from zero.
+ */
+void FlowMeter::Load() {
+    I2C_EEPROM_ReadBytes(NVM_FLOW_TOTALS_ADDR, (uint8_t*)liters, sizeof(liters));
+    for (uint8_t i = 0; i < FLOW_NUM_PUMPS; i++) {
+        if (liters[i] == 0xFFFFFFFFUL) {
+            liters[i] = 0;
+        }
+    }
+    LogSerialn("Liters pumped loaded from AT24C32: " + String(liters[0]) + " L, " + String(liters[1]) + " L", true);
+}
+
+/**
+ * @brief Saves the liters pumped to EEPROM.
+ */
+void FlowMeter::Save() {
+    I2C_EEPROM_WriteBytes(NVM_FLOW_TOTALS_ADDR, (const uint8_t*)liters, sizeof(liters));
+    litersChanged = false;
+    savePending = false;
+    LogSerialn("Liters pumped saved to AT24C32: " + String(liters[0]) + " L, " + String(liters[1]) + " L", true);
+}
+
+/**
+ * @brief Checks if the liters pumped must be saved, which happens once the pumps stop.
+ * @return True if Save() must be called, false otherwise.
+ */
+bool FlowMeter::isSavePending() {
+    return savePending;
+}
+
+/**
+ * @brief Adds pulses to a pump and counts the whole liters.
+ * @param pump Index of the pump.
+ * @param pulses Number of pulses.
+ */
+void FlowMeter::AddPulses(uint8_t pump, uint16_t pulses) {
+    pulseRemainder[pump] += pulses;
+    while (pulseRemainder[pump] >= FLOW_PULSES_PER_LITER) {
+        pulseRemainder[pump] -= FLOW_PULSES_PER_LITER;
+        liters[pump]++;
+        litersChanged = true;
+        version++;
+    }
+}
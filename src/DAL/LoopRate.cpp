@@ -0,0 +1,72 @@
+#include "LoopRate.h"
+
+static const LoopPeriods LoopRateTable[LOOP_RATE_COUNT] = {
+    {LOOP_RATE_ACTIVE_POLL_MS, LOOP_RATE_ACTIVE_CONTROL_MS},
+    {LOOP_RATE_ALERT_POLL_MS,  LOOP_RATE_ALERT_CONTROL_MS},
+    {LOOP_RATE_IDLE_POLL_MS,   LOOP_RATE_IDLE_CONTROL_MS},
+};
+
+/**
+ * @brief Selects the loop rate from the operating state. Must be called once per control tick.
+ * @param pumpOn True if any pump output is active.
+ * @param startPending True if a pump may start soon, e.g. the cistern reads empty in an automatic mode.
+ * @param userActive True while the user is at the panel.
+ * @param nowMs Current time in milliseconds.
+ * @return True if the rate changed.
+ */
+bool LoopRate::Update(bool pumpOn, bool startPending, bool userActive, uint32_t nowMs) {
+    LoopRate_t wanted = LOOP_RATE_IDLE;
+    if (pumpOn) {
+        wanted = LOOP_RATE_ACTIVE;
+    } else if (startPending || userActive) {
+        wanted = LOOP_RATE_ALERT;
+    }
+
+    /** Speed up at once, slow down only after the hold time */
+    if ((wanted <= rate) || (nowMs - lastCauseMs >= LOOP_RATE_HOLD_MS)) {
+        lastCauseMs = nowMs;
+        if (wanted != rate) {
+            rate = wanted;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Gets the current loop rate.
+ * @return The LoopRate_t.
+ */
+LoopRate_t LoopRate::getRate() {
+    return rate;
+}
+
+/**
+ * @brief Gets the sensor poll period of the current rate.
+ * @return The period in milliseconds.
+ */
+uint16_t LoopRate::getPollMs() {
+    return LoopRateTable[rate].pollMs;
+}
+
+/**
+ * @brief Gets the control tick period of the current rate.
+ * @return The period in milliseconds.
+ */
+uint16_t LoopRate::getControlMs() {
+    return LoopRateTable[rate].controlMs;
+}
+
+/**
+ * @brief Gets the name of a loop rate for the log.
+ * @param rate The LoopRate_t.
+ * @return The name.
+ */
+const char *LoopRate::getRateName(uint8_t rate) {
+    switch (rate) {
+        case LOOP_RATE_ACTIVE: return "active";
+        case LOOP_RATE_ALERT:  return "alert";
+        case LOOP_RATE_IDLE:   return "idle";
+        default:               return "unknown";
+    }
+}
@@ -0,0 +1,190 @@
+#include "ModbusRtu.h"
+
+#define MODBUS_READ_MAX  ((MODBUS_FRAME_MAX - 5) / 2)  /* Registers in a read response: address, function, count, CRC */
+#define MODBUS_WRITE_MAX ((MODBUS_FRAME_MAX - 9) / 2)  /* Registers in a write multiple request */
+
+/**
+ * @brief Gets a big endian 16-bit value from a frame.
+ * @param data Pointer to the high byte.
+ * @return The value.
+ */
+static uint16_t GetU16(const uint8_t *data) {
+    return ((uint16_t)data[0] << 8) | data[1];
+}
+
+/**
+ * @brief Puts a big endian 16-bit value in a frame.
+ * @param data Pointer to the high byte.
+ * @param value The value.
+ */
+static void PutU16(uint8_t *data, uint16_t value) {
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+}
+
+/**
+ * @brief Builds an exception response.
+ * @param response Response buffer, address already set.
+ * @param function The function code of the request.
+ * @param exception The MODBUS_EX_* code.
+ * @return The response length without CRC.
+ */
+static uint8_t BuildException(uint8_t *response, uint8_t function, uint8_t exception) {
+    response[1] = function | 0x80;
+    response[2] = exception;
+    return 3;
+}
+
+/**
+ * @brief Gets the t3.5 silent interval that ends a frame.
+ * @param baud The baud rate.
+ * @return 3.5 character times, or MODBUS_FAST_T35_US above 19200 baud as the standard sets it.
+ */
+uint32_t ModbusRtu_T35Us(uint32_t baud) {
+    return (baud > 19200) ? MODBUS_FAST_T35_US : 3500000UL * MODBUS_CHAR_BITS / baud;
+}
+
+/**
+ * @brief Computes the Modbus CRC-16 (polynomial 0xA001 reflected, initial value 0xFFFF).
+ * @param data The bytes to check.
+ * @param length Number of bytes.
+ * @return The CRC, transmitted low byte first.
+ */
+uint16_t ModbusRtu_Crc16(const uint8_t *data, uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (crc & 0x0001) {
+                crc = (crc >> 1) ^ 0xA001;
+            } else {
+                crc >>= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Handles a complete request frame and builds the response.
+ * Frames with a bad CRC or for another slave are ignored, broadcast writes are executed without response.
+ * A write request is validated as a whole before any register is written.
+ * @param slaveAddr Address of this slave, 1 to 247.
+ * @param map The register map.
+ * @param request The request frame, including its CRC.
+ * @param requestLength Length of the request frame.
+ * @param response Buffer of MODBUS_FRAME_MAX bytes for the response frame.
+ * @return The response length including its CRC, 0 if there is no response to send.
+ */
+uint8_t ModbusRtu_HandleFrame(uint8_t slaveAddr, const ModbusRegisterMap &map,
+                              const uint8_t *request, uint8_t requestLength, uint8_t *response) {
+    if ((requestLength < 4) || (requestLength > MODBUS_FRAME_MAX)) {
+        return 0;
+    }
+    uint16_t crc = ModbusRtu_Crc16(request, requestLength - 2);
+    if ((request[requestLength - 2] != (crc & 0xFF)) || (request[requestLength - 1] != (crc >> 8))) {
+        return 0;
+    }
+    uint8_t address = request[0];
+    if ((address != slaveAddr) && (address != MODBUS_BROADCAST_ADDR)) {
+        return 0;
+    }
+
+    uint8_t function = request[1];
+    uint8_t length = 0;
+    response[0] = slaveAddr;
+
+    switch (function) {
+        case MODBUS_FC_READ_HOLDING:
+        case MODBUS_FC_READ_INPUT: {
+            if (requestLength != 8) {
+                length = BuildException(response, function, MODBUS_EX_ILLEGAL_VALUE);
+                break;
+            }
+            uint16_t start = GetU16(&request[2]);
+            uint16_t quantity = GetU16(&request[4]);
+            bool holding = (function == MODBUS_FC_READ_HOLDING);
+            uint16_t numRegs = holding ? map.numHolding : map.numInput;
+            if ((quantity == 0) || (quantity > MODBUS_READ_MAX)) {
+                length = BuildException(response, function, MODBUS_EX_ILLEGAL_VALUE);
+            } else if ((uint32_t)start + quantity > numRegs) {
+                length = BuildException(response, function, MODBUS_EX_ILLEGAL_ADDRESS);
+            } else {
+                response[1] = function;
+                response[2] = quantity * 2;
+                for (uint16_t i = 0; i < quantity; i++) {
+                    PutU16(&response[3 + i * 2], holding ? map.readHolding(start + i) : map.readInput(start + i));
+                }
+                length = 3 + quantity * 2;
+            }
+            break;
+        }
+        case MODBUS_FC_WRITE_SINGLE: {
+            if (requestLength != 8) {
+                length = BuildException(response, function, MODBUS_EX_ILLEGAL_VALUE);
+                break;
+            }
+            uint16_t addr = GetU16(&request[2]);
+            uint16_t value = GetU16(&request[4]);
+            uint8_t exception = (addr < map.numHolding) ? map.validateHolding(addr, value) : MODBUS_EX_ILLEGAL_ADDRESS;
+            if (exception != MODBUS_EX_NONE) {
+                length = BuildException(response, function, exception);
+            } else {
+                map.writeHolding(addr, value);
+                map.commitWrites();
+                for (uint8_t i = 1; i < 6; i++) {
+                    response[i] = request[i];
+                }
+                length = 6;
+            }
+            break;
+        }
+        case MODBUS_FC_WRITE_MULTI: {
+            if (requestLength < 9) {
+                length = BuildException(response, function, MODBUS_EX_ILLEGAL_VALUE);
+                break;
+            }
+            uint16_t start = GetU16(&request[2]);
+            uint16_t quantity = GetU16(&request[4]);
+            uint8_t byteCount = request[6];
+            if ((quantity == 0) || (quantity > MODBUS_WRITE_MAX) || (byteCount != quantity * 2) ||
+                (requestLength != 9 + byteCount)) {
+                length = BuildException(response, function, MODBUS_EX_ILLEGAL_VALUE);
+                break;
+            }
+            if ((uint32_t)start + quantity > map.numHolding) {
+                length = BuildException(response, function, MODBUS_EX_ILLEGAL_ADDRESS);
+                break;
+            }
+            uint8_t exception = MODBUS_EX_NONE;
+            for (uint16_t i = 0; (i < quantity) && (exception == MODBUS_EX_NONE); i++) {
+                exception = map.validateHolding(start + i, GetU16(&request[7 + i * 2]));
+            }
+            if (exception != MODBUS_EX_NONE) {
+                length = BuildException(response, function, exception);
+                break;
+            }
+            for (uint16_t i = 0; i < quantity; i++) {
+                map.writeHolding(start + i, GetU16(&request[7 + i * 2]));
+            }
+            map.commitWrites();
+            response[1] = function;
+            PutU16(&response[2], start);
+            PutU16(&response[4], quantity);
+            length = 6;
+            break;
+        }
+        default:
+            length = BuildException(response, function, MODBUS_EX_ILLEGAL_FUNCTION);
+            break;
+    }
+
+    /** Broadcast requests are never answered */
+    if (address == MODBUS_BROADCAST_ADDR) {
+        return 0;
+    }
+    crc = ModbusRtu_Crc16(response, length);
+    response[length] = crc & 0xFF;
+    response[length + 1] = crc >> 8;
+    return length + 2;
+}
@@ -0,0 +1,298 @@
+#include "PumpControl.h"
+#include "Bench.h"
+
+/**
+ * @brief Constructor for PumpControl class, both pumps off and every mode in its power-up state.
+ * @param wellRecovery Gate of the pump starts and stops with the well level.
+ * @param demandBoost Decides when the automatic modes run both pumps.
+ * @param pumpStats Fill cycle statistics of the sensors mode.
+ */
+PumpControl::PumpControl(WellRecovery &wellRecovery, DemandBoost &demandBoost, PumpStats &pumpStats)
+    : wellRecovery(wellRecovery), demandBoost(demandBoost), pumpStats(pumpStats) {}
+
+/**
+ * @brief Controls the selection of control modes based on push button input.
+ * This function manages the control mode selection logic, including toggling between
+ * manual and automatic modes based on sensor states.
+ * @param mode The current control mode selected by the user.
+ * @param modeButton True while the mode push button is pressed.
+ * @return The updated control mode after processing the input.
+ */
+CtrlModeSel_t PumpControl::SelectMode(CtrlModeSel_t mode, bool modeButton) {
+    CtrlModeSel_t retCtrlMode = mode;
+
+    /** If input is AUTO_BY_SENSORS, always return AUTO_BY_SENSORS */
+    if (mode == CTRL_AUTO_BY_SENSORS) {
+        if (prevModeButton && !modeButton) {
+            prevAutoMode = CTRL_AUTO_BY_SENSORS;
+            retCtrlMode = CTRL_MODE_MANUAL;
+        } else {
+            retCtrlMode = CTRL_AUTO_BY_SENSORS;
+        }
+    } else if (mode == CTRL_AUTO_BY_TIMER) {  /** If input is AUTO_BY_TIMER, always return AUTO_BY_TIMER */
+        if (prevModeButton && !modeButton) {
+            prevAutoMode = CTRL_AUTO_BY_TIMER;
+            retCtrlMode = CTRL_MODE_MANUAL;
+        } else {
+            retCtrlMode = CTRL_AUTO_BY_TIMER;
+        }
+    } else if (mode == CTRL_MODE_MANUAL) {  /** If input is MANUAL, allow toggling back to previous AUTO mode */
+        if (prevModeButton && !modeButton) {
+            retCtrlMode = prevAutoMode;
+        } else {
+            retCtrlMode = CTRL_MODE_MANUAL;
+        }
+    }
+
+    prevModeButton = modeButton;
+    return retCtrlMode;
+}
+
+/**
+ * @brief Decides the pump outputs of a control tick in the given mode.
+ * The manual mode is always served, the automatic modes keep both pumps off while a fault is
+ * latched or outside the schedule. Fill cycles and boosts the mode cannot complete are aborted.
+ * @param mode The control mode.
+ * @param in The sensor states and the state of the other modules.
+ * @param cycleBudgetsMs Cycle time of each pump in the timer mode, 0 = not set.
+ * @param nowMs Current time in milliseconds.
+ * @return The control mode to use from now on, an unknown mode falls back to the sensors mode.
+ */
+CtrlModeSel_t PumpControl::Tick(CtrlModeSel_t mode, const PumpControlInputs &in,
+                                const uint32_t cycleBudgetsMs[PUMP_CONTROL_NUM_PUMPS], uint32_t nowMs) {
+    /** Pumps assigned by a coordinator are neither alternated nor boosted by this board */
+    bool coordinated = (in.coordAssigned != PUMP_CONTROL_NOT_COORDINATED);
+
+    /** Fill cycles are only measured while the pumps are controlled by sensors within the schedule */
+    if (((mode != CTRL_AUTO_BY_SENSORS) || !in.scheduleAllowed || coordinated) && pumpStats.isCycleActive()) {
+        pumpStats.CycleAbort();
+    }
+
+    /** Only the automatic modes boost, a fill interrupted by a mode change, a fault or the schedule is not learned */
+    if ((mode == CTRL_MODE_MANUAL) || in.fault || !in.scheduleAllowed || coordinated) {
+        demandBoost.Abort();
+    }
+
+    if (mode == CTRL_MODE_MANUAL) {
+        RunManual(in);
+        /** The automatic modes must not restart a pump the user just stopped before its minimum off time */
+        wellRecovery.TrackPump(0, pumpOn[0], nowMs);
+        wellRecovery.TrackPump(1, pumpOn[1], nowMs);
+    } else if (in.fault) {
+        /** Safe state: the automatic modes keep both pumps off while a sensor fault is latched */
+        RunSafeState(nowMs);
+    } else if (!in.scheduleAllowed) {
+        /** Outside of the pumping windows the automatic modes keep both pumps off, unless the cistern is critically low */
+        RunSafeState(nowMs);
+    } else if (mode == CTRL_AUTO_BY_SENSORS) {
+        BENCH_BEGIN(BENCH_CTRL_SENSORS);
+        RunBySensors(in, nowMs);
+        BENCH_END(BENCH_CTRL_SENSORS);
+    } else if (mode == CTRL_AUTO_BY_TIMER) {
+        BENCH_BEGIN(BENCH_CTRL_TIMER);
+        RunByTimer(in, cycleBudgetsMs, nowMs);
+        BENCH_END(BENCH_CTRL_TIMER);
+    } else {
+        mode = CTRL_AUTO_BY_SENSORS;
+    }
+    return mode;
+}
+
+/**
+ * @brief Gets the output decided by the last tick.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @return True if the pump must be on.
+ */
+bool PumpControl::isPumpOn(uint8_t pump) {
+    return pumpOn[pump];
+}
+
+/**
+ * @brief Switches both pumps off through the well recovery, so their off time is tracked.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpControl::RunSafeState(uint32_t nowMs) {
+    pumpOn[0] = wellRecovery.RequestPump(0, false, nowMs);
+    pumpOn[1] = wellRecovery.RequestPump(1, false, nowMs);
+}
+
+/**
+ * @brief Controls the pumps based on manual selection.
+ * This function allows the user to manually select which pump to activate
+ * using a push button. It also checks the well sensor state to ensure
+ * pumps are only activated when the well is not empty.
+ * @param in The sensor states and the pump selection button.
+ */
+void PumpControl::RunManual(const PumpControlInputs &in) {
+    if (in.wellEmpty) {
+        pumpOn[0] = false;
+        pumpOn[1] = false;
+        return;  /** If well is empty, deactivate both pumps */
+    }
+
+    if (!in.cisternEmpty) {
+        pumpOn[0] = false;
+        pumpOn[1] = false;
+        return;  /** If cistern is full, deactivate both pumps */
+    }
+
+    /** Only allow manual pump selection if mode is not AUTO */
+    if (prevPumpSelButton && !in.pumpSelButton) {
+        manualSel = static_cast<ManualPumpSel_t>(static_cast<int>(manualSel) + 1);
+        if (manualSel > SELECT_PUMP_BOTH) {
+            manualSel = SELECT_PUMP_NONE;
+        }
+    }
+    prevPumpSelButton = in.pumpSelButton;
+
+    /** Activate selected pump */
+    pumpOn[0] = (manualSel == SELECT_PUMP_1) || (manualSel == SELECT_PUMP_BOTH);
+    pumpOn[1] = (manualSel == SELECT_PUMP_2) || (manualSel == SELECT_PUMP_BOTH);
+}
+
+/**
+ * @brief Controls the pumps based on sensor states.
+ * It alternates between two pumps when filling the cistern and pauses operation if the well is empty,
+ * with the minimum off time and resume delay of the well recovery to avoid short-cycling the pump.
+ * If the fill falls behind the demand boost deadline, the idle pump is started too until the cistern is full.
+ * Every fill cycle and well empty pause is reported to the pump statistics.
+ * Ahead of a demand peak the cistern is topped up on request of the caller, which is not a fill cycle.
+ * The float switch reads full during a top-up, so it is bounded to PUMP_PREFILL_MAX_MS and to one per
+ * float cycle, in case the level the caller ends it on is wrong.
+ * On a coordination bus the pumps assigned by the coordinator run instead of the alternated one.
+ * @param in The sensor states, the top-up request and the coordinator assignment.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpControl::RunBySensors(const PumpControlInputs &in, uint32_t nowMs) {
+    FillState &s = sensorsMode;
+
+    wellRecovery.UpdateWell(in.wellEmpty, nowMs);
+
+    /** A top-up is not coordinated, the coordinator only assigns pumps to empty cisterns */
+    bool prefill = in.prefill && (in.coordAssigned == PUMP_CONTROL_NOT_COORDINATED);
+
+    /** If cistern is empty and we are not already waiting for it to fill, a top-up going on becomes a fill cycle */
+    if (in.cisternEmpty && s.lastCisternWasFull) {
+        s.waitingForFull = true;
+        s.lastCisternWasFull = false;
+        s.pumpPausedByWell = false;
+        s.prefilling = false;
+        s.prefillSpent = false;
+        pumpStats.CycleStart(s.usePump1 ? 0 : 1, nowMs);
+    }
+
+    /** If we are waiting for cistern to fill and it is now full */
+    if (s.waitingForFull && !s.prefilling && !in.cisternEmpty) {
+        pumpStats.CycleEnd(nowMs);
+        s.waitingForFull = false;
+        s.lastCisternWasFull = true;
+        s.pumpPausedByWell = false;
+        /** Alternate the pump for next cycle */
+        s.usePump1 = !s.usePump1;
+    }
+
+    /** Top up the cistern before it gets empty, until the caller reports the target level. The float
+     *  switch reads full from its high mark down to its low mark and cannot end it, the time bound does */
+    if (!s.waitingForFull && prefill && !s.prefillSpent) {
+        s.waitingForFull = true;
+        s.prefilling = true;
+        s.prefillSpent = true;
+        s.prefillStartMs = nowMs;
+        s.pumpPausedByWell = false;
+    } else if (s.prefilling && (!prefill || (nowMs - s.prefillStartMs >= PUMP_PREFILL_MAX_MS))) {
+        s.waitingForFull = false;
+        s.prefilling = false;
+        s.pumpPausedByWell = false;
+        s.usePump1 = !s.usePump1;
+    }
+
+    /** A top-up is not late, only the fill cycles of an empty cistern are boosted */
+    demandBoost.Update(s.waitingForFull && !s.prefilling, pumpOn[0] || pumpOn[1], nowMs);
+    bool boost = demandBoost.isActive();
+    if (boost) {
+        pumpStats.MarkCycleBoosted();
+    }
+
+    /** Run the selected pump while waiting for the cistern to fill, and the idle one too when boosted.
+     *  The well recovery pauses and resumes them and staggers their starts */
+    bool requestPump1 = s.waitingForFull && (s.usePump1 || boost);
+    bool requestPump2 = s.waitingForFull && (!s.usePump1 || boost);
+    if (in.coordAssigned != PUMP_CONTROL_NOT_COORDINATED) {
+        requestPump1 = s.waitingForFull && (in.coordAssigned & 0x01);
+        requestPump2 = s.waitingForFull && (in.coordAssigned & 0x02);
+    }
+    pumpOn[0] = wellRecovery.RequestPump(0, requestPump1, nowMs);
+    pumpOn[1] = wellRecovery.RequestPump(1, requestPump2, nowMs);
+
+    /** Report the well empty pauses of the current cycle */
+    bool pausedNow = s.waitingForFull && !s.prefilling && wellRecovery.isPausedByWell(s.usePump1 ? 0 : 1);
+    if (pausedNow && !s.pumpPausedByWell) {
+        pumpStats.PauseStart(nowMs);
+    } else if (!pausedNow && s.pumpPausedByWell) {
+        pumpStats.PauseEnd(nowMs);
+    }
+    s.pumpPausedByWell = pausedNow;
+}
+
+/**
+ * @brief Controls the pumps based on a timer, with the configured cycle time of each pump.
+ * It alternates between two pumps when filling the cistern and pauses operation if the well is empty.
+ * The pumps will be active for their precomputed cycle budget and then switch to the other pump. Cycles are
+ * measured with millis() so setting the RTC does not shorten or stretch them.
+ * If the well is empty, the active pump is paused by the well recovery and its cycle time restarts when it resumes.
+ * If the fill falls behind the demand boost deadline, the idle pump is started too until the cistern is full.
+ * @param in The sensor states.
+ * @param cycleBudgetsMs Cycle time of each pump, 0 = not set.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpControl::RunByTimer(const PumpControlInputs &in, const uint32_t cycleBudgetsMs[PUMP_CONTROL_NUM_PUMPS], uint32_t nowMs) {
+    FillState &s = timerMode;
+
+    wellRecovery.UpdateWell(in.wellEmpty, nowMs);
+
+    /** If either pump cycle time is default, do not start alternation, keep both pumps off and reset state */
+    if ((cycleBudgetsMs[0] == 0) || (cycleBudgetsMs[1] == 0)) {
+        RunSafeState(nowMs);
+        demandBoost.Abort();
+        s.waitingForFull = false;
+        s.lastCisternWasFull = true;
+        s.pumpPausedByWell = false;
+        return;
+    }
+
+    /** Start cycling when cistern becomes empty */
+    if (in.cisternEmpty && s.lastCisternWasFull) {
+        s.waitingForFull = true;
+        s.lastCisternWasFull = false;
+        s.pumpPausedByWell = false;
+        s.lastSwitchMs = nowMs;
+    }
+
+    /** Stop cycling when cistern becomes full */
+    if (s.waitingForFull && !in.cisternEmpty) {
+        s.waitingForFull = false;
+        s.lastCisternWasFull = true;
+        s.pumpPausedByWell = false;
+    }
+
+    /** Switch pumps once the current pump used up its cycle budget */
+    if (s.waitingForFull && !s.pumpPausedByWell && (nowMs - s.lastSwitchMs >= cycleBudgetsMs[s.usePump1 ? 0 : 1])) {
+        s.usePump1 = !s.usePump1;
+        s.lastSwitchMs = nowMs;
+    }
+
+    demandBoost.Update(s.waitingForFull, pumpOn[0] || pumpOn[1], nowMs);
+    bool boost = demandBoost.isActive();
+
+    /** Run the selected pump while cycling, and the idle one too when boosted.
+     *  The well recovery pauses and resumes them and staggers their starts */
+    pumpOn[0] = wellRecovery.RequestPump(0, s.waitingForFull && (s.usePump1 || boost), nowMs);
+    pumpOn[1] = wellRecovery.RequestPump(1, s.waitingForFull && (!s.usePump1 || boost), nowMs);
+
+    /** Restart the cycle time when the pump resumes after a well pause to avoid an immediate switch */
+    bool pausedNow = s.waitingForFull && wellRecovery.isPausedByWell(s.usePump1 ? 0 : 1);
+    if (!pausedNow && s.pumpPausedByWell) {
+        s.lastSwitchMs = nowMs;
+    }
+    s.pumpPausedByWell = pausedNow;
+}
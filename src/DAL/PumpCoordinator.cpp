@@ -0,0 +1,416 @@
+#include "PumpCoordinator.h"
+#include "ModbusRtu.h"
+
+#define COORD_FLAG_DEMAND       (0x01)  /* Cistern waiting to be filled */
+#define COORD_FLAG_P1_AVAILABLE (0x02)
+#define COORD_FLAG_P2_AVAILABLE (0x04)
+#define COORD_FLAG_P1_ON        (0x08)
+#define COORD_FLAG_P2_ON        (0x10)
+#define COORD_FLAG_ASSIGNMENT   (0x80)  /* Sender is the coordinator, the frame carries the assignment */
+
+/**
+ * @brief Gets a big endian 32-bit value from a frame.
+ * @param data Pointer to the most significant byte.
+ * @return The value.
+ */
+static uint32_t GetU32(const uint8_t *data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+/**
+ * @brief Puts a big endian 32-bit value in a frame.
+ * @param data Pointer to the most significant byte.
+ * @param value The value.
+ */
+static void PutU32(uint8_t *data, uint32_t value) {
+    data[0] = value >> 24;
+    data[1] = (value >> 16) & 0xFF;
+    data[2] = (value >> 8) & 0xFF;
+    data[3] = value & 0xFF;
+}
+
+/**
+ * @brief Constructor.
+ * @param id Node id of this board, 1 to COORD_MAX_NODES, unique on the bus.
+ */
+PumpCoordinator::PumpCoordinator(uint8_t id) : nodeId(id) {
+    for (uint8_t i = 0; i < COORD_MAX_NODES; i++) {
+        nodes[i].lastHeardMs = 0;
+        nodes[i].runtimeMin[0] = 0;
+        nodes[i].runtimeMin[1] = 0;
+        nodes[i].flags = 0;
+        nodes[i].heard = false;
+    }
+}
+
+/**
+ * @brief Checks if a node was heard recently. This node is always alive.
+ * @param id The node id.
+ * @param nowMs Current time in milliseconds.
+ * @return True if the node is alive.
+ */
+bool PumpCoordinator::isAlive(uint8_t id, uint32_t nowMs) {
+    if (id == nodeId) {
+        return true;
+    }
+    const CoordNode &node = nodes[id - 1];
+    return node.heard && (nowMs - node.lastHeardMs < COORD_NODE_TIMEOUT_MS);
+}
+
+/**
+ * @brief Checks if this node is still listening to the bus after a reset, the first call starts
+ * the listen time. Its pumps would otherwise start on their own while the other boards already
+ * run theirs.
+ * @param nowMs Current time in milliseconds.
+ * @return True during the first COORD_LISTEN_MS.
+ */
+bool PumpCoordinator::isListening(uint32_t nowMs) {
+    if (!started) {
+        started = true;
+        startMs = nowMs;
+    }
+    if (!listened && (nowMs - startMs >= COORD_LISTEN_MS)) {
+        listened = true;
+    }
+    return !listened;
+}
+
+/**
+ * @brief Gets the node id following another one in the token ring. Every id is visited,
+ * so a node joining the bus is found on the next round.
+ * @param after The node id.
+ * @return The next node id.
+ */
+uint8_t PumpCoordinator::NextNode(uint8_t after) {
+    return (after >= COORD_MAX_NODES) ? 1 : after + 1;
+}
+
+/**
+ * @brief Picks the idle pump to start next: the available pump with the least runtime, on a well
+ * that feeds no running pump if there is one. Ties go to the lowest node id.
+ * @param available Bitmap of the available pumps.
+ * @param running Bitmap of the pumps that keep running.
+ * @return The bit of the pump, -1 if none is available.
+ */
+int8_t PumpCoordinator::PickIdlePump(uint16_t available, uint16_t running) {
+    int8_t best = -1;
+    uint32_t bestRuntime = 0;
+    bool bestWellBusy = false;
+    for (uint8_t bit = 0; bit < COORD_MAX_NODES * 2; bit++) {
+        if (!(available & (1U << bit)) || (running & (1U << bit))) {
+            continue;
+        }
+        uint32_t runtime = nodes[bit / 2].runtimeMin[bit % 2];
+        bool wellBusy = running & (1U << (bit ^ 1));
+        if ((best < 0) || (!wellBusy && bestWellBusy) || ((wellBusy == bestWellBusy) && (runtime < bestRuntime))) {
+            best = bit;
+            bestRuntime = runtime;
+            bestWellBusy = wellBusy;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Computes the pumps to run, done by the coordinator each time it holds the token.
+ * Pumps already assigned keep running while they are available, then one more available pump,
+ * picked by PickIdlePump(), is started if the limit allows it. A long fill at the limit rotates
+ * the pumps once the running one with the most runtime is COORD_ROTATE_MIN ahead of the pump
+ * that would replace it.
+ * @param nowMs Current time in milliseconds.
+ * @return The assignment bitmap.
+ */
+uint16_t PumpCoordinator::ComputeAssignment(uint32_t nowMs) {
+    bool demand = false;
+    uint16_t available = 0;
+    for (uint8_t id = 1; id <= COORD_MAX_NODES; id++) {
+        if (!isAlive(id, nowMs)) {
+            continue;
+        }
+        uint8_t flags = nodes[id - 1].flags;
+        demand = demand || (flags & COORD_FLAG_DEMAND);
+        if (flags & COORD_FLAG_P1_AVAILABLE) available |= 1U << ((id - 1) * 2);
+        if (flags & COORD_FLAG_P2_AVAILABLE) available |= 1U << ((id - 1) * 2 + 1);
+    }
+    if (!demand) {
+        return 0;
+    }
+
+    uint16_t keep = 0;
+    uint8_t running = 0;
+    for (uint8_t bit = 0; bit < COORD_MAX_NODES * 2; bit++) {
+        if ((assignment & available & (1U << bit)) && (running < COORD_MAX_RUNNING_PUMPS)) {
+            keep |= 1U << bit;
+            running++;
+        }
+    }
+    if (running < COORD_MAX_RUNNING_PUMPS) {
+        int8_t best = PickIdlePump(available, keep);
+        if (best >= 0) {
+            keep |= 1U << best;
+        }
+        return keep;
+    }
+
+    /** At the limit, the running pump with the most runtime is stopped if it is far ahead of the
+     *  pump picked to replace it, which is then started on the next round. The replacement is picked
+     *  as the next round will, or a well shared with the stopped pump would bring it straight back */
+    int8_t worst = -1;
+    uint32_t worstRuntime = 0;
+    for (uint8_t bit = 0; bit < COORD_MAX_NODES * 2; bit++) {
+        uint32_t runtime = nodes[bit / 2].runtimeMin[bit % 2];
+        if ((keep & (1U << bit)) && ((worst < 0) || (runtime > worstRuntime))) {
+            worst = bit;
+            worstRuntime = runtime;
+        }
+    }
+    if (worst < 0) {
+        return keep;
+    }
+    uint16_t rest = keep & ~(1U << worst);
+    int8_t best = PickIdlePump(available & ~(1U << worst), rest);
+    if ((best >= 0) && (worstRuntime > nodes[best / 2].runtimeMin[best % 2] + COORD_ROTATE_MIN)) {
+        return rest;
+    }
+    return keep;
+}
+
+/**
+ * @brief Builds the status frame of this node.
+ * @param next Node id the token is passed to.
+ * @param nowMs Current time in milliseconds.
+ * @param frame Buffer of COORD_FRAME_LEN bytes.
+ * @return The frame length.
+ */
+uint8_t PumpCoordinator::BuildFrame(uint8_t next, uint32_t nowMs, uint8_t *frame) {
+    const CoordNode &self = nodes[nodeId - 1];
+    frame[0] = nodeId;
+    frame[1] = COORD_MSG_STATUS;
+    frame[2] = next;
+    frame[3] = self.flags | (isCoordinator(nowMs) ? COORD_FLAG_ASSIGNMENT : 0);
+    PutU32(&frame[4], self.runtimeMin[0]);
+    PutU32(&frame[8], self.runtimeMin[1]);
+    frame[12] = assignment >> 8;
+    frame[13] = assignment & 0xFF;
+    uint16_t crc = ModbusRtu_Crc16(frame, COORD_FRAME_LEN - 2);
+    frame[14] = crc & 0xFF;
+    frame[15] = crc >> 8;
+    return COORD_FRAME_LEN;
+}
+
+/**
+ * @brief Updates the status of this node. Must be called once per control tick.
+ * @param fillDemand True while the cistern is waiting to be filled.
+ * @param pump1Available True if pump 1 may be assigned.
+ * @param pump2Available True if pump 2 may be assigned.
+ * @param pump1On True if the pump 1 output is active.
+ * @param pump2On True if the pump 2 output is active.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpCoordinator::UpdateLocal(bool fillDemand, bool pump1Available, bool pump2Available,
+                                  bool pump1On, bool pump2On, uint32_t nowMs) {
+    CoordNode &self = nodes[nodeId - 1];
+    uint32_t tickMs = nowMs - lastUpdateMs;
+    lastUpdateMs = nowMs;
+
+    bool on[2] = {pump1On, pump2On};
+    for (uint8_t i = 0; i < 2; i++) {
+        if (on[i]) {
+            runMs[i] += tickMs;
+            self.runtimeMin[i] += runMs[i] / 60000UL;
+            runMs[i] %= 60000UL;
+        }
+    }
+    self.flags = (fillDemand ? COORD_FLAG_DEMAND : 0) |
+                 (pump1Available ? COORD_FLAG_P1_AVAILABLE : 0) |
+                 (pump2Available ? COORD_FLAG_P2_AVAILABLE : 0) |
+                 (pump1On ? COORD_FLAG_P1_ON : 0) |
+                 (pump2On ? COORD_FLAG_P2_ON : 0);
+    self.lastHeardMs = nowMs;
+    self.heard = true;
+}
+
+/**
+ * @brief Handles a frame received from the bus. Frames with a bad CRC or length are ignored.
+ * @param frame The frame, including its CRC.
+ * @param length The frame length.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpCoordinator::HandleFrame(const uint8_t *frame, uint8_t length, uint32_t nowMs) {
+    if (length != COORD_FRAME_LEN) {
+        return;
+    }
+    uint16_t crc = ModbusRtu_Crc16(frame, COORD_FRAME_LEN - 2);
+    if ((frame[14] != (crc & 0xFF)) || (frame[15] != (crc >> 8)) || (frame[1] != COORD_MSG_STATUS)) {
+        return;
+    }
+    uint8_t src = frame[0];
+    if ((src == 0) || (src > COORD_MAX_NODES) || (src == nodeId)) {
+        return;
+    }
+
+    CoordNode &node = nodes[src - 1];
+    node.flags = frame[3];
+    node.runtimeMin[0] = GetU32(&frame[4]);
+    node.runtimeMin[1] = GetU32(&frame[8]);
+    node.lastHeardMs = nowMs;
+    node.heard = true;
+
+    /** The assignment of any node that claims the coordinator is taken, also from a higher node id that
+     *  has not heard this one yet, so a new coordinator carries on from the pumps last started instead of
+     *  adding its own on top. Only the token holder sends, so the assignment changes one step at a time.
+     *  Until one is heard after a reset the pumps reported on stand for it */
+    bool listening = isListening(nowMs);
+    if (node.flags & COORD_FLAG_ASSIGNMENT) {
+        assignment = ((uint16_t)frame[12] << 8) | frame[13];
+        lastAssignmentMs = nowMs;
+        assignmentHeard = true;
+    } else if (listening && !assignmentHeard) {
+        uint8_t bit = (src - 1) * 2;
+        assignment &= ~(3U << bit);
+        if (node.flags & COORD_FLAG_P1_ON) assignment |= 1U << bit;
+        if (node.flags & COORD_FLAG_P2_ON) assignment |= 1U << (bit + 1);
+    }
+
+    /** Any frame on the bus means the token is alive, the node it names holds it now */
+    lastBusMs = nowMs;
+    pendingNext = 0;
+    if ((frame[2] == nodeId) && !listening) {
+        tokenHeld = true;
+        tokenMs = nowMs;
+    }
+}
+
+/**
+ * @brief Runs the token timers. Must be called from the main loop, frequently enough to answer
+ * within COORD_REPLY_TIMEOUT_MS - COORD_TOKEN_HOLD_MS.
+ * @param nowMs Current time in milliseconds.
+ * @param frame Buffer of COORD_FRAME_LEN bytes for the frame to send.
+ * @return The length of the frame to send, 0 if there is nothing to send.
+ */
+uint8_t PumpCoordinator::Poll(uint32_t nowMs, uint8_t *frame) {
+    /** A board that just reset stays silent, the coordinator keeps its role until this one has
+     *  heard the pumps running */
+    if (isListening(nowMs)) {
+        /** The token lost wait ends with the listen time at the latest, so boards that reset
+         *  together still regenerate the token in turn */
+        if (nowMs - lastBusMs > COORD_TOKEN_LOST_MS) {
+            lastBusMs = nowMs - COORD_TOKEN_LOST_MS;
+        }
+        return 0;
+    }
+
+    /** The node the token was passed to did not answer, pass it to the one after */
+    if ((pendingNext != 0) && (nowMs - sentMs >= COORD_REPLY_TIMEOUT_MS)) {
+        uint8_t next = NextNode(pendingNext);
+        if (next == nodeId) {
+            pendingNext = 0;
+            tokenHeld = true;
+            tokenMs = nowMs;
+        } else {
+            pendingNext = next;
+            sentMs = nowMs;
+            lastBusMs = nowMs;
+            return BuildFrame(next, nowMs, frame);
+        }
+    }
+
+    /** Lower node ids wait less, so exactly one node regenerates a lost token */
+    if (!tokenHeld && (pendingNext == 0) &&
+        (nowMs - lastBusMs >= COORD_TOKEN_LOST_MS + (nodeId - 1) * COORD_REPLY_TIMEOUT_MS)) {
+        tokenHeld = true;
+        tokenMs = nowMs - COORD_TOKEN_HOLD_MS;
+    }
+
+    if (!tokenHeld || (nowMs - tokenMs < COORD_TOKEN_HOLD_MS)) {
+        return 0;
+    }
+    tokenHeld = false;
+
+    if (isCoordinator(nowMs)) {
+        assignment = ComputeAssignment(nowMs);
+        lastAssignmentMs = nowMs;
+        assignmentHeard = true;
+    }
+
+    uint8_t next = NextNode(nodeId);
+    if (next == nodeId) {
+        return 0;
+    }
+    pendingNext = next;
+    sentMs = nowMs;
+    lastBusMs = nowMs;
+    return BuildFrame(next, nowMs, frame);
+}
+
+/**
+ * @brief Checks if this node is the coordinator, the lowest node id alive.
+ * @param nowMs Current time in milliseconds.
+ * @return True if this node assigns the pumps.
+ */
+bool PumpCoordinator::isCoordinator(uint32_t nowMs) {
+    for (uint8_t id = 1; id < nodeId; id++) {
+        if (isAlive(id, nowMs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks if the pumps follow the coordinator assignment. A board alone on the bus, or one
+ * that lost the coordinator, alternates its own pumps as without coordination. While it listens
+ * after a reset its pumps stay off.
+ * @param nowMs Current time in milliseconds.
+ * @return True if isAssigned() decides which pumps run.
+ */
+bool PumpCoordinator::isCoordinated(uint32_t nowMs) {
+    if (isListening(nowMs)) {
+        return true;
+    }
+    if (getNodeCount(nowMs) < 2) {
+        return false;
+    }
+    return assignmentHeard && (nowMs - lastAssignmentMs < COORD_NODE_TIMEOUT_MS);
+}
+
+/**
+ * @brief Checks if the coordinator assigned a pump of this node to run. The assignment heard while
+ * listening after a reset may still name a pump the coordinator is about to give up on, it only
+ * applies once the listen time is over.
+ * @param pump The pump index, 0 or 1.
+ * @return True if the pump should run.
+ */
+bool PumpCoordinator::isAssigned(uint8_t pump) {
+    return listened && (assignment & (1U << ((nodeId - 1) * 2 + pump)));
+}
+
+/**
+ * @brief Checks if a pump of any node alive on the bus runs, this one included, as last reported.
+ * All the boards fill the same cistern, so it can get full while the pumps of this board are off.
+ * @param nowMs Current time in milliseconds.
+ * @return True if a pump runs somewhere on the bus.
+ */
+bool PumpCoordinator::isAnyPumpOn(uint32_t nowMs) {
+    for (uint8_t id = 1; id <= COORD_MAX_NODES; id++) {
+        if (isAlive(id, nowMs) && (nodes[id - 1].flags & (COORD_FLAG_P1_ON | COORD_FLAG_P2_ON))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Gets the number of nodes alive on the bus, this one included.
+ * @param nowMs Current time in milliseconds.
+ * @return The node count.
+ */
+uint8_t PumpCoordinator::getNodeCount(uint32_t nowMs) {
+    uint8_t count = 0;
+    for (uint8_t id = 1; id <= COORD_MAX_NODES; id++) {
+        if (isAlive(id, nowMs)) {
+            count++;
+        }
+    }
+    return count;
+}
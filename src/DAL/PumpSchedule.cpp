@@ -0,0 +1,182 @@
+#include "PumpSchedule.h"
+#include "AT24C32_nvm.h"
+#include "RealTimeClock.h"
+#include "utilities.h"
+
+/**
+ * @brief Constructor for PumpSchedule class.
+ * All the windows start unused, so pumping is allowed until the schedule is loaded.
+ */
+PumpSchedule::PumpSchedule() {
+    for (uint8_t i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+        windows[i] = {0, 0, 0, 0, 0};
+    }
+}
+
+/**
+ * @brief Loads the windows from EEPROM. Invalid windows, e.g. from an uninitialized EEPROM, are cleared.
+ */
+void PumpSchedule::Load() {
+    I2C_EEPROM_ReadBytes(NVM_SCHEDULE_ADDR, (uint8_t*)windows, sizeof(windows));
+
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+        ScheduleWindow &w = windows[i];
+        if ((w.days & ~SCHEDULE_ALL_DAYS) || (w.startHour > 23) || (w.startMinute > 59) ||
+            (w.endHour > 23) || (w.endMinute > 59)) {
+            w = {0, 0, 0, 0, 0};
+        }
+        if (w.days != 0) {
+            used++;
+        }
+    }
+    recomputePending = true;
+    LogSerialn("Schedule loaded from AT24C32, windows in use: " + String(used), true);
+}
+
+/**
+ * @brief Saves the windows to EEPROM.
+ */
+void PumpSchedule::Save() {
+    I2C_EEPROM_WriteBytes(NVM_SCHEDULE_ADDR, (const uint8_t*)windows, sizeof(windows));
+    LogSerialn("Schedule saved to AT24C32", true);
+}
+
+/**
+ * @brief Gets a window of the schedule.
+ * @param index Index of the window, less than SCHEDULE_MAX_WINDOWS.
+ * @return Reference to the window.
+ */
+const ScheduleWindow &PumpSchedule::getWindow(uint8_t index) {
+    return windows[index];
+}
+
+/**
+ * @brief Changes a window of the schedule. The schedule is recomputed on the next isRecomputeDue() check.
+ * @param index Index of the window, less than SCHEDULE_MAX_WINDOWS.
+ * @param window The new window.
+ */
+void PumpSchedule::setWindow(uint8_t index, const ScheduleWindow &window) {
+    windows[index] = window;
+    recomputePending = true;
+}
+
+/**
+ * @brief Requests the cached state and the next transition to be recomputed,
+ * used when the RTC alarm fired or the clock was set.
+ */
+void PumpSchedule::RequestRecompute() {
+    recomputePending = true;
+}
+
+/**
+ * @brief Checks if the schedule must be recomputed: on request, or when the next transition
+ * is overdue because the RTC alarm interrupt was missed.
+ * @param nowMs Current time in milliseconds.
+ * @return True if Recompute() must be called, false otherwise.
+ */
+bool PumpSchedule::isRecomputeDue(uint32_t nowMs) {
+    return recomputePending ||
+           ((nextTransitionMs != 0) && (nowMs - recomputeMs >= nextTransitionMs + SCHEDULE_ALARM_GRACE_MS));
+}
+
+/**
+ * @brief Scans the windows once and caches if the current time is inside any of them.
+ * Times are handled as minutes of the week, Sunday 00:00 being minute 0.
+ * @param now Current date and time read from the RTC.
+ * @param nowMs Current time in milliseconds.
+ * @param nextTransition Set to the time at which a window starts or ends next, with seconds at 0.
+ * @return True if there is a next transition to program in the RTC alarm, false if no window is in use.
+ */
+bool PumpSchedule::Recompute(const DateTime &now, uint32_t nowMs, DateTime &nextTransition) {
+    uint16_t nowMinute = now.dayOfTheWeek() * SCHEDULE_MINUTES_PER_DAY + now.hour() * 60U + now.minute();
+    uint16_t nextDelta = SCHEDULE_MINUTES_PER_WEEK;
+    bool wasInWindow = inWindow;
+
+    enabled = false;
+    inWindow = false;
+    for (uint8_t i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+        const ScheduleWindow &w = windows[i];
+        if (w.days == 0) {
+            continue;
+        }
+        enabled = true;
+        uint16_t startMinute = w.startHour * 60U + w.startMinute;
+        uint16_t endMinute = w.endHour * 60U + w.endMinute;
+        uint16_t duration = (endMinute + SCHEDULE_MINUTES_PER_DAY - startMinute) % SCHEDULE_MINUTES_PER_DAY;
+        if (duration == 0) {
+            duration = SCHEDULE_MINUTES_PER_DAY;
+        }
+
+        for (uint8_t day = 0; day < 7; day++) {
+            if ((w.days & (1 << day)) == 0) {
+                continue;
+            }
+            uint16_t windowStart = day * SCHEDULE_MINUTES_PER_DAY + startMinute;
+            uint16_t sinceStart = (nowMinute + SCHEDULE_MINUTES_PER_WEEK - windowStart) % SCHEDULE_MINUTES_PER_WEEK;
+            if (sinceStart < duration) {
+                inWindow = true;
+                nextDelta = min(nextDelta, (uint16_t)(duration - sinceStart));
+            }
+            nextDelta = min(nextDelta, (uint16_t)(SCHEDULE_MINUTES_PER_WEEK - sinceStart));
+        }
+    }
+
+    recomputePending = false;
+    recomputeMs = nowMs;
+    if (!enabled) {
+        inWindow = true;
+        nextTransitionMs = 0;
+        return false;
+    }
+
+    nextTransition = DateTime(now.year(), now.month(), now.day(), now.hour(), now.minute(), 0) +
+                     TimeSpan((int32_t)nextDelta * 60);
+    nextTransitionMs = nextDelta * 60000UL - now.second() * 1000UL;
+
+    if (inWindow != wasInWindow) {
+        LogSerialn(inWindow ? "Schedule: pumping window open" : "Schedule: pumping window closed", true);
+    }
+    char buf[18];
+    RealTimeClock::FormatDateTime(nextTransition, buf, sizeof(buf));
+    LogSerialn("Schedule: next transition " + String(buf), true);
+    return true;
+}
+
+/**
+ * @brief Checks if the automatic modes may run the pumps. Must be called on every control tick.
+ * Outside of the windows pumping is still allowed once the cistern has been empty for
+ * SCHEDULE_CRITICAL_EMPTY_MS, until it is full again.
+ * @param cisternEmpty True if the cistern sensor reads empty.
+ * @param nowMs Current time in milliseconds.
+ * @return True if pumping is allowed, false otherwise.
+ */
+bool PumpSchedule::isPumpingAllowed(bool cisternEmpty, uint32_t nowMs) {
+    if (!cisternEmpty) {
+        cisternEmptySinceMs = nowMs;
+        if (overrideActive) {
+            overrideActive = false;
+            LogSerialn("Schedule: critical level override ended", true);
+        }
+    } else if (!inWindow && !overrideActive && (nowMs - cisternEmptySinceMs >= SCHEDULE_CRITICAL_EMPTY_MS)) {
+        overrideActive = true;
+        LogSerialn("Schedule: cistern critically low, pumping outside the windows", true);
+    }
+    return inWindow || overrideActive;
+}
+
+/**
+ * @brief Checks if any window is in use.
+ * @return True if the schedule restricts pumping, false if pumping is always allowed.
+ */
+bool PumpSchedule::isEnabled() {
+    return enabled;
+}
+
+/**
+ * @brief Checks if the critical level override is active.
+ * @return True if the pumps may run outside the windows because the cistern is critically low.
+ */
+bool PumpSchedule::isOverrideActive() {
+    return overrideActive;
+}
@@ -0,0 +1,258 @@
+#include "PumpStats.h"
+#include "utilities.h"
+
+#define PUMP_STATS_ONE_FX (1L << PUMP_STATS_FRAC_BITS)
+
+/**
+ * @brief Adds a sample and updates the running mean and variance.
+ * @param sample The new sample value.
+ */
+void RunningStats::AddSample(uint32_t sample) {
+    int32_t sampleFx = (int32_t)(sample << PUMP_STATS_FRAC_BITS);
+    if (count < 0xFFFF) {
+        count++;
+    }
+    int32_t delta = sampleFx - meanFx;
+    meanFx += delta / (int32_t)count;
+    int32_t delta2 = sampleFx - meanFx;
+    int64_t m2Step = (int64_t)delta * delta2;
+    if (m2Step > 0) {
+        m2Fx += (uint64_t)m2Step;
+    }
+}
+
+/**
+ * @brief Checks if a sample is further than sigma standard deviations from the mean.
+ * The standard deviation is floored to one unit so a perfectly steady history does not
+ * flag every small change.
+ * @param sample The sample value to check.
+ * @param sigma Number of standard deviations allowed.
+ * @return True if enough samples are available and the sample is an outlier, false otherwise.
+ */
+bool RunningStats::isOutlier(uint32_t sample, uint8_t sigma) {
+    if (count < PUMP_STATS_ALARM_MIN_N) {
+        return false;
+    }
+    int64_t diffFx = (int64_t)(sample << PUMP_STATS_FRAC_BITS) - meanFx;
+    uint64_t diffSqFx = (uint64_t)(diffFx * diffFx);
+    uint64_t varianceFx = getVarianceFx();
+    if (varianceFx < (uint64_t)PUMP_STATS_ONE_FX * PUMP_STATS_ONE_FX) {
+        varianceFx = (uint64_t)PUMP_STATS_ONE_FX * PUMP_STATS_ONE_FX;
+    }
+    return diffSqFx > (uint64_t)sigma * sigma * varianceFx;
+}
+
+/**
+ * @brief Gets the number of samples added.
+ * @return The samples count (saturates at 65535).
+ */
+uint16_t RunningStats::getCount() {
+    return count;
+}
+
+/**
+ * @brief Gets the mean of the samples, rounded to the nearest unit.
+ * @return The mean value.
+ */
+uint32_t RunningStats::getMean() {
+    return (uint32_t)(meanFx + PUMP_STATS_ONE_FX / 2) >> PUMP_STATS_FRAC_BITS;
+}
+
+/**
+ * @brief Gets the mean of the samples with PUMP_STATS_FRAC_BITS fractional bits.
+ * @return The fixed point mean value.
+ */
+uint32_t RunningStats::getMeanFx() {
+    return (uint32_t)meanFx;
+}
+
+/**
+ * @brief Gets the sample variance with 2 * PUMP_STATS_FRAC_BITS fractional bits.
+ * @return The fixed point variance, 0 with less than two samples.
+ */
+uint64_t RunningStats::getVarianceFx() {
+    if (count < 2) {
+        return 0;
+    }
+    return m2Fx / (count - 1);
+}
+
+/**
+ * @brief Gets the sample standard deviation, rounded down to a whole unit.
+ * @return The standard deviation.
+ */
+uint32_t RunningStats::getStdDev() {
+    return ISqrt64(getVarianceFx()) >> PUMP_STATS_FRAC_BITS;
+}
+
+/**
+ * @brief Starts tracking a fill cycle, called when a pump is started because the cistern is empty.
+ * @param pump Index of the pump filling the cistern (0 = pump 1, 1 = pump 2).
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpStats::CycleStart(uint8_t pump, uint32_t nowMs) {
+    cyclePump = pump;
+    cycleActive = true;
+    cyclePaused = false;
+    cycleBoosted = false;
+    cycleStartMs = nowMs;
+    cyclePausedMs = 0;
+    cyclePauses = 0;
+}
+
+/**
+ * @brief Records the start of a well empty pause of the current fill cycle.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpStats::PauseStart(uint32_t nowMs) {
+    if (!cycleActive || cyclePaused) {
+        return;
+    }
+    cyclePaused = true;
+    pauseStartMs = nowMs;
+    if (cyclePauses < 0xFF) {
+        cyclePauses++;
+    }
+}
+
+/**
+ * @brief Records the end of a well empty pause and adds its duration to the statistics.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpStats::PauseEnd(uint32_t nowMs) {
+    if (!cycleActive || !cyclePaused) {
+        return;
+    }
+    uint32_t pausedMs = nowMs - pauseStartMs;
+    cyclePaused = false;
+    cyclePausedMs += pausedMs;
+    pauseTime[cyclePump].AddSample(pausedMs / 1000);
+    version++;
+}
+
+/**
+ * @brief Finishes the current fill cycle when the cistern is full.
+ * The pumping time of the cycle is checked against the pump history before it is added to it.
+ * Boosted cycles are not comparable with single pump fills, so their fill time is not recorded.
+ * @param nowMs Current time in milliseconds.
+ */
+void PumpStats::CycleEnd(uint32_t nowMs) {
+    if (!cycleActive) {
+        return;
+    }
+    PauseEnd(nowMs);
+    cycleActive = false;
+
+    uint32_t fillSeconds = (nowMs - cycleStartMs - cyclePausedMs) / 1000;
+    if (!cycleBoosted) {
+        if (fillTime[cyclePump].isOutlier(fillSeconds, PUMP_STATS_ALARM_SIGMA)) {
+            alarmFlags |= (1 << cyclePump);
+            LogSerialn("ALARM: Pump " + String(cyclePump + 1) + " fill time " + String(fillSeconds) +
+                       " s out of " + String(PUMP_STATS_ALARM_SIGMA) + " sigma", true);
+        }
+        fillTime[cyclePump].AddSample(fillSeconds);
+    }
+    pauseCount[cyclePump].AddSample(cyclePauses);
+    version++;
+
+    LogPumpStats(cyclePump, fillSeconds);
+}
+
+/**
+ * @brief Drops the current fill cycle without recording it, e.g. when the control mode changes.
+ */
+void PumpStats::CycleAbort() {
+    cycleActive = false;
+    cyclePaused = false;
+}
+
+/**
+ * @brief Marks the current fill cycle as helped by the second pump.
+ */
+void PumpStats::MarkCycleBoosted() {
+    cycleBoosted = true;
+}
+
+/**
+ * @brief Checks if a fill cycle is being tracked.
+ * @return True between CycleStart() and CycleEnd() or CycleAbort(), false otherwise.
+ */
+bool PumpStats::isCycleActive() {
+    return cycleActive;
+}
+
+/**
+ * @brief Checks if the fill time alarm of a pump is active.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @return True if the alarm is active, false otherwise.
+ */
+bool PumpStats::isFillTimeAlarm(uint8_t pump) {
+    return (alarmFlags & (1 << pump)) != 0;
+}
+
+/**
+ * @brief Checks if the fill time alarm of any pump is active.
+ * @return True if any alarm is active, false otherwise.
+ */
+bool PumpStats::isAnyAlarm() {
+    return alarmFlags != 0;
+}
+
+/**
+ * @brief Acknowledges all the fill time alarms.
+ */
+void PumpStats::ClearAlarms() {
+    alarmFlags = 0;
+    version++;
+}
+
+/**
+ * @brief Gets a counter that changes every time the statistics or alarms change.
+ * @return The statistics version.
+ */
+uint8_t PumpStats::getVersion() {
+    return version;
+}
+
+/**
+ * @brief Gets the fill time statistics of a pump, in seconds of pumping per cycle.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @return Reference to the running statistics.
+ */
+RunningStats &PumpStats::getFillTime(uint8_t pump) {
+    return fillTime[pump];
+}
+
+/**
+ * @brief Gets the well empty pauses per cycle statistics of a pump.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @return Reference to the running statistics.
+ */
+RunningStats &PumpStats::getPauseCount(uint8_t pump) {
+    return pauseCount[pump];
+}
+
+/**
+ * @brief Gets the well empty pause duration statistics of a pump, in seconds.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @return Reference to the running statistics.
+ */
+RunningStats &PumpStats::getPauseTime(uint8_t pump) {
+    return pauseTime[pump];
+}
+
+/**
+ * @brief Logs the statistics of a pump to the serial monitor after a fill cycle.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @param fillSeconds Pumping time of the cycle that just finished.
+ */
+void PumpStats::LogPumpStats(uint8_t pump, uint32_t fillSeconds) {
+    LogSerialn("Pump " + String(pump + 1) + " fill: " + String(fillSeconds) + " s" +
+               ", mean " + String(fillTime[pump].getMean()) + " s" +
+               ", sd " + String(fillTime[pump].getStdDev()) + " s" +
+               ", n " + String(fillTime[pump].getCount()), true);
+    LogSerialn("Pump " + String(pump + 1) + " pauses: " + String(cyclePauses) +
+               ", mean " + String(pauseTime[pump].getMean()) + " s" +
+               ", sd " + String(pauseTime[pump].getStdDev()) + " s" +
+               ", n " + String(pauseTime[pump].getCount()), true);
+}
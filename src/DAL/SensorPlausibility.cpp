@@ -0,0 +1,165 @@
+#include "SensorPlausibility.h"
+#include "utilities.h"
+
+/**
+ * @brief Gets the LCD text of a single fault.
+ * @param fault The FAULT_* value.
+ * @return The fault text (up to 16 characters).
+ */
+static const char *FaultText(uint8_t fault) {
+    switch (fault) {
+        case FAULT_CISTERN_FILL_TIMEOUT: return "FLT Fill timeout";
+        case FAULT_CISTERN_UNEXPECTED:   return "FLT Cistern snsr";
+        case FAULT_WELL_STUCK_EMPTY:     return "FLT Well stuck";
+        case FAULT_NO_FLOW:              return "FLT No flow";
+        default:                         return "FLT Unknown";
+    }
+}
+
+/**
+ * @brief Checks the sensor transitions against the pump state and the learned time bounds.
+ * Must be called on every control tick, in every control mode.
+ * @param wellEmpty True if the well sensor reads empty.
+ * @param cisternEmpty True if the cistern sensor reads empty.
+ * @param anyPumpOn True if any pump output is active.
+ * @param noFlow True if the flow meter reports a pump energized without flow.
+ * @param nowMs Current time in milliseconds.
+ */
+void SensorPlausibility::Update(bool wellEmpty, bool cisternEmpty, bool anyPumpOn, bool noFlow, uint32_t nowMs) {
+    if (!initialized) {
+        prevWellEmpty = wellEmpty;
+        prevCisternEmpty = cisternEmpty;
+        lastTickMs = nowMs;
+        lastPumpOnMs = nowMs;
+        wellEmptySinceMs = nowMs;
+        initialized = true;
+        return;
+    }
+
+    uint32_t tickMs = nowMs - lastTickMs;
+    lastTickMs = nowMs;
+    if (anyPumpOn) {
+        lastPumpOnMs = nowMs;
+    }
+
+    /** Cistern: it must get full within the learned pumping time, and only while pumping */
+    if (cisternEmpty) {
+        if (anyPumpOn) {
+            fillPumpingMs += tickMs;
+        }
+        if (fillPumpingMs / 1000 > getFillBoundSeconds()) {
+            LatchFault(FAULT_CISTERN_FILL_TIMEOUT);
+        }
+    } else if (prevCisternEmpty) {
+        if (!anyPumpOn && (nowMs - lastPumpOnMs > PLAUSIBILITY_PUMP_SETTLE_MS)) {
+            LatchFault(FAULT_CISTERN_UNEXPECTED);
+        } else if (fillPumpingMs > 0) {
+            fillHistory.AddSample(fillPumpingMs / 1000);
+        }
+        fillPumpingMs = 0;
+    }
+
+    /** Well: it must recover within the learned recovery time */
+    if (wellEmpty && !prevWellEmpty) {
+        wellEmptySinceMs = nowMs;
+    } else if (!wellEmpty && prevWellEmpty) {
+        wellEmptyHistory.AddSample((nowMs - wellEmptySinceMs) / 1000);
+    }
+    if (wellEmpty && ((nowMs - wellEmptySinceMs) / 1000 > getWellEmptyBoundSeconds())) {
+        LatchFault(FAULT_WELL_STUCK_EMPTY);
+    }
+
+    /** Pump: it must move water while it is energized */
+    if (noFlow) {
+        LatchFault(FAULT_NO_FLOW);
+    }
+
+    prevWellEmpty = wellEmpty;
+    prevCisternEmpty = cisternEmpty;
+}
+
+/**
+ * @brief Checks if any fault is latched.
+ * @return True if a fault is latched, false otherwise.
+ */
+bool SensorPlausibility::hasFault() {
+    return faults != FAULT_NONE;
+}
+
+/**
+ * @brief Gets the latched faults.
+ * @return Bit mask of FAULT_* values.
+ */
+uint8_t SensorPlausibility::getFaults() {
+    return faults;
+}
+
+/**
+ * @brief Gets a short description of the most severe latched fault, to be shown on the LCD.
+ * @return The fault text (up to 16 characters), or nullptr if there is no fault.
+ */
+const char *SensorPlausibility::getFaultText() {
+    for (uint8_t fault = FAULT_CISTERN_FILL_TIMEOUT; fault <= FAULT_NO_FLOW; fault <<= 1) {
+        if (faults & fault) {
+            return FaultText(fault);
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Acknowledges the latched faults. The time bounds start over from now.
+ */
+void SensorPlausibility::ClearFaults() {
+    if (faults != FAULT_NONE) {
+        LogSerialn("Faults cleared", true);
+    }
+    faults = FAULT_NONE;
+    fillPumpingMs = 0;
+    wellEmptySinceMs = lastTickMs;
+}
+
+/**
+ * @brief Gets the longest plausible pumping time to fill the cistern.
+ * @return The bound in seconds.
+ */
+uint32_t SensorPlausibility::getFillBoundSeconds() {
+    return LearnedBound(fillHistory, PLAUSIBILITY_BOOTSTRAP_FILL_S, PLAUSIBILITY_MIN_FILL_S);
+}
+
+/**
+ * @brief Gets the longest plausible time for the well to read empty.
+ * @return The bound in seconds.
+ */
+uint32_t SensorPlausibility::getWellEmptyBoundSeconds() {
+    return LearnedBound(wellEmptyHistory, PLAUSIBILITY_BOOTSTRAP_WELL_S, PLAUSIBILITY_MIN_WELL_S);
+}
+
+/**
+ * @brief Latches a fault and logs it the first time it is detected.
+ * @param fault The FAULT_* value.
+ */
+void SensorPlausibility::LatchFault(uint8_t fault) {
+    if ((faults & fault) == 0) {
+        faults |= fault;
+        LogSerialn(String("FAULT: ") + FaultText(fault), true);
+    }
+}
+
+/**
+ * @brief Computes a time bound from the recorded history: mean plus PLAUSIBILITY_SIGMA standard
+ * deviations, and at least one and a half times the mean.
+ * @param history The recorded durations in seconds.
+ * @param bootstrapS Bound used until PLAUSIBILITY_MIN_SAMPLES durations were recorded.
+ * @param minS Shortest bound allowed.
+ * @return The bound in seconds.
+ */
+uint32_t SensorPlausibility::LearnedBound(RunningStats &history, uint32_t bootstrapS, uint32_t minS) {
+    if (history.getCount() < PLAUSIBILITY_MIN_SAMPLES) {
+        return bootstrapS;
+    }
+    uint32_t mean = history.getMean();
+    uint32_t bound = mean + PLAUSIBILITY_SIGMA * history.getStdDev();
+    bound = max(bound, mean + mean / 2);
+    return max(bound, minS);
+}
@@ -1,14 +1,19 @@
 #include "Sensors.h"
+#include "utilities.h"
+#include "Bench.h"
 
 #define DEBOUNCE_DELAY_MS 100
 
+#define ADC_FULL_SCALE_MV (5000UL)  /* AVcc reference */
+#define ADC_FULL_SCALE    (1024UL)
+
 /**
  * @brief Polls the Sensor state and updates the SensorState variable.
  * Implements a debounce mechanism to avoid false readings due to mechanical bounce.
  */
 void DigitalSensor::PollSensorState() {
-    uint64_t currentTime = millis();
-    static uint64_t lastActiveTime = 0;
+    BENCH_BEGIN(BENCH_SENSOR_POLL);
+    uint32_t currentTime = millis();
     bool isActive = readInputPin();
     if (isActive && (currentTime - lastActiveTime > DEBOUNCE_DELAY_MS)) {
         lastActiveTime = currentTime;
@@ -16,6 +21,7 @@ void DigitalSensor::PollSensorState() {
     } else if (!isActive) {
         SensorState = false;
     }
+    BENCH_END(BENCH_SENSOR_POLL);
 }
 /**
  * @brief Checks if the Sensor is currently active.
@@ -25,3 +31,43 @@ bool DigitalSensor::isSensorActive() {
     return SensorState;
 }
 
+/**
+ * @brief Updates the mean and RMS voltage from the samples collected by the ADC sampler.
+ */
+void AnalogSensor::PollSensorState() {
+    AdcSums sums;
+    AdcSampler_GetSums(channel, sums);
+    if (sums.count == 0) {
+        return;
+    }
+    ready = true;
+    meanMilliVolts = (uint16_t)((uint64_t)sums.sum * ADC_FULL_SCALE_MV / (ADC_FULL_SCALE * sums.count));
+
+    /** count^2 * variance = count * sum of squares - sum^2, in ADC units squared */
+    uint64_t scaledVariance = (uint64_t)sums.count * sums.sumSq - (uint64_t)sums.sum * sums.sum;
+    rmsMilliVolts = (uint16_t)((uint64_t)ISqrt64(scaledVariance) * ADC_FULL_SCALE_MV / (ADC_FULL_SCALE * sums.count));
+}
+
+/**
+ * @brief Checks if the sensor has readings.
+ * @return True once the first block of samples was collected, false otherwise.
+ */
+bool AnalogSensor::isReady() {
+    return ready;
+}
+
+/**
+ * @brief Gets the mean voltage over the last ADC_SAMPLER_RING_SIZE blocks.
+ * @return The voltage in millivolts.
+ */
+uint16_t AnalogSensor::getMilliVolts() {
+    return meanMilliVolts;
+}
+
+/**
+ * @brief Gets the RMS of the voltage around its mean over the last ADC_SAMPLER_RING_SIZE blocks.
+ * @return The RMS voltage in millivolts.
+ */
+uint16_t AnalogSensor::getRmsMilliVolts() {
+    return rmsMilliVolts;
+}
@@ -0,0 +1,102 @@
+#include "UiRender.h"
+
+/**
+ * @brief Constructor for UiRender class.
+ * All values start as changed so the first frame draws the whole screen.
+ */
+UiRender::UiRender() {
+    memset(values, 0, sizeof(values));
+    memset(versions, 1, sizeof(versions));
+    memset(drawnVersions, 0, sizeof(drawnVersions));
+}
+
+/**
+ * @brief Marks a model value as changed.
+ * @param dep The model value that changed.
+ */
+void UiRender::Invalidate(UiDependency_t dep) {
+    versions[dep]++;
+}
+
+/**
+ * @brief Stores the latest model value and marks it as changed only if it differs from the previous one.
+ * @param dep The model value to update.
+ * @param value The current value.
+ */
+void UiRender::UpdateValue(UiDependency_t dep, uint8_t value) {
+    if (values[dep] != value) {
+        values[dep] = value;
+        versions[dep]++;
+    }
+}
+
+/**
+ * @brief Marks every model value as changed, used when the screen is changed or cleared.
+ */
+void UiRender::InvalidateAll() {
+    for (uint8_t i = 0; i < UI_DEP_COUNT; i++) {
+        versions[i]++;
+    }
+}
+
+/**
+ * @brief Opens a new frame if the throttle interval has elapsed since the previous one.
+ * @param nowMs Current time in milliseconds.
+ * @return True if a frame was opened and the screens may draw, false otherwise.
+ */
+bool UiRender::BeginFrame(uint32_t nowMs) {
+    if (nowMs - lastFrameMs < UI_RENDER_MIN_INTERVAL_MS) {
+        return false;
+    }
+    lastFrameMs = nowMs;
+    frameOpen = true;
+    return true;
+}
+
+/**
+ * @brief Closes the current frame. Screens may not draw until the next frame is opened.
+ */
+void UiRender::EndFrame() {
+    frameOpen = false;
+}
+
+/**
+ * @brief Checks if a frame is currently open.
+ * @return True inside a frame, false otherwise.
+ */
+bool UiRender::isFrameOpen() {
+    return frameOpen;
+}
+
+/**
+ * @brief Checks if any of the given model values changed since it was last drawn.
+ * @param depMask Bit mask of UI_DEP_BIT() values the caller draws.
+ * @return True if a frame is open and one of the values changed, false otherwise.
+ */
+bool UiRender::NeedsRedraw(uint8_t depMask) {
+    if (!frameOpen) {
+        return false;
+    }
+    for (uint8_t i = 0; i < UI_DEP_COUNT; i++) {
+        if ((depMask & UI_DEP_BIT(i)) && (versions[i] != drawnVersions[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Records that the given model values have been drawn with their current version.
+ * Outside a frame nothing can have been drawn, so the call is ignored and the values stay pending.
+ * @param depMask Bit mask of UI_DEP_BIT() values that were drawn.
+ */
+void UiRender::MarkDrawn(uint8_t depMask) {
+    if (!frameOpen) {
+        return;
+    }
+    for (uint8_t i = 0; i < UI_DEP_COUNT; i++) {
+        if (depMask & UI_DEP_BIT(i)) {
+            drawnVersions[i] = versions[i];
+        }
+    }
+}
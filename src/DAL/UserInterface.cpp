@@ -1,37 +1,85 @@
 #include "UserInterface.h"
 
+/**
+ * @brief Gets the model values a screen depends on.
+ * The screen is only redrawn when one of these values changed since it was last drawn.
+ * @param screen The screen mode.
+ * @return Bit mask of UI_DEP_BIT() values.
+ */
+uint8_t ScreenDependencies(ScreenMode_t screen)
+{
+    switch (screen) {
+        case SCREEN_MAIN:
+            return UI_DEP_BIT(UI_DEP_MODE) | UI_DEP_BIT(UI_DEP_TIME) | UI_DEP_BIT(UI_DEP_ALARMS);
+        case SCREEN_MAIN_CFGS:
+        case SCREEN_CFG_CTRL_TYPE:
+            return UI_DEP_BIT(UI_DEP_CURSOR);
+        case SCREEN_CFG_RTC:
+        case SCREEN_CFG_PUMP1_CYCLE:
+        case SCREEN_CFG_PUMP2_CYCLE:
+        case SCREEN_PUMP_STATS:
+        case SCREEN_CFG_SCHEDULE:
+            return UI_DEP_BIT(UI_DEP_CURSOR) | UI_DEP_BIT(UI_DEP_FIELDS);
+        default:
+            return 0;
+    }
+}
+
 /**
  * @brief Displays the main screen with control mode and current time.
- * @param pbOkState State of the OK push button (not used here, but kept for interface compatibility).
+ * @param pbOkState State of the OK push button.
  * @param mode The current control mode to display.
  * @param lcdDisplay Reference to the LCD display object.
- * @param Hour String with the current hour in "DD/MM HH:MM:SS" 24-hour format.
- * @return SCREEN_MAIN (remains on main screen).
+ * @param uiRender Reference to the render state, rows are only reprinted when their data changed.
+ * @param now Current date and time, shown in "DD/MM HH:MM:SS" 24-hour format.
+ * @param alarmFlags Active alarms and faults, any non zero value shows the alarm mark '!' at the end of the first row.
+ * @param faultText Latched fault shown instead of the time, nullptr if there is no fault.
+ * @return The next screen mode based on user input.
  */
-ScreenMode_t DisplayMain(bool pbOkState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay, String Hour)
+ScreenMode_t DisplayMain(bool pbOkState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay, UiRender &uiRender, const DateTime &now, uint8_t alarmFlags, const char *faultText)
 {
     ScreenMode_t retval = SCREEN_MAIN;
 
-    /** Display control mode */
-    String ctrlModeStr;
-    switch(mode) {
-        case CTRL_MODE_MANUAL:
-            ctrlModeStr = "Manual ";
-            break;
-        case CTRL_AUTO_BY_SENSORS:
-            ctrlModeStr = "Sensors";
-            break;
-        case CTRL_AUTO_BY_TIMER:
-            ctrlModeStr = "Timers ";
-            break;
-        default:
-            ctrlModeStr = "UNKNOWN";
-            break;
+    /** Display control mode and alarm mark */
+    uiRender.UpdateValue(UI_DEP_MODE, (uint8_t)mode);
+    uiRender.UpdateValue(UI_DEP_ALARMS, alarmFlags);
+    /** Both rows show the alarms, so their redraw needs are read before either is marked drawn */
+    bool redrawModeRow = uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_MODE) | UI_DEP_BIT(UI_DEP_ALARMS));
+    bool redrawTimeRow = uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_TIME) | UI_DEP_BIT(UI_DEP_ALARMS));
+    if (redrawModeRow) {
+        const char* ctrlModeStr;
+        switch(mode) {
+            case CTRL_MODE_MANUAL:
+                ctrlModeStr = "Ctrl: Manual ";
+                break;
+            case CTRL_AUTO_BY_SENSORS:
+                ctrlModeStr = "Ctrl: Sensors";
+                break;
+            case CTRL_AUTO_BY_TIMER:
+                ctrlModeStr = "Ctrl: Timers ";
+                break;
+            default:
+                ctrlModeStr = "Ctrl: UNKNOWN";
+                break;
+        }
+        char line[LCD_DISPLAY_COLS + 1];
+        snprintf(line, sizeof(line), "%-15s%c", ctrlModeStr, (alarmFlags != 0) ? '!' : ' ');
+        lcdDisplay.writeRow(0, line);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_MODE));
     }
-    lcdDisplay.PrintMessage("Ctrl: " + ctrlModeStr, 0, 0);
 
-    /** Display the hour in 24-hour format */
-    lcdDisplay.PrintMessage(Hour, 0, 1);
+    /** Display the latched fault, or the hour in 24-hour format. The fault text only changes with the alarms */
+    if (faultText != nullptr) {
+        if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_ALARMS))) {
+            lcdDisplay.writeRow(1, faultText);
+            uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_TIME) | UI_DEP_BIT(UI_DEP_ALARMS));
+        }
+    } else if (redrawTimeRow) {
+        char timeStr[18];
+        RealTimeClock::FormatDateTime(now, timeStr, sizeof(timeStr));
+        lcdDisplay.writeRow(1, timeStr);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_TIME) | UI_DEP_BIT(UI_DEP_ALARMS));
+    }
 
     if( pbOkState) {
         /** If OK button is pressed, switch to option settings screen */
@@ -51,16 +99,19 @@ ScreenMode_t DisplayMain(bool pbOkState, CtrlModeSel_t &mode, LCD_Display &lcdDi
  * @param pbUpState State of the UP push button.
  * @param pbDownState State of the DOWN push button.
  * @param lcdDisplay Reference to the LCD display object.
+ * @param uiRender Reference to the render state, the menu is only reprinted when the selection changed.
  * @return The next screen mode based on user input.
  */
-ScreenMode_t DisplayMainCfgs(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, LCD_Display &lcdDisplay)
+ScreenMode_t DisplayMainCfgs(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, LCD_Display &lcdDisplay, UiRender &uiRender)
 {
     /** Menu options */
     const char* menuOptions[] = {
         "Cfg Ctrl Type",
         "Cfg Hour",
         "Cfg Pump1 Time",
-        "Cfg Pump2 Time"
+        "Cfg Pump2 Time",
+        "Pump Stats",
+        "Cfg Schedule"
     };
     const uint8_t numOptions = sizeof(menuOptions) / sizeof(menuOptions[0]);
     static uint8_t selectedIndex = 0;
@@ -84,14 +135,16 @@ ScreenMode_t DisplayMainCfgs(bool pbOkState, bool pbEscState, bool pbUpState, bo
     }
 
     /** Display two menu options with selector '>' */
-    for (uint8_t i = 0; i < 2; i++) {
-        uint8_t optionIdx = topIndex + i;
-        if (optionIdx >= numOptions) break;
-        if (optionIdx == selectedIndex) {
-            lcdDisplay.PrintMessage(">" + String(menuOptions[optionIdx]), 0, i);
-        } else {
-            lcdDisplay.PrintMessage(" " + String(menuOptions[optionIdx]), 0, i);
+    uiRender.UpdateValue(UI_DEP_CURSOR, (uint8_t)((topIndex << 4) | selectedIndex));
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_CURSOR))) {
+        for (uint8_t i = 0; i < 2; i++) {
+            uint8_t optionIdx = topIndex + i;
+            if (optionIdx >= numOptions) break;
+            char line[LCD_DISPLAY_COLS + 1];
+            snprintf(line, sizeof(line), "%c%s", (optionIdx == selectedIndex) ? '>' : ' ', menuOptions[optionIdx]);
+            lcdDisplay.writeRow(i, line);
         }
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_CURSOR));
     }
 
     /** Handle selection */
@@ -109,6 +162,12 @@ ScreenMode_t DisplayMainCfgs(bool pbOkState, bool pbEscState, bool pbUpState, bo
             case 3:
                 retval = SCREEN_CFG_PUMP2_CYCLE;
                 break;
+            case 4:
+                retval = SCREEN_PUMP_STATS;
+                break;
+            case 5:
+                retval = SCREEN_CFG_SCHEDULE;
+                break;
             default:
                 retval = SCREEN_MAIN_CFGS;
                 break;
@@ -133,9 +192,10 @@ ScreenMode_t DisplayMainCfgs(bool pbOkState, bool pbEscState, bool pbUpState, bo
  * @param pbUpState State of the UP push button.
  * @param pbDownState State of the DOWN push button.
  * @param lcdDisplay Reference to the LCD display object.
+ * @param uiRender Reference to the render state, the menu is only reprinted when the selection changed.
  * @return The next screen mode based on user input.
  */
-ScreenMode_t DisplayCfgControlTypes(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay) 
+ScreenMode_t DisplayCfgControlTypes(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, CtrlModeSel_t &mode, LCD_Display &lcdDisplay, UiRender &uiRender) 
 {
     /** Static variable to keep track of the selected menu index: 0 = Set Control, 1 = Set Hour */
     static uint8_t selectedIndex = 0;
@@ -150,12 +210,16 @@ ScreenMode_t DisplayCfgControlTypes(bool pbOkState, bool pbEscState, bool pbUpSt
     }
 
     /** Display menu options with selector '>' */
-    if (selectedIndex == 0) {
-        lcdDisplay.PrintMessage(">Auto Sensors", 0, 0);
-        lcdDisplay.PrintMessage(" Auto Timer", 0, 1);
-    } else {
-        lcdDisplay.PrintMessage(" Auto Sensors", 0, 0);
-        lcdDisplay.PrintMessage(">Auto Timer", 0, 1);
+    uiRender.UpdateValue(UI_DEP_CURSOR, selectedIndex);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_CURSOR))) {
+        if (selectedIndex == 0) {
+            lcdDisplay.writeRow(0, ">Auto Sensors");
+            lcdDisplay.writeRow(1, " Auto Timer");
+        } else {
+            lcdDisplay.writeRow(0, " Auto Sensors");
+            lcdDisplay.writeRow(1, ">Auto Timer");
+        }
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_CURSOR));
     }
 
     /** Handle selection */
@@ -186,10 +250,11 @@ ScreenMode_t DisplayCfgControlTypes(bool pbOkState, bool pbEscState, bool pbUpSt
  * @param pbLeftState State of the LEFT push button.
  * @param pbRightState State of the RIGHT push button.
  * @param lcdDisplay Reference to the LCD display object.
+ * @param uiRender Reference to the render state, each row is only reprinted when its data changed.
  * @param rtc_datetime Reference to the RealTimeClock object.
  * @return The next screen mode based on user input.
  */
-ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, bool pbLeftState, bool pbRightState, LCD_Display &lcdDisplay, RealTimeClock &rtc_datetime) {
+ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState, bool pbLeftState, bool pbRightState, LCD_Display &lcdDisplay, UiRender &uiRender, RealTimeClock &rtc_datetime) {
     /** Static variables to hold editable date/time and cursor position */
     static uint8_t day = 1, month = 1, year = 24, hour = 0, minute = 0, second = 0;
     static uint8_t cursorIndex = 0; /* 0=day, 1=month, 2=year, 3=hour, 4=minute, 5=second */
@@ -207,6 +272,7 @@ ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool
         second = now.second();
         cursorIndex = 0;
         initialized = true;
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
 
     /** Handle navigation between fields */
@@ -227,6 +293,7 @@ ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool
             case 4: if (minute < 59) minute++; else minute = 0; break;
             case 5: if (second < 59) second++; else second = 0; break;
         }
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
     if (pbDownState) {
         switch (cursorIndex) {
@@ -237,26 +304,36 @@ ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool
             case 4: if (minute > 0) minute--; else minute = 59; break;
             case 5: if (second > 0) second--; else second = 59; break;
         }
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
 
     /** Format date string: DD/MM/YY-HH:MM:SS */
-    char dateStr[17];
-    snprintf(dateStr, sizeof(dateStr), "%02u/%02u/%02u-%02u:%02u:%02u", day, month, year, hour, minute, second);
-    lcdDisplay.PrintMessage(String(dateStr), 0, 0);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_FIELDS))) {
+        /** 17 characters, writeRow() shows the first 16 */
+        char dateStr[18];
+        snprintf(dateStr, sizeof(dateStr), "%02u/%02u/%02u-%02u:%02u:%02u", day % 100, month % 100, year % 100,
+                 hour % 100, minute % 100, second % 100);
+        lcdDisplay.writeRow(0, dateStr);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_FIELDS));
+    }
 
     /** Draw up arrow '^' under the selected field */
-    char arrowLine[17] = "                ";
-    uint8_t arrowPos = 0;
-    switch (cursorIndex) {
-        case 0: arrowPos = 0; break;  /* Day */
-        case 1: arrowPos = 3; break;  /* Month */
-        case 2: arrowPos = 6; break;  /* Year */
-        case 3: arrowPos = 9; break;  /* Hour */
-        case 4: arrowPos = 12; break; /* Minute */
-        case 5: arrowPos = 15; break; /* Second */
-    }
-    arrowLine[arrowPos] = '^';
-    lcdDisplay.PrintMessage(String(arrowLine), 0, 1);
+    uiRender.UpdateValue(UI_DEP_CURSOR, cursorIndex);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_CURSOR))) {
+        char arrowLine[17] = "                ";
+        uint8_t arrowPos = 0;
+        switch (cursorIndex) {
+            case 0: arrowPos = 0; break;  /* Day */
+            case 1: arrowPos = 3; break;  /* Month */
+            case 2: arrowPos = 6; break;  /* Year */
+            case 3: arrowPos = 9; break;  /* Hour */
+            case 4: arrowPos = 12; break; /* Minute */
+            case 5: arrowPos = 15; break; /* Second */
+        }
+        arrowLine[arrowPos] = '^';
+        lcdDisplay.writeRow(1, arrowLine);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_CURSOR));
+    }
 
     /** Handle OK and ESC */
     if (pbOkState) {
@@ -285,12 +362,13 @@ ScreenMode_t DisplayCfgRtc(bool pbOkState, bool pbEscState, bool pbUpState, bool
  * @param pbRightState State of the RIGHT push button.
  * @param pump1cycle The current cycle time for pump 1.
  * @param lcdDisplay Reference to the LCD display object.
+ * @param uiRender Reference to the render state, each row is only reprinted when its data changed.
  * @return The next screen mode based on user input.
  */
 ScreenMode_t DisplayCfgPump1Cycle(
     bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
     bool pbLeftState, bool pbRightState,
-    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay)
+    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay, UiRender &uiRender)
 {
     static uint8_t hour = 0, minute = 0, second = 0;
     static uint8_t cursorIndex = 0;
@@ -303,6 +381,7 @@ ScreenMode_t DisplayCfgPump1Cycle(
         second = PumpCyclesTimes[0].second;
         cursorIndex = 0;
         initialized = true;
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
 
     if (pbLeftState && cursorIndex > 0) cursorIndex--;
@@ -314,6 +393,7 @@ ScreenMode_t DisplayCfgPump1Cycle(
             case 1: if (minute < 59) minute++; else minute = 0; break;
             case 2: if (second < 59) second++; else second = 0; break;
         }
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
     if (pbDownState) {
         switch (cursorIndex) {
@@ -321,16 +401,24 @@ ScreenMode_t DisplayCfgPump1Cycle(
             case 1: if (minute > 0) minute--; else minute = 59; break;
             case 2: if (second > 0) second--; else second = 59; break;
         }
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
 
     char cycleStr[9];
-    snprintf(cycleStr, sizeof(cycleStr), "%02u:%02u:%02u", hour, minute, second);
-    lcdDisplay.PrintMessage(String(cycleStr), 0, 0);
+    snprintf(cycleStr, sizeof(cycleStr), "%02u:%02u:%02u", hour % 100, minute % 100, second % 100);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_FIELDS))) {
+        lcdDisplay.writeRow(0, cycleStr);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_FIELDS));
+    }
 
-    char arrowLine[9] = "       ";
-    uint8_t arrowPos = cursorIndex * 3;
-    arrowLine[arrowPos] = '^';
-    lcdDisplay.PrintMessage(String(arrowLine), 0, 1);
+    uiRender.UpdateValue(UI_DEP_CURSOR, cursorIndex);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_CURSOR))) {
+        char arrowLine[9] = "       ";
+        uint8_t arrowPos = cursorIndex * 3;
+        arrowLine[arrowPos] = '^';
+        lcdDisplay.writeRow(1, arrowLine);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_CURSOR));
+    }
 
     if (pbOkState) {
         PumpCyclesTimes[0].hour = hour;
@@ -357,12 +445,13 @@ ScreenMode_t DisplayCfgPump1Cycle(
  * @param pbRightState State of the RIGHT push button.
  * @param pump2cycle The current cycle time for pump 2.
  * @param lcdDisplay Reference to the LCD display object.
+ * @param uiRender Reference to the render state, each row is only reprinted when its data changed.
  * @return The next screen mode based on user input.
  */
 ScreenMode_t DisplayCfgPump2Cycle(
     bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
     bool pbLeftState, bool pbRightState,
-    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay)
+    PumpCycleTime (&PumpCyclesTimes)[2], LCD_Display &lcdDisplay, UiRender &uiRender)
 {
     static uint8_t hour = 0, minute = 0, second = 0;
     static uint8_t cursorIndex = 0;
@@ -375,6 +464,7 @@ ScreenMode_t DisplayCfgPump2Cycle(
         second = PumpCyclesTimes[1].second;
         cursorIndex = 0;
         initialized = true;
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
 
     if (pbLeftState && cursorIndex > 0) cursorIndex--;
@@ -386,6 +476,7 @@ ScreenMode_t DisplayCfgPump2Cycle(
             case 1: if (minute < 59) minute++; else minute = 0; break;
             case 2: if (second < 59) second++; else second = 0; break;
         }
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
     if (pbDownState) {
         switch (cursorIndex) {
@@ -393,16 +484,24 @@ ScreenMode_t DisplayCfgPump2Cycle(
             case 1: if (minute > 0) minute--; else minute = 59; break;
             case 2: if (second > 0) second--; else second = 59; break;
         }
+        uiRender.Invalidate(UI_DEP_FIELDS);
     }
 
     char cycleStr[9];
-    snprintf(cycleStr, sizeof(cycleStr), "%02u:%02u:%02u", hour, minute, second);
-    lcdDisplay.PrintMessage(String(cycleStr), 0, 0);
+    snprintf(cycleStr, sizeof(cycleStr), "%02u:%02u:%02u", hour % 100, minute % 100, second % 100);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_FIELDS))) {
+        lcdDisplay.writeRow(0, cycleStr);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_FIELDS));
+    }
 
-    char arrowLine[9] = "       ";
-    uint8_t arrowPos = cursorIndex * 3;
-    arrowLine[arrowPos] = '^';
-    lcdDisplay.PrintMessage(String(arrowLine), 0, 1);
+    uiRender.UpdateValue(UI_DEP_CURSOR, cursorIndex);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_CURSOR))) {
+        char arrowLine[9] = "       ";
+        uint8_t arrowPos = cursorIndex * 3;
+        arrowLine[arrowPos] = '^';
+        lcdDisplay.writeRow(1, arrowLine);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_CURSOR));
+    }
 
     if (pbOkState) {
         PumpCyclesTimes[1].hour = hour;
@@ -417,4 +516,203 @@ ScreenMode_t DisplayCfgPump2Cycle(
     }
 
     return retval;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Displays the fill cycle statistics of a pump.
+ * LEFT/RIGHT select the pump, UP/DOWN switch between the fill time, the well pauses, the flow meter,
+ * the analog sensors and the board power page, OK acknowledges the fill time alarms.
+ * @param pbOkState State of the OK push button.
+ * @param pbEscState State of the ESC push button.
+ * @param pbUpState State of the UP push button.
+ * @param pbDownState State of the DOWN push button.
+ * @param pbLeftState State of the LEFT push button.
+ * @param pbRightState State of the RIGHT push button.
+ * @param pumpStats Reference to the pump statistics.
+ * @param flowMeter Reference to the flow meter, for the liters pumped and the flow rate.
+ * @param pumpCurrentMa Current drawn by the pumps in mA.
+ * @param cisternLevelPct Cistern level in percent.
+ * @param awakePermille Share of time the CPU was awake, in per mille.
+ * @param boardCurrentX10Ma Average supply current of the board, in tenths of mA.
+ * @param lcdDisplay Reference to the LCD display object.
+ * @param uiRender Reference to the render state, the screen is only reprinted when the statistics or selection changed.
+ * @return The next screen mode based on user input.
+ */
+ScreenMode_t DisplayPumpStats(
+    bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
+    bool pbLeftState, bool pbRightState,
+    PumpStats &pumpStats, FlowMeter &flowMeter, uint16_t pumpCurrentMa, uint8_t cisternLevelPct,
+    uint16_t awakePermille, uint16_t boardCurrentX10Ma, LCD_Display &lcdDisplay, UiRender &uiRender)
+{
+    const uint8_t numPages = 5;
+    static uint8_t pump = 0;  /* 0 = pump 1, 1 = pump 2 */
+    static uint8_t page = 0;  /* 0 = fill time, 1 = well pauses, 2 = flow meter, 3 = analog sensors, 4 = board power */
+    ScreenMode_t retval = SCREEN_PUMP_STATS;
+
+    if (pbLeftState || pbRightState) pump ^= 1;
+    if (pbUpState) page = (page + 1) % numPages;
+    if (pbDownState) page = (page + numPages - 1) % numPages;
+    if (pbOkState) pumpStats.ClearAlarms();
+
+    uiRender.UpdateValue(UI_DEP_CURSOR, (uint8_t)((page << 1) | pump));
+    uiRender.UpdateValue(UI_DEP_FIELDS, (page == 2) ? flowMeter.getVersion() : pumpStats.getVersion());
+    if (page >= 3) {
+        /** The analog readings change all the time, only the characters that differ are sent to the LCD */
+        uiRender.Invalidate(UI_DEP_FIELDS);
+    }
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_CURSOR) | UI_DEP_BIT(UI_DEP_FIELDS))) {
+        char line[LCD_DISPLAY_COLS + 1];
+        if (page == 0) {
+            RunningStats &fill = pumpStats.getFillTime(pump);
+            snprintf(line, sizeof(line), "P%u Fill n:%-5u%c", (pump & 1) + 1, fill.getCount(), pumpStats.isFillTimeAlarm(pump) ? '!' : ' ');
+            lcdDisplay.writeRow(0, line);
+            /** Times above 9999 s are shown as 9999 so that the row fits */
+            snprintf(line, sizeof(line), "m:%lus sd:%lus", min((unsigned long)fill.getMean(), 9999UL),
+                     min((unsigned long)fill.getStdDev(), 9999UL));
+            lcdDisplay.writeRow(1, line);
+        } else if (page == 2) {
+            /** Capped at 999.9 L/min and 99999999 L so that the rows fit */
+            uint32_t rateDl = min(flowMeter.getRateMlPerMin() / 100, 9999UL);
+            snprintf(line, sizeof(line), "P%u Vol:%luL", (pump & 1) + 1, min((unsigned long)flowMeter.getLiters(pump), 99999999UL));
+            lcdDisplay.writeRow(0, line);
+            snprintf(line, sizeof(line), "Flow:%lu.%lu L/min", (unsigned long)(rateDl / 10), (unsigned long)(rateDl % 10));
+            lcdDisplay.writeRow(1, line);
+        } else if (page == 3) {
+            snprintf(line, sizeof(line), "Pumps I:%u.%02uA", pumpCurrentMa / 1000, (pumpCurrentMa % 1000) / 10);
+            lcdDisplay.writeRow(0, line);
+            snprintf(line, sizeof(line), "Level:%u%%", cisternLevelPct);
+            lcdDisplay.writeRow(1, line);
+        } else if (page == 4) {
+            snprintf(line, sizeof(line), "Awake:%u.%u%%", awakePermille / 10, awakePermille % 10);
+            lcdDisplay.writeRow(0, line);
+            snprintf(line, sizeof(line), "Board:%u.%umA", boardCurrentX10Ma / 10, boardCurrentX10Ma % 10);
+            lcdDisplay.writeRow(1, line);
+        } else {
+            RunningStats &pauses = pumpStats.getPauseCount(pump);
+            RunningStats &pauseTime = pumpStats.getPauseTime(pump);
+            uint32_t pausesX10 = min((pauses.getMeanFx() * 10UL) >> PUMP_STATS_FRAC_BITS, 999UL);
+            snprintf(line, sizeof(line), "P%u Pause/c %lu.%lu", (pump & 1) + 1, (unsigned long)(pausesX10 / 10), (unsigned long)(pausesX10 % 10));
+            lcdDisplay.writeRow(0, line);
+            snprintf(line, sizeof(line), "m:%lus sd:%lus", min((unsigned long)pauseTime.getMean(), 9999UL),
+                     min((unsigned long)pauseTime.getStdDev(), 9999UL));
+            lcdDisplay.writeRow(1, line);
+        }
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_CURSOR) | UI_DEP_BIT(UI_DEP_FIELDS));
+    }
+
+    if (pbEscState) {
+        pump = 0;
+        page = 0;
+        retval = SCREEN_MAIN_CFGS;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Displays the pumping schedule setting screen.
+ * The first row shows the start and end time of the selected window, or its days when the cursor is on
+ * them. LEFT/RIGHT move the cursor, UP/DOWN change the window number, the times or toggle a day.
+ * A window without days is not used. OK saves all the windows, ESC discards the changes.
+ * @param pbOkState State of the OK push button.
+ * @param pbEscState State of the ESC push button.
+ * @param pbUpState State of the UP push button.
+ * @param pbDownState State of the DOWN push button.
+ * @param pbLeftState State of the LEFT push button.
+ * @param pbRightState State of the RIGHT push button.
+ * @param pumpSchedule Reference to the pumping schedule.
+ * @param lcdDisplay Reference to the LCD display object.
+ * @param uiRender Reference to the render state, each row is only reprinted when its data changed.
+ * @return The next screen mode based on user input.
+ */
+ScreenMode_t DisplayCfgSchedule(
+    bool pbOkState, bool pbEscState, bool pbUpState, bool pbDownState,
+    bool pbLeftState, bool pbRightState,
+    PumpSchedule &pumpSchedule, LCD_Display &lcdDisplay, UiRender &uiRender)
+{
+    /** Cursor fields: window, start hour, start minute, end hour, end minute, then the days Sunday to Saturday */
+    const uint8_t firstDayField = 5;
+    const uint8_t numFields = firstDayField + 7;
+    const uint8_t fieldCols[numFields] = {1, 3, 6, 9, 12, 8, 9, 10, 11, 12, 13, 14};
+    const char dayLetters[] = "SMTWTFS";
+    static ScheduleWindow windows[SCHEDULE_MAX_WINDOWS];
+    static uint8_t windowIndex = 0;
+    static uint8_t cursorIndex = 0;
+    static bool initialized = false;
+    ScreenMode_t retval = SCREEN_CFG_SCHEDULE;
+
+    if (!initialized) {
+        for (uint8_t i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+            windows[i] = pumpSchedule.getWindow(i);
+        }
+        windowIndex = 0;
+        cursorIndex = 0;
+        initialized = true;
+        uiRender.Invalidate(UI_DEP_FIELDS);
+    }
+
+    /** The first row switches between the times and the days of the window */
+    if (pbLeftState && cursorIndex > 0) {
+        cursorIndex--;
+        uiRender.Invalidate(UI_DEP_FIELDS);
+    }
+    if (pbRightState && cursorIndex < numFields - 1) {
+        cursorIndex++;
+        uiRender.Invalidate(UI_DEP_FIELDS);
+    }
+
+    if (pbUpState || pbDownState) {
+        ScheduleWindow &w = windows[windowIndex];
+        int8_t step = pbUpState ? 1 : -1;
+        switch (cursorIndex) {
+            case 0: windowIndex = (windowIndex + SCHEDULE_MAX_WINDOWS + step) % SCHEDULE_MAX_WINDOWS; break;
+            case 1: w.startHour = (w.startHour + 24 + step) % 24; break;
+            case 2: w.startMinute = (w.startMinute + 60 + step) % 60; break;
+            case 3: w.endHour = (w.endHour + 24 + step) % 24; break;
+            case 4: w.endMinute = (w.endMinute + 60 + step) % 60; break;
+            default: w.days ^= (1 << (cursorIndex - firstDayField)); break;
+        }
+        uiRender.Invalidate(UI_DEP_FIELDS);
+    }
+
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_FIELDS))) {
+        const ScheduleWindow &w = windows[windowIndex];
+        char line[LCD_DISPLAY_COLS + 1];
+        if (cursorIndex < firstDayField) {
+            /** The fields are kept in range by the edit keys, the modulos let the compiler see that the row fits */
+            snprintf(line, sizeof(line), "W%u %02u:%02u-%02u:%02u", windowIndex % SCHEDULE_MAX_WINDOWS + 1,
+                     w.startHour % 24, w.startMinute % 60, w.endHour % 24, w.endMinute % 60);
+        } else {
+            snprintf(line, sizeof(line), "W%u Days ", windowIndex % SCHEDULE_MAX_WINDOWS + 1);
+            for (uint8_t day = 0; day < 7; day++) {
+                line[8 + day] = (w.days & (1 << day)) ? dayLetters[day] : '-';
+            }
+            line[15] = '\0';
+        }
+        lcdDisplay.writeRow(0, line);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_FIELDS));
+    }
+
+    /** Draw up arrow '^' under the selected field */
+    uiRender.UpdateValue(UI_DEP_CURSOR, cursorIndex);
+    if (uiRender.NeedsRedraw(UI_DEP_BIT(UI_DEP_CURSOR))) {
+        char arrowLine[LCD_DISPLAY_COLS + 1] = "               ";
+        arrowLine[fieldCols[cursorIndex]] = '^';
+        lcdDisplay.writeRow(1, arrowLine);
+        uiRender.MarkDrawn(UI_DEP_BIT(UI_DEP_CURSOR));
+    }
+
+    if (pbOkState) {
+        for (uint8_t i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+            pumpSchedule.setWindow(i, windows[i]);
+        }
+        initialized = false;
+        LogSerialn("Schedule set", true);
+        retval = SCREEN_MAIN_CFGS;
+    } else if (pbEscState) {
+        initialized = false;
+        retval = SCREEN_MAIN_CFGS;
+    }
+
+    return retval;
+}
@@ -0,0 +1,189 @@
+#include "WellRecovery.h"
+#include "utilities.h"
+
+/**
+ * @brief Constructor for WellRecovery class.
+ * The pumps start as stopped long enough ago to be started right away.
+ */
+WellRecovery::WellRecovery() {
+    for (uint8_t i = 0; i < WELL_RECOVERY_NUM_PUMPS; i++) {
+        pumps[i].startMs = 0;
+        pumps[i].stopMs = (uint32_t)(0 - WELL_MIN_OFF_TIME_MS);
+        pumps[i].running = false;
+        pumps[i].pausedByWell = false;
+    }
+}
+
+/**
+ * @brief Tracks the well level transitions. Must be called once per control tick, before RequestPump().
+ * @param isWellEmpty True if the well sensor reads empty.
+ * @param nowMs Current time in milliseconds.
+ */
+void WellRecovery::UpdateWell(bool isWellEmpty, uint32_t nowMs) {
+    if (!isWellEmpty && wellEmpty) {
+        wellFullSinceMs = nowMs;
+        /** Learn how long the well takes to recover after it ran dry under a pump */
+        if (recoveryPending) {
+            int32_t recoveryMs = (int32_t)(nowMs - lastDryMs);
+            recoveryEmaMs += (recoveryMs - (int32_t)recoveryEmaMs) >> WELL_RECOVERY_EMA_SHIFT;
+            recoveryPending = false;
+        }
+    }
+    wellEmpty = isWellEmpty;
+}
+
+/**
+ * @brief Decides if a pump may run.
+ * A running pump stops as soon as the well reads empty, a stopped pump stays off for the
+ * minimum off time, and a pump paused by the well resumes only once the
+ * well has read full for the resume delay. A pump without demand is stopped right away.
+ * A pump is not started within PUMP_START_STAGGER_MS of the start of any other pump.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @param demand True if the control mode wants the pump running.
+ * @param nowMs Current time in milliseconds.
+ * @return True if the pump must be active, false otherwise.
+ */
+bool WellRecovery::RequestPump(uint8_t pump, bool demand, uint32_t nowMs) {
+    PumpTrack &p = pumps[pump];
+
+    if (!demand) {
+        p.pausedByWell = false;
+        if (p.running) {
+            StopPump(pump, nowMs);
+        }
+        return false;
+    }
+
+    if (p.running) {
+        if (wellEmpty) {
+            StopPump(pump, nowMs);
+            p.pausedByWell = true;
+            RecordDryEvent(nowMs);
+        } else if (nowMs - p.startMs >= WELL_STABLE_RUN_MS) {
+            dryStreak = 0;
+        }
+        return p.running;
+    }
+
+    /** Let the back-off decay while the pump is held off so a long dry spell cannot lock it out */
+    if ((dryStreak > 0) && (nowMs - lastBackoffMs >= WELL_DRY_STREAK_WINDOW_MS)) {
+        dryStreak--;
+        lastBackoffMs = nowMs;
+    }
+
+    if (wellEmpty) {
+        p.pausedByWell = true;
+        return false;
+    }
+    if (nowMs - p.stopMs < WELL_MIN_OFF_TIME_MS) {
+        return false;
+    }
+    if (p.pausedByWell && (nowMs - wellFullSinceMs < getResumeDelayMs())) {
+        return false;
+    }
+    if (nowMs - lastStartMs < PUMP_START_STAGGER_MS) {
+        return false;
+    }
+
+    p.pausedByWell = false;
+    StartPump(pump, nowMs);
+    return true;
+}
+
+/**
+ * @brief Records a pump switched without RequestPump(), by the manual mode, so the minimum off
+ * time and the start stagger of the automatic modes count from its real last stop and start.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @param on True if the pump is active.
+ * @param nowMs Current time in milliseconds.
+ */
+void WellRecovery::TrackPump(uint8_t pump, bool on, uint32_t nowMs) {
+    PumpTrack &p = pumps[pump];
+
+    p.pausedByWell = false;
+    if (on && !p.running) {
+        StartPump(pump, nowMs);
+    } else if (!on && p.running) {
+        StopPump(pump, nowMs);
+    }
+}
+
+/**
+ * @brief Checks if a pump is held off because the well ran dry.
+ * @param pump Index of the pump (0 = pump 1, 1 = pump 2).
+ * @return True if the pump is demanded but paused by the well, false otherwise.
+ */
+bool WellRecovery::isPausedByWell(uint8_t pump) {
+    return pumps[pump].pausedByWell;
+}
+
+/**
+ * @brief Gets the time the well must read full before a paused pump resumes.
+ * It is the learned well recovery time, doubled for every repeated dry event.
+ * @return The resume delay in milliseconds.
+ */
+uint32_t WellRecovery::getResumeDelayMs() {
+    uint32_t delayMs = max(recoveryEmaMs, WELL_RESUME_DELAY_MIN_MS);
+    for (uint8_t i = 1; i < dryStreak && delayMs < WELL_RESUME_DELAY_MAX_MS; i++) {
+        delayMs <<= 1;
+    }
+    return min(delayMs, WELL_RESUME_DELAY_MAX_MS);
+}
+
+/**
+ * @brief Gets the learned time the well needs to read full again after running dry.
+ * @return The average recovery time in milliseconds.
+ */
+uint32_t WellRecovery::getRecoveryTimeMs() {
+    return recoveryEmaMs;
+}
+
+/**
+ * @brief Gets the number of pump starts since power up.
+ * @return The starts count (saturates at 65535).
+ */
+uint16_t WellRecovery::getStartCount() {
+    return startCount;
+}
+
+/**
+ * @brief Records a pump start.
+ * @param pump Index of the pump.
+ * @param nowMs Current time in milliseconds.
+ */
+void WellRecovery::StartPump(uint8_t pump, uint32_t nowMs) {
+    pumps[pump].running = true;
+    pumps[pump].startMs = nowMs;
+    lastStartMs = nowMs;
+    if (startCount < 0xFFFF) {
+        startCount++;
+    }
+}
+
+/**
+ * @brief Records a pump stop.
+ * @param pump Index of the pump.
+ * @param nowMs Current time in milliseconds.
+ */
+void WellRecovery::StopPump(uint8_t pump, uint32_t nowMs) {
+    pumps[pump].running = false;
+    pumps[pump].stopMs = nowMs;
+}
+
+/**
+ * @brief Records a pump stopped by a dry well and updates the back-off.
+ * @param nowMs Current time in milliseconds.
+ */
+void WellRecovery::RecordDryEvent(uint32_t nowMs) {
+    if ((dryStreak > 0) && (nowMs - lastDryMs < WELL_DRY_STREAK_WINDOW_MS)) {
+        if (dryStreak < WELL_DRY_STREAK_MAX) {
+            dryStreak++;
+        }
+    } else {
+        dryStreak = 1;
+    }
+    lastDryMs = nowMs;
+    lastBackoffMs = nowMs;
+    recoveryPending = true;
+    LogSerialn("Well dry, resume delay " + String(getResumeDelayMs() / 1000) + " s, starts " + String(startCount), true);
+}
@@ -1,23 +1,50 @@
 #include "utilities.h"
 
 /**
- * @brief Logs data to the serial monitor.
+ * @brief Logs data to the serial monitor. Does nothing when the USART is used by a bus.
  * @param data The string to log.
  * @param IsLog A flag to indicate whether to log the data or not.
  */
 void LogSerial(String data, bool IsLog) {
+#if SERIAL_LOG_ENABLED
     if (IsLog) {
         Serial.print(data);
     }
+#endif
 }
 
 /**
- * @brief Logs data to the serial monitor with a newline at the end.
+ * @brief Logs data to the serial monitor with a newline at the end. Does nothing when the USART is used by a bus.
  * @param data The string to log.
  * @param IsLog A flag to indicate whether to log the data or not.
  */
 void LogSerialn(String data, bool IsLog) {
+#if SERIAL_LOG_ENABLED
     if (IsLog) {
         Serial.println(data);
     }
+#endif
+}
+
+/**
+ * @brief Integer square root.
+ * @param value The value to get the square root of.
+ * @return The largest integer whose square is less than or equal to value.
+ */
+uint32_t ISqrt64(uint64_t value) {
+    uint64_t result = 0;
+    uint64_t bitVal = 1ULL << 62;
+    while (bitVal > value) {
+        bitVal >>= 2;
+    }
+    while (bitVal != 0) {
+        if (value >= result + bitVal) {
+            value -= result + bitVal;
+            result = (result >> 1) + bitVal;
+        } else {
+            result >>= 1;
+        }
+        bitVal >>= 2;
+    }
+    return (uint32_t)result;
 }
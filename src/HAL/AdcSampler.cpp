@@ -0,0 +1,107 @@
+#include "AdcSampler.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+/* One decimated block: sums of ADC_SAMPLER_OVERSAMPLE 10-bit samples */
+struct AdcBlock {
+    uint16_t sum;
+    uint32_t sumSq;
+};
+
+struct AdcChannel {
+    uint8_t mux;
+    uint8_t count;
+    uint16_t sum;
+    uint32_t sumSq;
+    uint8_t head;
+    uint8_t filled;
+    AdcBlock ring[ADC_SAMPLER_RING_SIZE];
+};
+
+static AdcChannel channels[ADC_SAMPLER_MAX_CHANNELS];
+static uint8_t numChannels = 0;
+static volatile uint8_t convChannel = 0;  /* Channel of the conversion that completes next */
+static volatile uint8_t nextChannel = 0;  /* Channel of the conversion after it */
+
+/**
+ * @brief Registers an analog pin to be sampled. Must be called before AdcSampler_Begin().
+ * @param pin The Arduino analog pin (A0..A7).
+ * @return Index of the channel, ADC_SAMPLER_NO_CHANNEL if the pin is invalid or no channel is left.
+ */
+uint8_t AdcSampler_AddChannel(uint8_t pin) {
+    if ((pin < A0) || (pin > A7) || (numChannels >= ADC_SAMPLER_MAX_CHANNELS)) {
+        return ADC_SAMPLER_NO_CHANNEL;
+    }
+    channels[numChannels].mux = pin - A0;
+    return numChannels++;
+}
+
+/**
+ * @brief Starts the ADC in free running mode, AVcc reference.
+ * From then on analogRead() must not be used, the ADC belongs to the sampler.
+ */
+void AdcSampler_Begin() {
+    if (numChannels == 0) {
+        return;
+    }
+    convChannel = 0;
+    nextChannel = 0;
+    ADMUX = _BV(REFS0) | channels[0].mux;
+    ADCSRB = 0;  /* Free running trigger source */
+    ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    ADCSRA |= _BV(ADSC);
+}
+
+/**
+ * @brief Gets the sums of the blocks in the ring of a channel, which cover the last
+ * ADC_SAMPLER_RING_SIZE * ADC_SAMPLER_OVERSAMPLE samples. Never waits for a conversion.
+ * @param index Index of the channel returned by AdcSampler_AddChannel().
+ * @param sums Set to the sums of the samples and their squares, count is 0 until a block is complete.
+ */
+void AdcSampler_GetSums(uint8_t index, AdcSums &sums) {
+    sums.sum = 0;
+    sums.sumSq = 0;
+    sums.count = 0;
+    if (index >= numChannels) {
+        return;
+    }
+    AdcChannel &ch = channels[index];
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < ch.filled; i++) {
+            sums.sum += ch.ring[i].sum;
+            sums.sumSq += ch.ring[i].sumSq;
+        }
+        sums.count = ch.filled * ADC_SAMPLER_OVERSAMPLE;
+    }
+}
+
+/**
+ * @brief ADC conversion complete interrupt.
+ * In free running mode the next conversion already started when this runs, so a new channel
+ * selected here applies to the conversion after it. The sample is added to the block of its
+ * channel, and a full block is pushed into the channel ring.
+ */
+ISR(ADC_vect) {
+    uint16_t sample = ADC;
+    AdcChannel &ch = channels[convChannel];
+
+    ch.sum += sample;
+    ch.sumSq += (uint32_t)sample * sample;
+    if (++ch.count >= ADC_SAMPLER_OVERSAMPLE) {
+        ch.ring[ch.head].sum = ch.sum;
+        ch.ring[ch.head].sumSq = ch.sumSq;
+        ch.head = (ch.head + 1) & (ADC_SAMPLER_RING_SIZE - 1);
+        if (ch.filled < ADC_SAMPLER_RING_SIZE) {
+            ch.filled++;
+        }
+        ch.count = 0;
+        ch.sum = 0;
+        ch.sumSq = 0;
+    }
+
+    convChannel = nextChannel;
+    if (++nextChannel >= numChannels) {
+        nextChannel = 0;
+    }
+    ADMUX = _BV(REFS0) | channels[nextChannel].mux;
+}
@@ -0,0 +1,171 @@
+#include "Bench.h"
+
+#if BENCH_ENABLED
+
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+struct BenchStats {
+    uint32_t count;
+    uint32_t sumCycles;
+    uint32_t maxCycles;
+};
+
+static const char *const BenchStageNames[BENCH_STAGE_COUNT] = {
+    "loop", "poll_sensors", "control_tick", "buttons", "render", "nvm_save",
+    "mode_selection", "ctrl_sensors", "ctrl_timer", "sensor_poll", "format_datetime"
+};
+
+/* Baseline of the maximum cycles of each stage, copied from the report of a reference run.
+ * A stage over its budget by more than BENCH_TOLERANCE_PCT fails the report, 0 = not checked */
+static const uint32_t BenchBudgetCycles[BENCH_STAGE_COUNT] = {
+    0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0
+};
+
+static BenchStats stats[BENCH_STAGE_COUNT];
+static volatile uint16_t timerOverflows = 0;
+static uint32_t i2cBytes = 0;
+static uint32_t windowStartMs = 0;
+static uint16_t lastHeapBytes = 0;
+
+/* Linker symbols bounding the static data in SRAM and the image in flash */
+extern uint8_t __data_start;
+extern uint8_t __bss_end;
+extern uint8_t __data_load_end;
+extern uint8_t *__brkval;
+extern uint8_t __heap_start;
+
+/**
+ * @brief Gets the size of the heap, which only grows when an allocation does not fit in a freed block.
+ * @return The heap size in bytes.
+ */
+static uint16_t HeapBytes() {
+    return (__brkval != 0) ? (uint16_t)(__brkval - &__heap_start) : 0;
+}
+
+/**
+ * @brief Starts Timer1 as a free running CPU cycle counter, clock without prescaler.
+ */
+void Bench_Begin() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TCCR1A = 0;
+        TCCR1B = _BV(CS10);
+        TCNT1 = 0;
+        TIFR1 = _BV(TOV1);
+        TIMSK1 = _BV(TOIE1);
+        timerOverflows = 0;
+    }
+    memset(stats, 0, sizeof(stats));
+    i2cBytes = 0;
+    windowStartMs = millis();
+    /** The first window sets the reference, so buffers allocated once on first use are not counted as growth */
+    lastHeapBytes = UINT16_MAX;
+}
+
+/**
+ * @brief Gets the CPU cycle count, wraps after 2^32 cycles (268 s at 16 MHz).
+ * @return The cycles since Bench_Begin().
+ */
+uint32_t Bench_Cycles() {
+    uint16_t high;
+    uint16_t low;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        high = timerOverflows;
+        low = TCNT1;
+        /** An overflow not served yet belongs to this reading if the counter already wrapped */
+        if ((TIFR1 & _BV(TOV1)) && (low < 0x8000)) {
+            high++;
+        }
+    }
+    return ((uint32_t)high << 16) | low;
+}
+
+/**
+ * @brief Adds a measurement to a stage.
+ * @param stage The measured stage.
+ * @param cycles The CPU cycles it took.
+ */
+void Bench_Record(BenchStage_t stage, uint32_t cycles) {
+    BenchStats &s = stats[stage];
+    s.count++;
+    s.sumCycles += cycles;
+    if (cycles > s.maxCycles) {
+        s.maxCycles = cycles;
+    }
+}
+
+/**
+ * @brief Counts the bytes sent or received on the I2C bus by the instrumented drivers.
+ * @param bytes Bytes of the transaction, address byte included.
+ */
+void Bench_CountI2cBytes(uint16_t bytes) {
+    i2cBytes += bytes;
+}
+
+/**
+ * @brief Prints the report of the window as one JSON line and starts a new window, once every BENCH_REPORT_MS.
+ * Must be called outside the measured stages.
+ * @param nowMs Current time in milliseconds.
+ */
+void Bench_Report(uint32_t nowMs) {
+    uint32_t windowMs = nowMs - windowStartMs;
+    if (windowMs < BENCH_REPORT_MS) {
+        return;
+    }
+
+    uint8_t stackMarker;
+    uint8_t *heapEnd = (__brkval != 0) ? __brkval : &__bss_end;
+    uint16_t heapBytes = HeapBytes();
+    bool pass = (heapBytes <= lastHeapBytes);
+
+    Serial.print(F("{\"bench\":{\"window_ms\":"));
+    Serial.print(windowMs);
+    for (uint8_t i = 0; i < BENCH_STAGE_COUNT; i++) {
+        uint32_t budget = BenchBudgetCycles[i];
+        bool overBudget = (budget > 0) && (stats[i].maxCycles > budget + budget / 100 * BENCH_TOLERANCE_PCT);
+        pass = pass && !overBudget;
+        Serial.print(F(",\""));
+        Serial.print(BenchStageNames[i]);
+        Serial.print(F("\":{\"n\":"));
+        Serial.print(stats[i].count);
+        Serial.print(F(",\"mean_cycles\":"));
+        Serial.print((stats[i].count > 0) ? stats[i].sumCycles / stats[i].count : 0UL);
+        Serial.print(F(",\"max_cycles\":"));
+        Serial.print(stats[i].maxCycles);
+        if (overBudget) {
+            Serial.print(F(",\"over_budget\":true"));
+        }
+        Serial.print('}');
+    }
+    Serial.print(F(",\"i2c_bytes_per_s\":"));
+    Serial.print(i2cBytes * 1000UL / windowMs);
+    Serial.print(F(",\"flash_bytes\":"));
+    Serial.print((uint16_t)(uintptr_t)&__data_load_end);
+    Serial.print(F(",\"sram_static_bytes\":"));
+    Serial.print((uint16_t)(&__bss_end - &__data_start));
+    Serial.print(F(",\"sram_free_bytes\":"));
+    Serial.print((uint16_t)(&stackMarker - heapEnd));
+    Serial.print(F(",\"heap_growth_bytes\":"));
+    Serial.print((heapBytes > lastHeapBytes) ? heapBytes - lastHeapBytes : 0);
+    Serial.print(F(",\"pass\":"));
+    Serial.print(pass ? F("true") : F("false"));
+    Serial.println(F("}}"));
+    if (!pass) {
+        Serial.println(F("BENCH FAIL: a stage is over its budget or the heap grew"));
+    }
+
+    memset(stats, 0, sizeof(stats));
+    i2cBytes = 0;
+    windowStartMs = nowMs;
+    lastHeapBytes = heapBytes;
+}
+
+/**
+ * @brief Timer1 overflow interrupt, every 65536 cycles.
+ */
+ISR(TIMER1_OVF_vect) {
+    timerOverflows++;
+}
+
+#endif
@@ -1,12 +1,17 @@
 #include "DI_Inputs.h"
+#include "IoExpander.h"
 
 /**
  * @brief Constructor for DI_Inputs class.
  * Initializes the pin and sets it as an input.
- * @param pin The pin number to be used for digital input. 
+ * @param pin The pin number to be used for digital input, native or IO_EXP_PIN(). 
  */
 DI_Inputs::DI_Inputs(uint8_t pin) : pin(pin) {
-    pinMode(pin, INPUT);
+    if (IoExpander_IsExpanderPin(pin)) {
+        IoExpander_ConfigurePin(pin, false);
+    } else {
+        pinMode(pin, INPUT);
+    }
 }
 
 /**
@@ -19,8 +24,12 @@ uint8_t DI_Inputs::getPin() {
 
 /**
  * @brief Reads the digital input from the specified pin.
+ * An expander input is taken from the last IoExpander_Update(), without bus traffic.
  * @return True if the input is HIGH, false if it is LOW.
  */
 bool DI_Inputs::readInputPin() {
+    if (IoExpander_IsExpanderPin(pin)) {
+        return IoExpander_ReadPin(pin);
+    }
     return digitalRead(pin);
 }
\ No newline at end of file
@@ -1,19 +1,39 @@
 #include "DO_Outputs.h"
+#include "IoExpander.h"
 
 /**
  * @brief Constructor for DO_Outputs class.
  * Initializes the pin and sets it as an output.
- * @param pin The pin number to be used for digital output.
+ * @param pin The pin number to be used for digital output, native or IO_EXP_PIN().
  */
 DO_Outputs::DO_Outputs(uint8_t pin) : pin(pin) {
-    pinMode(pin, OUTPUT);
+    if (IoExpander_IsExpanderPin(pin)) {
+        IoExpander_ConfigurePin(pin, true);
+    } else {
+        pinMode(pin, OUTPUT);
+    }
 }
 /**
  * @brief Sets the state of the output pin.
+ * An expander output is written to the device by the next IoExpander_Flush().
  * @param state True to set the pin HIGH, false to set it LOW.
  */
 void DO_Outputs::setOutputPin(bool state) {
-    digitalWrite(pin, state ? HIGH : LOW);
+    if (IoExpander_IsExpanderPin(pin)) {
+        IoExpander_WritePin(pin, state);
+    } else {
+        digitalWrite(pin, state ? HIGH : LOW);
+    }
+}
+/**
+ * @brief Gets the state the output pin was set to.
+ * @return True if the pin is set HIGH, false if it is set LOW.
+ */
+bool DO_Outputs::getOutputPin() {
+    if (IoExpander_IsExpanderPin(pin)) {
+        return IoExpander_GetOutput(pin);
+    }
+    return digitalRead(pin) == HIGH;
 }
 /**
  * @brief Gets the pin number associated with this output.
@@ -0,0 +1,270 @@
+#include "IoExpander.h"
+#include "PinChangeInt.h"
+#include "Bench.h"
+#include <Wire.h>
+
+/* MCP23017 registers, IOCON.BANK = 0 so the A and B registers of a pair are adjacent */
+#define MCP23017_IODIRA   (0x00)
+#define MCP23017_GPINTENA (0x04)
+#define MCP23017_IOCON    (0x0A)
+#define MCP23017_GPIOA    (0x12)
+#define MCP23017_OLATA    (0x14)
+
+#define MCP23017_IOCON_MIRROR (0x40)  /* INTA and INTB are one line */
+#define MCP23017_IOCON_ODR    (0x04)  /* Open drain INT, can be wired together with other devices */
+
+struct IoExpanderDevice {
+    uint8_t type;
+    uint8_t i2cAddr;
+    uint16_t outputMask;   /* 1 = pin is an output */
+    uint16_t inputs;       /* Image of the pins, read from the device */
+    uint16_t outputs;      /* Image of the output latches, written to the device */
+    bool outputsDirty;
+};
+
+static IoExpanderDevice devices[IO_EXPANDER_MAX_DEVICES];
+static uint16_t configuredOutputs[IO_EXPANDER_MAX_DEVICES];
+static uint8_t numDevices = 0;
+static uint8_t interruptPin = IO_EXPANDER_NO_INT_PIN;
+static volatile bool inputsChanged = true;
+static uint16_t errorCount = 0;
+
+/**
+ * @brief Pin change callback of the expanders INT line, flags new inputs when the line goes low.
+ * @param level The new level of the line.
+ */
+static void OnExpanderInterrupt(bool level) {
+    if (!level) {
+        inputsChanged = true;
+    }
+}
+
+/**
+ * @brief Writes consecutive registers of an MCP23017 in one transaction.
+ * @param dev The device.
+ * @param reg The first register.
+ * @param valueA Value of the first register.
+ * @param valueB Value of the next register.
+ * @return True if the device acknowledged the write.
+ */
+static bool WriteMcpPair(IoExpanderDevice &dev, uint8_t reg, uint8_t valueA, uint8_t valueB) {
+    Wire.beginTransmission(dev.i2cAddr);
+    Wire.write(reg);
+    Wire.write(valueA);
+    Wire.write(valueB);
+    BENCH_I2C_BYTES(4);
+    if (Wire.endTransmission() != 0) {
+        errorCount++;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads all the pins of a device in one transaction. The image is kept if the device does not answer.
+ * @param dev The device.
+ */
+static void ReadDevice(IoExpanderDevice &dev) {
+    uint8_t length = (dev.type == IO_EXPANDER_MCP23017) ? 2 : 1;
+    if (dev.type == IO_EXPANDER_MCP23017) {
+        Wire.beginTransmission(dev.i2cAddr);
+        Wire.write(MCP23017_GPIOA);
+        if (Wire.endTransmission(false) != 0) {
+            errorCount++;
+            return;
+        }
+    }
+    if (Wire.requestFrom(dev.i2cAddr, length) != length) {
+        errorCount++;
+        return;
+    }
+    BENCH_I2C_BYTES((dev.type == IO_EXPANDER_MCP23017) ? length + 3 : length + 1);
+    uint16_t value = Wire.read();
+    if (length == 2) {
+        value |= (uint16_t)Wire.read() << 8;
+    }
+    dev.inputs = value;
+}
+
+/**
+ * @brief Writes the output latches of a device in one transaction, retried by the next flush if it fails.
+ * The PCF8574 inputs are written high, so they are weakly pulled up and can be read.
+ * @param dev The device.
+ */
+static void WriteDevice(IoExpanderDevice &dev) {
+    bool written;
+    if (dev.type == IO_EXPANDER_MCP23017) {
+        written = WriteMcpPair(dev, MCP23017_OLATA, dev.outputs & 0xFF, dev.outputs >> 8);
+    } else {
+        Wire.beginTransmission(dev.i2cAddr);
+        Wire.write((uint8_t)((dev.outputs | ~dev.outputMask) & 0xFF));
+        BENCH_I2C_BYTES(2);
+        written = (Wire.endTransmission() == 0);
+        if (!written) {
+            errorCount++;
+        }
+    }
+    dev.outputsDirty = !written;
+}
+
+/**
+ * @brief Checks if a pin number belongs to an expander.
+ * @param pin The pin number.
+ * @return True for an expander pin, false for a native one.
+ */
+bool IoExpander_IsExpanderPin(uint8_t pin) {
+    return pin >= IO_EXPANDER_FIRST_PIN;
+}
+
+/**
+ * @brief Registers an expander. Must be called before IoExpander_Begin().
+ * @param type The expander type.
+ * @param i2cAddr The 7-bit I2C address.
+ * @return Index of the device used by IO_EXP_PIN(), IO_EXPANDER_NONE if no device is left.
+ */
+uint8_t IoExpander_Add(IoExpanderType_t type, uint8_t i2cAddr) {
+    if (numDevices >= IO_EXPANDER_MAX_DEVICES) {
+        return IO_EXPANDER_NONE;
+    }
+    IoExpanderDevice &dev = devices[numDevices];
+    dev.type = type;
+    dev.i2cAddr = i2cAddr;
+    dev.inputs = 0;
+    dev.outputs = 0;
+    dev.outputsDirty = true;
+    return numDevices++;
+}
+
+/**
+ * @brief Sets the direction of an expander pin, called by the DI_Inputs and DO_Outputs constructors.
+ * It only records the direction, so it works for global objects built before the devices are added.
+ * @param pin The expander pin number.
+ * @param output True for an output, false for an input.
+ */
+void IoExpander_ConfigurePin(uint8_t pin, bool output) {
+    uint8_t index = (pin - IO_EXPANDER_FIRST_PIN) / IO_EXPANDER_PINS_PER_DEVICE;
+    if (index >= IO_EXPANDER_MAX_DEVICES) {
+        return;
+    }
+    uint16_t bit = 1U << ((pin - IO_EXPANDER_FIRST_PIN) % IO_EXPANDER_PINS_PER_DEVICE);
+    if (output) {
+        configuredOutputs[index] |= bit;
+    } else {
+        configuredOutputs[index] &= ~bit;
+    }
+}
+
+/**
+ * @brief Configures the devices, all outputs off, and reads their inputs. Must be called after Wire.begin().
+ * @param intPin The pin of the INT line of the devices wired together, one of the pin change
+ * interrupt pins, IO_EXPANDER_NO_INT_PIN to read the inputs on every update.
+ */
+void IoExpander_Begin(uint8_t intPin) {
+    for (uint8_t i = 0; i < numDevices; i++) {
+        IoExpanderDevice &dev = devices[i];
+        dev.outputMask = configuredOutputs[i];
+        if (dev.type == IO_EXPANDER_MCP23017) {
+            uint8_t iocon = MCP23017_IOCON_MIRROR | MCP23017_IOCON_ODR;
+            uint16_t inputMask = ~dev.outputMask;
+            WriteMcpPair(dev, MCP23017_IOCON, iocon, iocon);
+            WriteMcpPair(dev, MCP23017_IODIRA, inputMask & 0xFF, inputMask >> 8);
+            WriteMcpPair(dev, MCP23017_GPINTENA, inputMask & 0xFF, inputMask >> 8);
+        }
+        WriteDevice(dev);
+        ReadDevice(dev);
+    }
+
+    interruptPin = IO_EXPANDER_NO_INT_PIN;
+    if ((intPin != IO_EXPANDER_NO_INT_PIN) && (numDevices > 0)) {
+        pinMode(intPin, INPUT_PULLUP);
+        if (PinChange_Attach(intPin, OnExpanderInterrupt)) {
+            interruptPin = intPin;
+        }
+    }
+    inputsChanged = false;
+}
+
+/**
+ * @brief Reads the expander inputs, one transaction per device. With the INT line it only reads
+ * when an input changed, so a quiet poll costs no bus traffic. Must be called before the sensors are polled.
+ */
+void IoExpander_Update() {
+    if (numDevices == 0) {
+        return;
+    }
+    if (interruptPin != IO_EXPANDER_NO_INT_PIN) {
+        /** The line stays low until the device that raised it is read, so a change is never missed */
+        if (!inputsChanged && (digitalRead(interruptPin) == HIGH)) {
+            return;
+        }
+        inputsChanged = false;
+    }
+    for (uint8_t i = 0; i < numDevices; i++) {
+        ReadDevice(devices[i]);
+    }
+}
+
+/**
+ * @brief Writes the output latches of the devices whose outputs changed, one transaction per device.
+ * Must be called after the outputs were set, e.g. at the end of the control tick.
+ */
+void IoExpander_Flush() {
+    for (uint8_t i = 0; i < numDevices; i++) {
+        if (devices[i].outputsDirty) {
+            WriteDevice(devices[i]);
+        }
+    }
+}
+
+/**
+ * @brief Gets the level of an expander pin from the last read of its device.
+ * @param pin The expander pin number.
+ * @return True if the pin is high, false if it is low or the device does not exist.
+ */
+bool IoExpander_ReadPin(uint8_t pin) {
+    uint8_t index = (pin - IO_EXPANDER_FIRST_PIN) / IO_EXPANDER_PINS_PER_DEVICE;
+    if (index >= numDevices) {
+        return false;
+    }
+    return devices[index].inputs & (1U << ((pin - IO_EXPANDER_FIRST_PIN) % IO_EXPANDER_PINS_PER_DEVICE));
+}
+
+/**
+ * @brief Sets an expander output. The device is written by the next IoExpander_Flush(), only if the output changed.
+ * @param pin The expander pin number.
+ * @param state True for high, false for low.
+ */
+void IoExpander_WritePin(uint8_t pin, bool state) {
+    uint8_t index = (pin - IO_EXPANDER_FIRST_PIN) / IO_EXPANDER_PINS_PER_DEVICE;
+    if (index >= numDevices) {
+        return;
+    }
+    IoExpanderDevice &dev = devices[index];
+    uint16_t bit = 1U << ((pin - IO_EXPANDER_FIRST_PIN) % IO_EXPANDER_PINS_PER_DEVICE);
+    uint16_t outputs = state ? (dev.outputs | bit) : (dev.outputs & ~bit);
+    if (outputs != dev.outputs) {
+        dev.outputs = outputs;
+        dev.outputsDirty = true;
+    }
+}
+
+/**
+ * @brief Gets the state an expander output was set to.
+ * @param pin The expander pin number.
+ * @return True if the output is set high, false otherwise.
+ */
+bool IoExpander_GetOutput(uint8_t pin) {
+    uint8_t index = (pin - IO_EXPANDER_FIRST_PIN) / IO_EXPANDER_PINS_PER_DEVICE;
+    if (index >= numDevices) {
+        return false;
+    }
+    return devices[index].outputs & (1U << ((pin - IO_EXPANDER_FIRST_PIN) % IO_EXPANDER_PINS_PER_DEVICE));
+}
+
+/**
+ * @brief Gets the number of failed transactions with the devices.
+ * @return The error count.
+ */
+uint16_t IoExpander_GetErrorCount() {
+    return errorCount;
+}
@@ -2,19 +2,16 @@
 
 /**
  * @brief Initializes the LCD display.
- * This function initializes the LCD display by calling the begin() method of the LiquidCrystal_I2C object,
- * sets the backlight, and clears the display.
+ * This function initializes the LCD display by calling the begin() method of the PCF8574_Lcd object,
+ * which turns the backlight on and clears the display.
  */
 void LCD_Display::init() {
-    lcd.init();
-    lcd.backlight();
-    lcd.clear();
-    lcd.setCursor(0, 0);
+    lcd.begin();
 }
 
 /**
  * @brief Clears the LCD screen.
- * This function clears the LCD display by calling the clear() method of the LiquidCrystal_I2C object.
+ * This function clears the LCD display by calling the clear() method of the PCF8574_Lcd object.
  */
 void LCD_Display::clearScreen() {
     lcd.clear();
@@ -28,7 +25,18 @@ void LCD_Display::clearScreen() {
  */
 void LCD_Display::PrintMessage(const String &message, uint8_t col, uint8_t row) {
     lcd.setCursor(col, row);
-    lcd.print(message);
+    lcd.write(message.c_str());
+}
+
+/**
+ * @brief Prints a C string to the LCD display without building a String object.
+ * @param message The null-terminated message to be printed on the LCD.
+ * @param col The column position (0-based index) where the message will be printed.
+ * @param row The row position (0-based index) where the message will be printed.
+ */
+void LCD_Display::PrintMessage(const char *message, uint8_t col, uint8_t row) {
+    lcd.setCursor(col, row);
+    lcd.write(message);
 }
 
 /**
@@ -38,8 +46,10 @@ void LCD_Display::PrintMessage(const String &message, uint8_t col, uint8_t row)
  * @param row The row position (0-based index) where the value will be printed.
  */
 void LCD_Display::PrintMessage(int value, uint8_t col, uint8_t row) {
+    char valueStr[7];
+    itoa(value, valueStr, 10);
     lcd.setCursor(col, row);
-    lcd.print(value);
+    lcd.write(valueStr);
 }
 
 /**
@@ -49,4 +59,22 @@ void LCD_Display::PrintMessage(int value, uint8_t col, uint8_t row) {
  */
 void LCD_Display::setCursor(uint8_t col, uint8_t row) {
     lcd.setCursor(col, row);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Writes a whole row, padded with spaces to the display width.
+ * Only the characters that differ from what is already displayed are sent to the LCD.
+ * @param row The row position (0-based index).
+ * @param text The null-terminated text to be printed on the row.
+ */
+void LCD_Display::writeRow(uint8_t row, const char *text) {
+    lcd.writeRow(row, text);
+}
+
+/**
+ * @brief Turns the backlight on or off.
+ * @param on True to turn the backlight on, false to turn it off.
+ */
+void LCD_Display::setBacklight(bool on) {
+    lcd.setBacklight(on);
+}
@@ -0,0 +1,184 @@
+#include "ModbusUart.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+static uint8_t rxBuffer[MODBUS_FRAME_MAX];
+static volatile uint8_t rxLength = 0;
+static volatile bool rxOverflow = false;
+static volatile bool frameReady = false;
+static volatile uint16_t errorCount = 0;
+
+static uint8_t txBuffer[MODBUS_FRAME_MAX];
+static volatile uint8_t txLength = 0;
+static volatile uint8_t txIndex = 0;
+
+static uint8_t dePin = MODBUS_UART_NO_DE_PIN;
+static uint8_t t35Ticks = 0;
+
+/**
+ * @brief Restarts the t3.5 silent interval timer.
+ */
+static inline void RestartFrameTimer() {
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2A);
+    TIMSK2 = _BV(OCIE2A);
+}
+
+/**
+ * @brief Starts the USART0 and Timer2 for Modbus RTU, 8 data bits, no parity, 2 stop bits.
+ * @param baud The baud rate, 9600 or more so t3.5 fits the 8-bit timer.
+ * @param pin The RS-485 driver enable pin, MODBUS_UART_NO_DE_PIN for a module with automatic direction control.
+ */
+void ModbusUart_Begin(uint32_t baud, uint8_t pin) {
+    dePin = pin;
+    if (dePin != MODBUS_UART_NO_DE_PIN) {
+        pinMode(dePin, OUTPUT);
+        digitalWrite(dePin, LOW);
+    }
+
+    uint32_t ticks = (ModbusRtu_T35Us(baud) + MODBUS_UART_TIMER_TICK_US - 1) / MODBUS_UART_TIMER_TICK_US;
+    t35Ticks = (ticks > 255) ? 255 : (uint8_t)ticks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        /** Timer2 CTC, prescaler 256, the compare interrupt is enabled by each received byte */
+        TCCR2A = _BV(WGM21);
+        TCCR2B = _BV(CS22) | _BV(CS21);
+        OCR2A = t35Ticks - 1;
+        TIMSK2 = 0;
+
+        UCSR0A = _BV(U2X0);
+        UBRR0 = (uint16_t)((F_CPU / 8 + baud / 2) / baud - 1);
+        UCSR0C = _BV(USBS0) | _BV(UCSZ01) | _BV(UCSZ00);
+        UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0) | _BV(TXCIE0);
+
+        rxLength = 0;
+        rxOverflow = false;
+        frameReady = false;
+        txLength = 0;
+    }
+}
+
+/**
+ * @brief Copies the received frame if one is complete. The receiver ignores new bytes
+ * until ModbusUart_ReleaseFrame() or ModbusUart_Send() is called.
+ * @param frame Buffer of MODBUS_FRAME_MAX bytes.
+ * @return The frame length, 0 if no frame is complete.
+ */
+uint8_t ModbusUart_TakeFrame(uint8_t *frame) {
+    if (!frameReady) {
+        return 0;
+    }
+    uint8_t length = rxLength;
+    for (uint8_t i = 0; i < length; i++) {
+        frame[i] = rxBuffer[i];
+    }
+    return length;
+}
+
+/**
+ * @brief Discards the received frame and listens for the next one.
+ */
+void ModbusUart_ReleaseFrame() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        rxLength = 0;
+        rxOverflow = false;
+        frameReady = false;
+    }
+}
+
+/**
+ * @brief Sends a frame in the background and releases the received one.
+ * The receiver is off until the last stop bit was sent, so the echo of a 2-wire bus is not received.
+ * @param data The frame, including its CRC.
+ * @param length The frame length, at most MODBUS_FRAME_MAX.
+ */
+void ModbusUart_Send(const uint8_t *data, uint8_t length) {
+    if ((length == 0) || (length > MODBUS_FRAME_MAX)) {
+        ModbusUart_ReleaseFrame();
+        return;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        txBuffer[i] = data[i];
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        rxLength = 0;
+        rxOverflow = false;
+        frameReady = false;
+        txLength = length;
+        txIndex = 0;
+        UCSR0A |= _BV(TXC0);  /* Clear a stale transmit complete flag */
+        UCSR0B &= ~(_BV(RXEN0) | _BV(RXCIE0));
+        if (dePin != MODBUS_UART_NO_DE_PIN) {
+            digitalWrite(dePin, HIGH);
+        }
+        UCSR0B |= _BV(UDRIE0);
+    }
+}
+
+/**
+ * @brief Gets the number of frames dropped for a framing, overrun or parity error or for being too long.
+ * @return The error count.
+ */
+uint16_t ModbusUart_GetErrorCount() {
+    uint16_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = errorCount;
+    }
+    return count;
+}
+
+/**
+ * @brief USART receive complete interrupt. Stores the byte and restarts the silent interval timer.
+ */
+ISR(USART_RX_vect) {
+    uint8_t status = UCSR0A;
+    uint8_t data = UDR0;
+    if (frameReady) {
+        return;
+    }
+    if ((status & (_BV(FE0) | _BV(DOR0) | _BV(UPE0))) || (rxLength >= MODBUS_FRAME_MAX)) {
+        rxOverflow = true;
+    } else {
+        rxBuffer[rxLength++] = data;
+    }
+    RestartFrameTimer();
+}
+
+/**
+ * @brief Timer2 compare interrupt, t3.5 of silence ended the frame.
+ * Frames with a bad byte or longer than the buffer are dropped here.
+ */
+ISR(TIMER2_COMPA_vect) {
+    TIMSK2 = 0;
+    if (rxOverflow) {
+        errorCount++;
+        rxLength = 0;
+        rxOverflow = false;
+    } else if (rxLength > 0) {
+        frameReady = true;
+    }
+}
+
+/**
+ * @brief USART data register empty interrupt, loads the next byte to send.
+ */
+ISR(USART_UDRE_vect) {
+    UDR0 = txBuffer[txIndex++];
+    if (txIndex >= txLength) {
+        UCSR0B &= ~_BV(UDRIE0);
+    }
+}
+
+/**
+ * @brief USART transmit complete interrupt, the last stop bit left the shift register.
+ */
+ISR(USART_TX_vect) {
+    if ((txLength == 0) || (txIndex < txLength)) {
+        return;
+    }
+    txLength = 0;
+    if (dePin != MODBUS_UART_NO_DE_PIN) {
+        digitalWrite(dePin, LOW);
+    }
+    UCSR0B |= _BV(RXEN0) | _BV(RXCIE0);
+}
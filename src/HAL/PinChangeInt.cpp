@@ -0,0 +1,59 @@
+#include "PinChangeInt.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+static PinChangeCallback_t volatile pinCallbacks[PIN_CHANGE_NUM_PINS];
+static volatile uint8_t lastPortState = 0;
+
+/**
+ * @brief Enables the pin change interrupt of a pin and registers its callback.
+ * Only the pins of port B (D8..D13) are supported, the pin mode must be set by the caller.
+ * @param pin The Arduino pin number.
+ * @param callback Function called from the interrupt on every level change of the pin.
+ * @return True if the interrupt was enabled, false if the pin is not supported.
+ */
+bool PinChange_Attach(uint8_t pin, PinChangeCallback_t callback) {
+    if ((pin < PIN_CHANGE_FIRST_PIN) || (pin >= PIN_CHANGE_FIRST_PIN + PIN_CHANGE_NUM_PINS) || (callback == nullptr)) {
+        return false;
+    }
+    uint8_t pinBit = _BV(pin - PIN_CHANGE_FIRST_PIN);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        pinCallbacks[pin - PIN_CHANGE_FIRST_PIN] = callback;
+        lastPortState = (lastPortState & ~pinBit) | (PINB & pinBit);
+        PCMSK0 |= pinBit;
+        PCICR |= _BV(PCIE0);
+    }
+    return true;
+}
+
+/**
+ * @brief Disables the pin change interrupt of a pin.
+ * @param pin The Arduino pin number.
+ */
+void PinChange_Detach(uint8_t pin) {
+    if ((pin < PIN_CHANGE_FIRST_PIN) || (pin >= PIN_CHANGE_FIRST_PIN + PIN_CHANGE_NUM_PINS)) {
+        return;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        PCMSK0 &= ~_BV(pin - PIN_CHANGE_FIRST_PIN);
+        if (PCMSK0 == 0) {
+            PCICR &= ~_BV(PCIE0);
+        }
+        pinCallbacks[pin - PIN_CHANGE_FIRST_PIN] = nullptr;
+    }
+}
+
+/**
+ * @brief Port B pin change interrupt. Finds the enabled pins whose level changed and calls their callbacks.
+ */
+ISR(PCINT0_vect) {
+    uint8_t portState = PINB;
+    uint8_t changed = (portState ^ lastPortState) & PCMSK0;
+    lastPortState = portState;
+
+    for (uint8_t i = 0; changed != 0; i++, changed >>= 1) {
+        if ((changed & 0x01) && (pinCallbacks[i] != nullptr)) {
+            pinCallbacks[i]((portState >> i) & 0x01);
+        }
+    }
+}
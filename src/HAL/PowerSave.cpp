@@ -0,0 +1,71 @@
+#include "PowerSave.h"
+#include <avr/sleep.h>
+
+static uint32_t sleepUs = 0;          /* Time spent sleeping in the current window */
+static uint32_t backlightMs = 0;      /* Time with the backlight on in the current window */
+static uint32_t windowStartMs = 0;
+static uint32_t lastUpdateMs = 0;
+static uint16_t awakePermille = 1000;
+static uint16_t averageX10Ma = 0;
+
+/**
+ * @brief Puts the CPU in idle sleep until the next interrupt. The timers, the ADC, the USART,
+ * I2C and the pin change interrupts keep running, and the millis() timer overflow wakes the CPU
+ * at least every 1.024 ms, so nothing due is delayed by more than that.
+ */
+void PowerSave_Idle() {
+    uint32_t startUs = micros();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sleep_cpu();
+    sleep_disable();
+    sleepUs += micros() - startUs;
+}
+
+/**
+ * @brief Accumulates the backlight on time and computes the averages at the end of each window.
+ * Must be called once per control tick.
+ * @param backlightOn True if the LCD backlight is on.
+ * @param nowMs Current time in milliseconds.
+ */
+void PowerSave_Update(bool backlightOn, uint32_t nowMs) {
+    if (backlightOn) {
+        backlightMs += nowMs - lastUpdateMs;
+    }
+    lastUpdateMs = nowMs;
+
+    uint32_t windowMs = nowMs - windowStartMs;
+    if (windowMs < POWER_WINDOW_MS) {
+        return;
+    }
+    uint32_t sleepMs = min(sleepUs / 1000, windowMs);
+    awakePermille = (uint16_t)(1000UL - sleepMs * 1000UL / windowMs);
+    uint32_t backlightPermille = min(backlightMs, windowMs) * 1000UL / windowMs;
+
+    /** Weighted by the time in each state, in uA per mille */
+    uint32_t averageUa = (POWER_ACTIVE_UA * awakePermille +
+                          POWER_IDLE_UA * (1000UL - awakePermille) +
+                          POWER_BACKLIGHT_UA * backlightPermille) / 1000UL;
+    averageX10Ma = (uint16_t)(averageUa / 100);
+
+    windowStartMs = nowMs;
+    sleepUs = 0;
+    backlightMs = 0;
+}
+
+/**
+ * @brief Gets the share of time the CPU was awake in the last window.
+ * @return The awake time in per mille, 1000 until the first window is complete.
+ */
+uint16_t PowerSave_GetAwakePermille() {
+    return awakePermille;
+}
+
+/**
+ * @brief Gets the average supply current of the board in the last window, from the time awake,
+ * asleep and with the backlight on.
+ * @return The current in tenths of mA, 0 until the first window is complete.
+ */
+uint16_t PowerSave_GetAverageCurrentX10Ma() {
+    return averageX10Ma;
+}
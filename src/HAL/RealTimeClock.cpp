@@ -1,4 +1,6 @@
 #include "RealTimeClock.h"
+#include "utilities.h"
+#include "Bench.h"
 
 /**
  * @brief Constructor for RealTimeClock class.
@@ -12,8 +14,12 @@ RealTimeClock::RealTimeClock() : rtc() {}
  */
 void RealTimeClock::begin() {
     if (!rtc.begin()) {
-        Serial.println("Couldn't find RTC");
+        LogSerialn("Couldn't find RTC", true);
+#if !BENCH_ENABLED
         while (1);
+#else
+        return;  /* The benchmark image also runs under a simulator without the DS3231 */
+#endif
     }
 
     // Check if the RTC lost power and if so, set the date and time
@@ -42,9 +48,48 @@ void RealTimeClock::setDateTime(const DateTime &dt) {
  * @return A string in the format "DD/MM HH:MM:SS".
  */
 String RealTimeClock::getFormattedDateTime() {
-    DateTime now = GetCurrentDateTime();
     char buf[18];
-    snprintf(buf, sizeof(buf), "%02d/%02d %02d:%02d:%02d",
-             now.day(), now.month(), now.hour(), now.minute(), now.second());
+    FormatDateTime(GetCurrentDateTime(), buf, sizeof(buf));
     return String(buf);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Formats a date and time without reading the RTC.
+ * @param dt The DateTime object to format.
+ * @param buf Buffer where the string in the format "DD/MM HH:MM:SS" is stored.
+ * @param bufSize Size of the buffer, at least 15 bytes.
+ */
+void RealTimeClock::FormatDateTime(const DateTime &dt, char *buf, size_t bufSize) {
+    BENCH_BEGIN(BENCH_FORMAT_DATETIME);
+    snprintf(buf, bufSize, "%02d/%02d %02d:%02d:%02d",
+             dt.day(), dt.month(), dt.hour(), dt.minute(), dt.second());
+    BENCH_END(BENCH_FORMAT_DATETIME);
+}
+
+/**
+ * @brief Configures the INT/SQW pin as the active low alarm interrupt output.
+ * Both alarms are disabled and their flags cleared, so the pin is released until SetAlarm1() is called.
+ */
+void RealTimeClock::EnableAlarmInterrupt() {
+    rtc.writeSqwPinMode(DS3231_OFF);
+    rtc.disableAlarm(1);
+    rtc.disableAlarm(2);
+    rtc.clearAlarm(1);
+    rtc.clearAlarm(2);
+}
+
+/**
+ * @brief Sets alarm 1 to fire at a time of the week.
+ * The alarm matches the day of the week, hour, minute and second, so it can be up to one week ahead.
+ * @param dt The DateTime at which the alarm fires.
+ */
+void RealTimeClock::SetAlarm1(const DateTime &dt) {
+    rtc.setAlarm1(dt, DS3231_A1_Day);
+}
+
+/**
+ * @brief Clears the alarm 1 flag, which releases the INT/SQW pin.
+ */
+void RealTimeClock::ClearAlarm1() {
+    rtc.clearAlarm(1);
+}
@@ -0,0 +1,160 @@
+#include "Watchdog.h"
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+
+#define WDT_RECORD_MAGIC (0xC5A3)
+
+/* Updated while running and read back after the reset, the start-up code leaves .noinit untouched */
+static CrashRecord liveRecord __attribute__((section(".noinit")));
+static uint16_t liveMagic __attribute__((section(".noinit")));
+static uint8_t resetFlags __attribute__((section(".noinit")));
+
+static CrashRecord lastCrash;
+static bool crashPending = false;
+static uint8_t checkedIn = 0;
+static void (*safeStateCallback)(void) = nullptr;
+
+/**
+ * @brief Saves the reset flags and stops a watchdog left running by the reset, before the
+ * C runtime is initialized, so a short watchdog period cannot expire during the start-up.
+ * The flags read 0 if the bootloader already cleared them.
+ */
+void Watchdog_ReadResetFlags(void) __attribute__((naked, used, section(".init3")));
+void Watchdog_ReadResetFlags(void) {
+    resetFlags = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+/**
+ * @brief Completes the crash record from the watchdog interrupt, forces the safe state and resets.
+ * @param pcWord Word address of the instruction interrupted by the watchdog.
+ */
+static void __attribute__((noreturn, noinline)) OnWatchdogTimeout(uint16_t pcWord) {
+    liveRecord.pc = pcWord << 1;
+    liveRecord.cause = CRASH_CAUSE_WATCHDOG;
+    if (safeStateCallback != nullptr) {
+        safeStateCallback();
+    }
+    /** The reset releases every pin, no need to wait for a second period */
+    wdt_enable(WDTO_15MS);
+    for (;;) {
+    }
+}
+
+/**
+ * @brief Starts the watchdog in interrupt and reset mode, the interrupt captures the crash record
+ * and the reset follows 15 ms later. Must be called first in setup(), which is supervised as one task.
+ * The record of the previous run is kept if the last reset was a watchdog or brown-out reset.
+ * @param safeState Function called from the watchdog interrupt to switch the pumps off, must not use I2C.
+ */
+void Watchdog_Begin(void (*safeState)(void)) {
+    crashPending = false;
+    if ((liveMagic == WDT_RECORD_MAGIC) && !(resetFlags & _BV(PORF))) {
+        lastCrash = liveRecord;
+        if (liveRecord.cause == CRASH_CAUSE_WATCHDOG) {
+            crashPending = true;
+        } else if (resetFlags & _BV(BORF)) {
+            lastCrash.cause = CRASH_CAUSE_BROWNOUT;
+            lastCrash.pc = 0;
+            crashPending = true;
+        } else if (resetFlags & _BV(WDRF)) {
+            /** Reset without the interrupt, e.g. while interrupts were disabled */
+            lastCrash.cause = CRASH_CAUSE_WATCHDOG;
+            lastCrash.pc = 0;
+            crashPending = true;
+        }
+    }
+
+    liveRecord.cause = CRASH_CAUSE_NONE;
+    liveRecord.task = WDT_TASK_SETUP;
+    liveRecord.pc = 0;
+    liveRecord.loopCount = 0;
+    liveMagic = WDT_RECORD_MAGIC;
+    resetFlags = 0;
+
+    safeStateCallback = safeState;
+    checkedIn = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        wdt_reset();
+        WDTCSR = _BV(WDCE) | _BV(WDE);
+        WDTCSR = _BV(WDIE) | _BV(WDE) | _BV(WDP2) | _BV(WDP1) | _BV(WDP0);  /* 2 s */
+    }
+}
+
+/**
+ * @brief Gets the record of the watchdog or brown-out reset before this start, once.
+ * @param record Where the record is stored.
+ * @return True if the last reset was a crash, false otherwise.
+ */
+bool Watchdog_GetCrash(CrashRecord &record) {
+    if (!crashPending) {
+        return false;
+    }
+    record = lastCrash;
+    crashPending = false;
+    return true;
+}
+
+/**
+ * @brief Marks a task as running, for the crash record.
+ * @param task The task.
+ */
+void Watchdog_TaskBegin(WatchdogTask_t task) {
+    liveRecord.task = task;
+}
+
+/**
+ * @brief Checks a task in, the watchdog is fed once all of WDT_REQUIRED_TASKS have checked in.
+ * The end of setup feeds it directly.
+ * @param task The task.
+ */
+void Watchdog_TaskEnd(WatchdogTask_t task) {
+    checkedIn |= (1U << task);
+    liveRecord.task = WDT_TASK_SCHEDULER;
+    if (task == WDT_TASK_SETUP) {
+        wdt_reset();
+    }
+}
+
+/**
+ * @brief Counts a loop iteration and feeds the watchdog if every required task checked in since
+ * the last feed. Must be called once per loop by the scheduler, so a task that stops running or
+ * never returns lets the watchdog expire.
+ */
+void Watchdog_Feed() {
+    liveRecord.loopCount++;
+    if ((checkedIn & WDT_REQUIRED_TASKS) == WDT_REQUIRED_TASKS) {
+        wdt_reset();
+        checkedIn = 0;
+    }
+}
+
+/**
+ * @brief Gets the name of a task for the log.
+ * @param task The WatchdogTask_t.
+ * @return The name.
+ */
+const char *Watchdog_GetTaskName(uint8_t task) {
+    switch (task) {
+        case WDT_TASK_SCHEDULER: return "scheduler";
+        case WDT_TASK_SETUP:     return "setup";
+        case WDT_TASK_POLL:      return "poll";
+        case WDT_TASK_CONTROL:   return "control";
+        case WDT_TASK_UI:        return "ui";
+        case WDT_TASK_BUS:       return "bus";
+        case WDT_TASK_NVM:       return "nvm";
+        default:                 return "unknown";
+    }
+}
+
+/**
+ * @brief Watchdog interrupt, the return address on the stack is the interrupted instruction.
+ * Naked as it never returns: nothing is saved, only the zero register the compiled code relies on is cleared.
+ */
+ISR(WDT_vect, ISR_NAKED) {
+    asm volatile ("clr __zero_reg__");
+    const uint8_t *sp = (const uint8_t *)(uintptr_t)SP;
+    OnWatchdogTimeout(((uint16_t)sp[1] << 8) | sp[2]);
+}
@@ -2,14 +2,41 @@
 #include "Sensors.h"
 #include "Actuators.h"
 #include "UserInterface.h"
+#include "ButtonEvents.h"
+#include "PumpStats.h"
+#include "WellRecovery.h"
+#include "DemandBoost.h"
+#include "PumpControl.h"
+#include "SensorPlausibility.h"
+#include "PumpSchedule.h"
+#include "PinChangeInt.h"
+#include "FlowMeter.h"
+#include "ModbusRtu.h"
+#include "ConfigLink.h"
+#include "ModbusUart.h"
+#include "PumpCoordinator.h"
+#include "IoExpander.h"
+#include "PowerSave.h"
+#include "Bench.h"
+#include "EventTrace.h"
+#include "Watchdog.h"
+#include "LoopRate.h"
+#include "BlackBox.h"
+#include "DemandProfile.h"
 #include "RealTimeClock.h"
 #include "AT24C32_nvm.h"
 #include "utilities.h"
 #include <Wire.h>
+#include <util/atomic.h>
 
-#define POLL_ALL_SENSORS_TIMEOUT (50)
-#define CONTROL_PUMPS_TIMEOUT    (200)
-#define DISPLAY_UPDATE_TIMEOUT   (400)
+/* LCD backpack, RTC and EEPROM share the bus. PCF8574 is specified for 100 kHz but the
+ * common LCD backpacks work at 400 kHz; lower this if the display shows garbage */
+#define I2C_BUS_CLOCK_HZ (400000UL)
+/* A transaction held this long by a stuck device is aborted and the bus reset, instead of hanging the loop */
+#define I2C_TIMEOUT_US   (25000UL)
+
+/* LCD backlight turned off after this long without a button press, 0 keeps it always on */
+#define LCD_BACKLIGHT_TIMEOUT_MS (60000UL)
 
 /* Navigation user push buttons */
 #define DI_PB_UP    (2)
@@ -27,12 +54,51 @@
 #define DI_WELL_SENSOR    (10)
 #define DI_CISTERN_SENSOR (11)
 
+/* DS3231 INT/SQW output, active low open drain */
+#define DI_RTC_ALARM (12)
+
+/* Hall-effect flow meter on the pumps outlet, D13 needs the on-board LED removed or an external pull-up.
+ * Without a meter installed the no flow protection must stay disabled */
+#define DI_FLOW_METER        (13)
+#define FLOW_METER_INSTALLED (false)
+
+/* Analog sensors on the ADC only pins, sampled in the background */
+#define AI_PUMP_CURRENT  (A6)   /* ACS712-20A on the common supply of the pumps */
+#define AI_CISTERN_LEVEL (A7)   /* 0.5-4.5 V pressure transducer at the bottom of the cistern */
+
+#define CURRENT_SENSOR_MV_PER_A (100UL)   /* ACS712-20A sensitivity */
+#define LEVEL_SENSOR_EMPTY_MV   (500U)    /* Transducer output with the cistern empty */
+#define LEVEL_SENSOR_FULL_MV    (4500U)   /* Transducer output with the cistern full */
+#define LEVEL_SENSOR_INSTALLED  (false)   /* The cistern top-ups ahead of demand peaks need the transducer */
+#define LEVEL_SENSOR_MARGIN_MV  (250U)    /* Readings further out of the output range are a disconnected or shorted transducer */
+
+/* I2C I/O expander for more sensors and actuators, whose pins are IO_EXP_PIN(0, bit) and are used like
+ * native ones. Its INT output can go to a free pin change interrupt pin, otherwise it is read every poll */
+#define IO_EXPANDER_INSTALLED (false)
+#define IO_EXPANDER_TYPE      (IO_EXPANDER_MCP23017)
+#define IO_EXPANDER_I2C_ADDR  (0x20)
+#define IO_EXPANDER_INT_PIN   (IO_EXPANDER_NO_INT_PIN)
+
 #define DO_LED_AUTO   (14)
 #define DO_LED_MANUAL (15)
 
 #define DO_PUMP_1 (16)
 #define DO_PUMP_2 (17)
 
+/* RS-485 transceiver on pins 0/1 for the Modbus slave or the pump coordination bus.
+ * No pin is left for DE/RE, so the transceiver module must switch direction by itself */
+#define RS485_DE_PIN      (MODBUS_UART_NO_DE_PIN)
+
+/* Modbus RTU slave, see MODBUS_ENABLED */
+#define MODBUS_SLAVE_ADDR (1)
+#define MODBUS_BAUD       (115200UL)
+
+/* Pump coordination bus, see COORD_ENABLED. Every board on the bus needs its own node id */
+#ifndef COORD_NODE_ID
+#define COORD_NODE_ID     (1)
+#endif
+#define COORD_BAUD        (19200UL)
+
 #define SENSOR_FULL_LEVEL  (false) 
 #define SENSOR_EMPTY_LEVEL (true)
 
@@ -46,6 +112,13 @@ DigitalSensor pbMode(DI_PB_MODE);
 DigitalSensor pbPumpSel(DI_PB_PUMP_SEL);
 DigitalSensor wellSensor(DI_WELL_SENSOR);
 DigitalSensor cisternSensor(DI_CISTERN_SENSOR);
+AnalogSensor pumpCurrentSensor(AI_PUMP_CURRENT);
+AnalogSensor cisternLevelSensor(AI_CISTERN_LEVEL);
+
+/* Navigation buttons handled through the button events queue, indexed by ButtonId_t */
+DigitalSensor *const navButtons[] = { &pbUp, &pbDown, &pbLeft, &pbRight, &pbOk, &pbEsc };
+ButtonEvents buttonEvents(navButtons, sizeof(navButtons) / sizeof(navButtons[0]),
+                          (1 << BTN_UP) | (1 << BTN_DOWN) | (1 << BTN_LEFT) | (1 << BTN_RIGHT));
 
 DigitalActuator ledAuto(DO_LED_AUTO);
 DigitalActuator ledManual(DO_LED_MANUAL);
@@ -54,20 +127,59 @@ DigitalActuator pump2(DO_PUMP_2);
 
 LCD_Display lcdDisplay(LCD_DISPLAY_I2C_ADDR, LCD_DISPLAY_COLS, LCD_DISPLAY_ROWS);
 
+UiRender uiRender;
+
+PumpStats pumpStats;
+
+WellRecovery wellRecovery;
+
+DemandBoost demandBoost;
+
+PumpControl pumpControl(wellRecovery, demandBoost, pumpStats);
+
+SensorPlausibility plausibility;
+
 RealTimeClock rtc_datetime;
 
+PumpSchedule pumpSchedule;
+
+FlowMeter flowMeter(DI_FLOW_METER);
+
+EventTrace eventTrace;
+
+LoopRate loopRate;
+
+BlackBox blackBox;
+
+DemandProfile demandProfile;
+
+#if COORD_ENABLED
+PumpCoordinator pumpCoordinator(COORD_NODE_ID);
+#endif
+volatile bool rtcAlarmFired = false;
+bool scheduleSavePending = false;
+bool scheduleAllowed = true;  /* Pumping allowed by the schedule, updated every control tick */
+bool backlightOn = true;
+uint32_t lastButtonMs = 0;
+
 PumpCycleTime PumpCyclesTimes[] = {
     {0, 0, 0}, /* Pump 1 cycle time (default) */
     {0, 0, 0}  /* Pump 2 cycle time (default) */
 };
 
+CtrlModeSel_t currentCtrlMode = CTRL_AUTO_BY_SENSORS;
+
+/* Pump cycle times in milliseconds, precomputed from PumpCyclesTimes when they change. 0 = not set */
+uint32_t PumpCycleBudgetsMs[2] = {0, 0};
+bool pumpCyclesSavePending = false;
+
 /**
  * @brief Saves the pump cycle times to EEPROM.
  * This function stores the configured pump cycle times in EEPROM for persistence across resets.
  * @param cycles An array of PumpCycleTime objects representing the pump cycle times.
  */
 void SavePumpCyclesToEEPROM(const PumpCycleTime cycles[2]) {
-    I2C_EEPROM_WriteBytes(AT24C32_START_ADDR, (const uint8_t*)cycles, sizeof(PumpCycleTime) * 2);
+    I2C_EEPROM_WriteBytes(NVM_PUMP_CYCLES_ADDR, (const uint8_t*)cycles, sizeof(PumpCycleTime) * 2);
     LogSerialn("Pump cycles saved to AT24C32", true);
     LogSerialn("Pump 1 Cycle: " + String(cycles[0].hour) + ":" + String(cycles[0].minute) + ":" + String(cycles[0].second), true);
     LogSerialn("Pump 2 Cycle: " + String(cycles[1].hour) + ":" + String(cycles[1].minute) + ":" + String(cycles[1].second), true);
@@ -79,7 +191,7 @@ void SavePumpCyclesToEEPROM(const PumpCycleTime cycles[2]) {
  * @param cycles An array of PumpCycleTime objects to store the loaded pump cycle times.
  */
 void LoadPumpCyclesFromEEPROM(PumpCycleTime cycles[2]) {
-    I2C_EEPROM_ReadBytes(AT24C32_START_ADDR, (uint8_t*)cycles, sizeof(PumpCycleTime) * 2);
+    I2C_EEPROM_ReadBytes(NVM_PUMP_CYCLES_ADDR, (uint8_t*)cycles, sizeof(PumpCycleTime) * 2);
 
     // Check for uninitialized EEPROM (all bytes 0xFF)
     bool invalid = true;
@@ -102,12 +214,126 @@ void LoadPumpCyclesFromEEPROM(PumpCycleTime cycles[2]) {
     LogSerialn("Pump 2 Cycle: " + String(cycles[1].hour) + ":" + String(cycles[1].minute) + ":" + String(cycles[1].second), true);
 }
 
+/**
+ * @brief Saves the record of a crash before this start to EEPROM and reports the last crash recorded.
+ * The EEPROM keeps the last record and the number of crashes.
+ */
+void ReportCrashRecord(void) {
+    struct {
+        CrashRecord record;
+        uint16_t count;
+    } stored;
+    I2C_EEPROM_ReadBytes(NVM_CRASH_ADDR, (uint8_t*)&stored, sizeof(stored));
+    bool recorded = (stored.count != 0xFFFF);
+
+    CrashRecord crash;
+    if (Watchdog_GetCrash(crash)) {
+        stored.record = crash;
+        stored.count = recorded ? stored.count + 1 : 1;
+        recorded = true;
+        I2C_EEPROM_WriteBytes(NVM_CRASH_ADDR, (const uint8_t*)&stored, sizeof(stored));
+        LogSerialn(String((crash.cause == CRASH_CAUSE_BROWNOUT) ? "Brown-out" : "Watchdog") + " reset, record saved to AT24C32", true);
+    }
+    if (recorded) {
+        LogSerialn("Crashes: " + String(stored.count) + ", last: " +
+                   ((stored.record.cause == CRASH_CAUSE_BROWNOUT) ? "brown-out" : "watchdog") +
+                   " in task " + Watchdog_GetTaskName(stored.record.task) +
+                   " at pc 0x" + String(stored.record.pc, HEX) +
+                   " after " + String(stored.record.loopCount) + " loops", true);
+    }
+}
+
+/**
+ * @brief Switches the pumps off, called from the watchdog interrupt before the reset.
+ * Native outputs change at once, expander outputs are written off by IoExpander_Begin() after the reset.
+ */
+void PumpsSafeState(void) {
+    pump1.deactivate();
+    pump2.deactivate();
+}
+
+/**
+ * @brief Precomputes the cycle time budgets used by the timer mode from the configured pump cycle times.
+ * Must be called every time PumpCyclesTimes changes.
+ * @param persist True to save the cycle times to EEPROM from the main loop, outside the control tick.
+ */
+void ApplyPumpCycles(bool persist) {
+    for (uint8_t i = 0; i < 2; i++) {
+        PumpCycleBudgetsMs[i] = (PumpCyclesTimes[i].hour * 3600UL +
+                                 PumpCyclesTimes[i].minute * 60UL +
+                                 PumpCyclesTimes[i].second) * 1000UL;
+    }
+    if (persist) {
+        pumpCyclesSavePending = true;
+    }
+}
+
+/**
+ * @brief Pin change callback of the RTC INT/SQW pin, flags the alarm when the pin goes low.
+ * @param level The new level of the pin.
+ */
+void OnRtcAlarmPinChange(bool level) {
+    if (!level) {
+        rtcAlarmFired = true;
+    }
+}
+
+/**
+ * @brief Recomputes the pumping schedule when the RTC alarm fired or a recompute was requested,
+ * and programs the RTC alarm at the next window transition. Otherwise it costs a flag check.
+ * @param nowMs Current time in milliseconds.
+ */
+void UpdateSchedule(uint32_t nowMs) {
+    bool alarmFired;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        alarmFired = rtcAlarmFired;
+        rtcAlarmFired = false;
+    }
+    if (!alarmFired && !pumpSchedule.isRecomputeDue(nowMs)) {
+        return;
+    }
+
+    rtc_datetime.ClearAlarm1();
+    DateTime nextTransition;
+    if (pumpSchedule.Recompute(rtc_datetime.GetCurrentDateTime(), nowMs, nextTransition)) {
+        rtc_datetime.SetAlarm1(nextTransition);
+    }
+}
+
+/**
+ * @brief Turns the LCD backlight on and restarts its inactivity timeout, called on every button press.
+ * @param nowMs Current time in milliseconds.
+ * @return True if the backlight was off, the press only woke the display.
+ */
+bool WakeBacklight(uint32_t nowMs) {
+    lastButtonMs = nowMs;
+    if (backlightOn) {
+        return false;
+    }
+    backlightOn = true;
+    lcdDisplay.setBacklight(true);
+    return true;
+}
+
+/**
+ * @brief Turns the LCD backlight off once no button was pressed for LCD_BACKLIGHT_TIMEOUT_MS.
+ * @param nowMs Current time in milliseconds.
+ */
+void UpdateBacklight(uint32_t nowMs) {
+    if (backlightOn && (LCD_BACKLIGHT_TIMEOUT_MS > 0) && (nowMs - lastButtonMs >= LCD_BACKLIGHT_TIMEOUT_MS)) {
+        backlightOn = false;
+        lcdDisplay.setBacklight(false);
+    }
+}
+
 /**
  * @brief Polls all sensors to update their states.
  * This function reads the state of each sensor and updates their internal state.
+ * The expander inputs are read first, one transaction per device, so their sensors poll like native ones.
  */
 void PollAllSensors(void) 
 {
+    IoExpander_Update();
     pbUp.PollSensorState();
     pbDown.PollSensorState();
     pbLeft.PollSensorState();
@@ -118,342 +344,242 @@ void PollAllSensors(void)
     pbPumpSel.PollSensorState();
     wellSensor.PollSensorState();
     cisternSensor.PollSensorState();
+    pumpCurrentSensor.PollSensorState();
+    cisternLevelSensor.PollSensorState();
 }
 
 /**
- * @brief Controls the selection of control modes based on push button input.
- * This function manages the control mode selection logic, including toggling between
- * manual and automatic modes based on sensor states.
- * @param Ctrlmode The current control mode selected by the user.
- * @return The updated control mode after processing the input.
+ * @brief Gets the pump outputs, as traced by the event latency trace.
+ * @return Bit 0 set if pump 1 is active, bit 1 if pump 2 is active.
  */
-CtrlModeSel_t ControlModeSelection(CtrlModeSel_t Ctrlmode) {
-    static bool prevPbModeState = false;
-    static CtrlModeSel_t prevAutoMode = CTRL_AUTO_BY_SENSORS;
-    CtrlModeSel_t retCtrlMode = Ctrlmode;
-    bool currPbModeState = pbMode.isSensorActive();
-
-    /** If input is AUTO_BY_SENSORS, always return AUTO_BY_SENSORS */
-    if (Ctrlmode == CTRL_AUTO_BY_SENSORS) {
-        if (prevPbModeState && !currPbModeState) {
-            prevAutoMode = CTRL_AUTO_BY_SENSORS;
-            retCtrlMode = CTRL_MODE_MANUAL;
-        } else {
-            retCtrlMode = CTRL_AUTO_BY_SENSORS;
-        }
-    } else if (Ctrlmode == CTRL_AUTO_BY_TIMER) {  /** If input is AUTO_BY_TIMER, always return AUTO_BY_TIMER */
-        if (prevPbModeState && !currPbModeState) {
-            prevAutoMode = CTRL_AUTO_BY_TIMER;
-            retCtrlMode = CTRL_MODE_MANUAL;
-        } else {
-            retCtrlMode = CTRL_AUTO_BY_TIMER;
-        }
-    } else if (Ctrlmode == CTRL_MODE_MANUAL) {  /** If input is MANUAL, allow toggling back to previous AUTO mode */
-        if (prevPbModeState && !currPbModeState) {
-            retCtrlMode = prevAutoMode;
-        } else {
-            retCtrlMode = CTRL_MODE_MANUAL;
-        }
-    }
-
-    prevPbModeState = currPbModeState;
-
-    /** Update LEDs based on control mode */
-    if ((retCtrlMode == CTRL_AUTO_BY_SENSORS) || (retCtrlMode == CTRL_AUTO_BY_TIMER)) {
-        ledAuto.activate();
-        ledManual.deactivate();
-    } else {
-        ledAuto.deactivate();
-        ledManual.activate();
-    }
-
-    return retCtrlMode;
+uint8_t GetPumpsOnMask(void)
+{
+    return (pump1.isActive() ? 0x01 : 0) | (pump2.isActive() ? 0x02 : 0);
 }
 
 /**
- * @brief Controls the pumps based on manual selection.
- * This function allows the user to manually select which pump to activate
- * using a push button. It also checks the well sensor state to ensure
- * pumps are only activated when the well is not empty.
+ * @brief Gets the snapshot of the sensor poll recorded by the black box.
+ * @return The BLACKBOX_* bits.
  */
-void CntrlPumpsByManual(void)
+uint8_t GetBlackBoxSample(void)
 {
-    static bool prevPbPumpSelState = false;
-    static ManualPumpSel_t currentPumpSel = SELECT_PUMP_NONE;
-    bool currPbPumpSelState = pbPumpSel.isSensorActive();
-    bool wellSensorState = wellSensor.isSensorActive();
-    bool cisternSensorState = cisternSensor.isSensorActive();
-
-    if(wellSensorState == SENSOR_EMPTY_LEVEL) {
-        pump1.deactivate();
-        pump2.deactivate();
-        return;  /** If well is empty, deactivate both pumps */
-    }
-
-    if(cisternSensorState == SENSOR_FULL_LEVEL) {
-        pump1.deactivate();
-        pump2.deactivate();
-        return;  /** If cistern is full, deactivate both pumps */
-    }
-    
-    /** Only allow manual pump selection if mode is not AUTO */
-    if (prevPbPumpSelState && !currPbPumpSelState) {
-        currentPumpSel = static_cast<ManualPumpSel_t>(static_cast<int>(currentPumpSel) + 1);
-        if (currentPumpSel > SELECT_PUMP_BOTH) {
-            currentPumpSel = SELECT_PUMP_NONE;
-        }
-    }
-    prevPbPumpSelState = currPbPumpSelState;
-
-    /** Activate selected pump */
-    if(currentPumpSel == SELECT_PUMP_1 ) {
-        pump1.activate();
-        pump2.deactivate();
-    } else if(currentPumpSel == SELECT_PUMP_2 ) {
-        pump1.deactivate();
-        pump2.activate();
-    } else if(currentPumpSel == SELECT_PUMP_BOTH) {
-        pump1.activate();
-        pump2.activate();
-    } else {
-        pump1.deactivate();
-        pump2.deactivate();
-    }
+    uint8_t sample = 0;
+    if (wellSensor.isSensorActive() == SENSOR_EMPTY_LEVEL) sample |= BLACKBOX_WELL_EMPTY;
+    if (cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL) sample |= BLACKBOX_CISTERN_EMPTY;
+    if (pump1.isActive()) sample |= BLACKBOX_PUMP1_ON;
+    if (pump2.isActive()) sample |= BLACKBOX_PUMP2_ON;
+    if (plausibility.hasFault()) sample |= BLACKBOX_FAULT;
+    if (FLOW_METER_INSTALLED && flowMeter.isNoFlow()) sample |= BLACKBOX_NO_FLOW;
+    if (currentCtrlMode == CTRL_MODE_MANUAL) sample |= BLACKBOX_MANUAL_MODE;
+    if (pbMode.isSensorActive() || pbPumpSel.isSensorActive()) sample |= BLACKBOX_BUTTON;
+    return sample;
 }
 
 /**
- * @brief Controls the pumps based on sensor states.
- * This function manages the operation of pumps based on the states of well and cistern sensors.
- * It alternates between two pumps when filling the cistern and pauses operation if the well is empty.
+ * @brief Triggers the black box when a sensor fault is latched or a pump runs dry.
+ * @param nowMs Current time in milliseconds.
  */
-void CntrlPumpsBySensors(void)
+void UpdateBlackBoxTriggers(uint32_t nowMs)
 {
-    /** Static variables to keep track of pump alternation and state */
-    static bool usePump1 = true;
-    static bool waitingForFull = false;
-    static bool lastCisternWasFull = true;
-    static bool pumpPausedByWell = false;
-
-    bool wellSensorState = wellSensor.isSensorActive();
-    bool cisternSensorState = cisternSensor.isSensorActive();
-
-    /** If cistern is empty and we are not already waiting for it to fill */
-    if ((cisternSensorState == SENSOR_EMPTY_LEVEL) && lastCisternWasFull) {
-        waitingForFull = true;
-        lastCisternWasFull = false;
-        pumpPausedByWell = false;
-        /** Activate the selected pump */
-        if (usePump1) {
-            pump1.activate();
-            pump2.deactivate();
-        } else {
-            pump1.deactivate();
-            pump2.activate();
-        }
-    }
-
-    /** If we are waiting for cistern to fill and it is now full */
-    if (waitingForFull && (cisternSensorState == SENSOR_FULL_LEVEL)) {
-        pump1.deactivate();
-        pump2.deactivate();
-        waitingForFull = false;
-        lastCisternWasFull = true;
-        pumpPausedByWell = false;
-        /** Alternate the pump for next cycle */
-        usePump1 = !usePump1;
-    }
+    static bool prevFault = false;
+    static bool prevNoFlow = false;
+    bool fault = plausibility.hasFault();
+    bool noFlow = FLOW_METER_INSTALLED && flowMeter.isNoFlow();
 
-    /** If well is empty while waiting for cistern to fill, pause the current pump */
-    if (waitingForFull && (wellSensorState == SENSOR_EMPTY_LEVEL)) {
-        pump1.deactivate();
-        pump2.deactivate();
-        pumpPausedByWell = true;
-        return;
+    if (noFlow && !prevNoFlow) {
+        blackBox.Trigger(BLACKBOX_CAUSE_DRY_RUN, nowMs);
+    } else if (fault && !prevFault) {
+        blackBox.Trigger(BLACKBOX_CAUSE_FAULT, nowMs);
     }
+    prevFault = fault;
+    prevNoFlow = noFlow;
+}
 
-    /** If well becomes full again and we are still waiting for cistern, resume the current pump */
-    if (waitingForFull && pumpPausedByWell && (wellSensorState == SENSOR_FULL_LEVEL)) {
-        if (usePump1) {
-            pump1.activate();
-            pump2.deactivate();
-        } else {
-            pump1.deactivate();
-            pump2.activate();
+/**
+ * @brief Logs the event traces closed by the last control tick, with the latency histogram of their event.
+ */
+void LogEventTraces(void)
+{
+    TraceRecord record;
+    while (eventTrace.TakeCompleted(record)) {
+        String hist;
+        for (uint8_t bin = 0; bin < TRACE_HIST_BINS; bin++) {
+            hist += String(eventTrace.getBinCount(record.event, bin)) + ((bin < TRACE_HIST_BINS - 1) ? "," : "");
         }
-        pumpPausedByWell = false;
-    }
-
-    /** If not waiting for cistern to fill, keep both pumps off */
-    if (!waitingForFull) {
-        pump1.deactivate();
-        pump2.deactivate();
+        LogSerialn("Trace #" + String(record.seq) + " " + EventTrace::getEventName(record.event) + " to pumps off " +
+                   String(record.latencyMs) + " ms, max " + String(eventTrace.getMaxMs(record.event)) + " ms, unanswered " +
+                   String(eventTrace.getUnanswered(record.event)) + ", hist " + hist, true);
     }
 }
 
 /**
- * @brief Controls the pumps based on a timer. This function manages the operation of pumps based on their timer configured values.
- * It alternates between two pumps when filling the cistern and pauses operation if the well is empty.
- * The alternating pump cycle times are defined in the PumpCyclesTimes array compared with the current time.
- * The pumps will be active for the defined cycle time and then switch to the other pump.
- * If the well is empty, both pumps will be deactivated.
+ * @brief Gets the current drawn by the pumps, from the RMS voltage of the AC current sensor.
+ * @return The current in mA.
  */
-void CntrlPumpsByTimer(void)
+uint16_t GetPumpCurrentMa(void)
 {
-    static bool usePump1 = true;
-    static DateTime lastSwitchDateTime = DateTime(0, 0, 0, 0, 0, 0);
-    static bool pumpPausedByWell = false;
-    static bool waitingForFull = false;
-    static bool lastCisternWasFull = true;
-
-    bool wellSensorState = wellSensor.isSensorActive();
-    bool cisternSensorState = cisternSensor.isSensorActive();
-
-    /** Get current date and time from RTC */
-    DateTime now = rtc_datetime.GetCurrentDateTime();
-
-    /** Check if both pump cycle times are set (not default) */
-    bool pump1CycleValid = (PumpCyclesTimes[0].hour != 0) || (PumpCyclesTimes[0].minute != 0) || (PumpCyclesTimes[0].second != 0);
-    bool pump2CycleValid = (PumpCyclesTimes[1].hour != 0) || (PumpCyclesTimes[1].minute != 0) || (PumpCyclesTimes[1].second != 0);
+    return (uint16_t)((uint32_t)pumpCurrentSensor.getRmsMilliVolts() * 1000UL / CURRENT_SENSOR_MV_PER_A);
+}
 
-    static PumpCycleTime prevPumpCyclesTimes[2] = { {0,0,0}, {0,0,0} };
-    if (pump1CycleValid && pump2CycleValid) {
-        /* Check if either pump's cycle time has changed */ 
-        if (memcmp(&PumpCyclesTimes, &prevPumpCyclesTimes, sizeof(PumpCyclesTimes)) != 0) {
-            SavePumpCyclesToEEPROM(PumpCyclesTimes);
-            memcpy(&prevPumpCyclesTimes, &PumpCyclesTimes, sizeof(PumpCyclesTimes));
-        }
-    }
+/**
+ * @brief Gets the cistern level from the pressure transducer voltage.
+ * @return The level in percent, 0 to 100.
+ */
+uint8_t GetCisternLevelPercent(void)
+{
+    uint16_t mv = constrain(cisternLevelSensor.getMilliVolts(), LEVEL_SENSOR_EMPTY_MV, LEVEL_SENSOR_FULL_MV);
+    return (uint8_t)((uint32_t)(mv - LEVEL_SENSOR_EMPTY_MV) * 100UL / (LEVEL_SENSOR_FULL_MV - LEVEL_SENSOR_EMPTY_MV));
+}
 
-    /** If either pump cycle time is default, do not start alternation, keep both pumps off and reset state */
-    if (!pump1CycleValid || !pump2CycleValid) {
-        pump1.deactivate();
-        pump2.deactivate();
-        waitingForFull = false;
-        lastCisternWasFull = true;
-        pumpPausedByWell = false;
-        return;
+/**
+ * @brief Checks if the cistern level can be used to control the pumps.
+ * @return True if the transducer is installed, its reading is settled and within its output range.
+ */
+bool IsCisternLevelValid(void)
+{
+    if (!LEVEL_SENSOR_INSTALLED || !cisternLevelSensor.isReady()) {
+        return false;
     }
+    uint16_t mv = cisternLevelSensor.getMilliVolts();
+    return (mv + LEVEL_SENSOR_MARGIN_MV >= LEVEL_SENSOR_EMPTY_MV) && (mv <= LEVEL_SENSOR_FULL_MV + LEVEL_SENSOR_MARGIN_MV);
+}
 
-    /** Start cycling when cistern becomes empty */
-    if ((cisternSensorState == SENSOR_EMPTY_LEVEL) && lastCisternWasFull) {
-        waitingForFull = true;
-        lastCisternWasFull = false;
-        pumpPausedByWell = false;
-        lastSwitchDateTime = now;
-        /** Activate the selected pump */
-        if (usePump1) {
-            pump1.activate();
-            pump2.deactivate();
-        } else {
-            pump1.deactivate();
-            pump2.activate();
-        }
-    }
+/**
+ * @brief Feeds the demand profile with the cistern state, and once a minute with the RTC hour and the level.
+ * @param nowMs Current time in milliseconds.
+ */
+void UpdateDemandProfile(uint32_t nowMs)
+{
+    static uint32_t lastMinuteMs = 0;
+    static bool started = false;
 
-    /** Stop cycling when cistern becomes full */
-    if (waitingForFull && (cisternSensorState == SENSOR_FULL_LEVEL)) {
-        pump1.deactivate();
-        pump2.deactivate();
-        waitingForFull = false;
-        lastCisternWasFull = true;
-        pumpPausedByWell = false;
+    demandProfile.Update(cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL, nowMs);
+    if (started && (nowMs - lastMinuteMs < 60000UL)) {
         return;
     }
+    started = true;
+    lastMinuteMs = nowMs;
+    demandProfile.MinuteTick(rtc_datetime.GetCurrentDateTime().hour(), pump1.isActive() || pump2.isActive(),
+                             IsCisternLevelValid(), GetCisternLevelPercent(), pumpSchedule.isEnabled());
+}
 
-    /** Pause pumps if well is empty */
-    if (waitingForFull && (wellSensorState == SENSOR_EMPTY_LEVEL)) {
-        pump1.deactivate();
-        pump2.deactivate();
-        pumpPausedByWell = true;
-        return;
+/**
+ * @brief Updates the mode LEDs.
+ * @param mode The current control mode.
+ */
+void UpdateModeLeds(CtrlModeSel_t mode) {
+    if ((mode == CTRL_AUTO_BY_SENSORS) || (mode == CTRL_AUTO_BY_TIMER)) {
+        ledAuto.activate();
+        ledManual.deactivate();
+    } else {
+        ledAuto.deactivate();
+        ledManual.activate();
     }
+}
 
-    /** Resume pumps if well becomes full again */
-    if (waitingForFull && pumpPausedByWell && (wellSensorState == SENSOR_FULL_LEVEL)) {
-        lastSwitchDateTime = now; /** Reset timer to avoid immediate switch */
-        pumpPausedByWell = false;
-        /** Reactivate the current pump */
-        if (usePump1) {
-            pump1.activate();
-            pump2.deactivate();
-        } else {
-            pump1.deactivate();
-            pump2.activate();
-        }
-    }
+/**
+ * @brief Updates the displayed time in the UI model.
+ * The RTC seconds change once per second, so after a change has been seen the RTC is not read
+ * again until one second later instead of on every display frame.
+ * @param displayTime Reference to the time shown on the display, updated when the RTC is read.
+ * @param forceRead True to read the RTC regardless of when the last change was seen.
+ */
+void UpdateDisplayTime(DateTime &displayTime, bool forceRead) {
+    static uint32_t lastSecondChangeMillis = 0;
+    static bool secondChangeSeen = false;
+    uint32_t nowMillis = millis();
 
-    /** If not in a cycle, keep both pumps off */
-    if (!waitingForFull) {
-        pump1.deactivate();
-        pump2.deactivate();
+    if (!forceRead && secondChangeSeen && (nowMillis - lastSecondChangeMillis < 1000)) {
         return;
     }
 
-    /** Calculate elapsed seconds since last switch */
-    TimeSpan elapsed = now - lastSwitchDateTime;
-    uint32_t elapsedSeconds = elapsed.totalseconds();
-
-    /** Get configured cycle time for the current pump in seconds */
-    uint32_t cycleSeconds = PumpCyclesTimes[usePump1 ? 0 : 1].hour * 3600UL +
-                            PumpCyclesTimes[usePump1 ? 0 : 1].minute * 60UL +
-                            PumpCyclesTimes[usePump1 ? 0 : 1].second;
-
-    /** Check if it's time to switch pumps */
-    if (elapsedSeconds >= cycleSeconds && cycleSeconds > 0) {
-        usePump1 = !usePump1;  /** Alternate the pump */
-        lastSwitchDateTime = now;
-        /** Activate the new selected pump */
-        if (usePump1) {
-            pump1.activate();
-            pump2.deactivate();
-        } else {
-            pump1.deactivate();
-            pump2.activate();
-        }
+    DateTime now = rtc_datetime.GetCurrentDateTime();
+    if (forceRead || (now.second() != displayTime.second())) {
+        secondChangeSeen = !forceRead;
+        lastSecondChangeMillis = nowMillis;
+        uiRender.Invalidate(UI_DEP_TIME);
     }
+    displayTime = now;
 }
 
 /**
  * @brief Displays the current screen based on the selected mode.
  * This function manages the display of different screens based on user input and the current control mode.
  * It handles the main screen, option settings, control mode selection, date/time settings, and pump cycle settings.
+ * User input is handled on every call, the LCD is only written inside a render frame and only for the
+ * model values of the current screen that changed.
  * @param currCtrlMode The current control mode selected by the user.
+ * @param button The navigation button pressed since the last call, BTN_NONE to only refresh the screen.
  */
-void ShowDisplayMenus(CtrlModeSel_t &currCtrlMode) {
+void ShowDisplayMenus(CtrlModeSel_t &currCtrlMode, uint8_t button) {
     static ScreenMode_t currentScreenMode = SCREEN_MAIN;
     static ScreenMode_t lastScreenMode = SCREEN_MAIN;
+    static DateTime displayTime;
+    static bool firstFrame = true;
 
-    bool pbUpState = pbUp.isSensorActive();
-    bool pbDownState = pbDown.isSensorActive();
-    bool pbLeftState = pbLeft.isSensorActive();
-    bool pbRightState = pbRight.isSensorActive();
-    bool pbOkState = pbOk.isSensorActive();
-    bool pbEscState = pbEsc.isSensorActive();
+    bool pbUpState = (button == BTN_UP);
+    bool pbDownState = (button == BTN_DOWN);
+    bool pbLeftState = (button == BTN_LEFT);
+    bool pbRightState = (button == BTN_RIGHT);
+    bool pbOkState = (button == BTN_OK);
+    bool pbEscState = (button == BTN_ESC);
 
-    /* Clear LCD only when changing screens */ 
-    if (currentScreenMode != lastScreenMode) {
-        lcdDisplay.clearScreen();
-        lastScreenMode = currentScreenMode;
+    if (uiRender.isFrameOpen()) {
+        bool screenChanged = firstFrame || (currentScreenMode != lastScreenMode);
+
+        /* Screens always write whole rows, so a new screen is drawn over the old one without clearing the LCD */
+        if (screenChanged) {
+            uiRender.InvalidateAll();
+            lastScreenMode = currentScreenMode;
+            firstFrame = false;
+        }
+
+        /* Only read the RTC while the current screen shows the time */
+        if (ScreenDependencies(currentScreenMode) & UI_DEP_BIT(UI_DEP_TIME)) {
+            UpdateDisplayTime(displayTime, screenChanged);
+        }
     }
 
     switch(currentScreenMode) {
         case SCREEN_MAIN:
-            currentScreenMode = DisplayMain(pbOkState, currCtrlMode, lcdDisplay, rtc_datetime.getFormattedDateTime());
+            currentScreenMode = DisplayMain(pbOkState, currCtrlMode, lcdDisplay, uiRender, displayTime,
+                                            (pumpStats.isAnyAlarm() ? 0x80 : 0) | plausibility.getFaults(),
+                                            plausibility.getFaultText());
             break;
         case SCREEN_MAIN_CFGS:
-            currentScreenMode = DisplayMainCfgs(pbOkState, pbEscState, pbUpState, pbDownState, lcdDisplay);
+            currentScreenMode = DisplayMainCfgs(pbOkState, pbEscState, pbUpState, pbDownState, lcdDisplay, uiRender);
             break;
         case SCREEN_CFG_CTRL_TYPE:
-            currentScreenMode = DisplayCfgControlTypes(pbOkState, pbEscState, pbUpState, pbDownState, currCtrlMode, lcdDisplay);
+            currentScreenMode = DisplayCfgControlTypes(pbOkState, pbEscState, pbUpState, pbDownState, currCtrlMode, lcdDisplay, uiRender);
             break;
         case SCREEN_CFG_RTC:
-            currentScreenMode = DisplayCfgRtc(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, lcdDisplay, rtc_datetime);
+            currentScreenMode = DisplayCfgRtc(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, lcdDisplay, uiRender, rtc_datetime);
+            if (pbOkState) {
+                pumpSchedule.RequestRecompute();
+            }
             break;
         case SCREEN_CFG_PUMP1_CYCLE:
-            currentScreenMode = DisplayCfgPump1Cycle(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, PumpCyclesTimes, lcdDisplay);
+            currentScreenMode = DisplayCfgPump1Cycle(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, PumpCyclesTimes, lcdDisplay, uiRender);
+            if (pbOkState) {
+                ApplyPumpCycles(true);
+            }
             break;
         case SCREEN_CFG_PUMP2_CYCLE:
-            currentScreenMode = DisplayCfgPump2Cycle(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, PumpCyclesTimes, lcdDisplay);
+            currentScreenMode = DisplayCfgPump2Cycle(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, PumpCyclesTimes, lcdDisplay, uiRender);
+            if (pbOkState) {
+                ApplyPumpCycles(true);
+            }
+            break;
+        case SCREEN_PUMP_STATS:
+            currentScreenMode = DisplayPumpStats(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, pumpStats, flowMeter,
+                                                 GetPumpCurrentMa(), GetCisternLevelPercent(),
+                                                 PowerSave_GetAwakePermille(), PowerSave_GetAverageCurrentX10Ma(), lcdDisplay, uiRender);
+            break;
+        case SCREEN_CFG_SCHEDULE:
+            currentScreenMode = DisplayCfgSchedule(pbOkState, pbEscState, pbUpState, pbDownState, pbLeftState, pbRightState, pumpSchedule, lcdDisplay, uiRender);
+            if (pbOkState) {
+                scheduleSavePending = true;
+            }
             break;
         default:
             currentScreenMode = SCREEN_MAIN;
@@ -461,45 +587,554 @@ void ShowDisplayMenus(CtrlModeSel_t &currCtrlMode) {
     }
 }
 
+/**
+ * @brief Drains the button events queue and forwards each press to the menus.
+ * Press and auto-repeat events act as a single button press, so holding a navigation
+ * button keeps stepping the edited value with an accelerating rate.
+ * A long press of ESC acknowledges the latched sensor faults.
+ * A press with the backlight off only turns it on, so a button pressed in the dark changes nothing.
+ * @param currCtrlMode The current control mode selected by the user.
+ */
+void ProcessButtonEvents(CtrlModeSel_t &currCtrlMode) {
+    ButtonEvent event;
+    while (buttonEvents.PopEvent(event)) {
+        if ((event.type == BTN_EVT_PRESS) && WakeBacklight(millis())) {
+            continue;
+        }
+        if ((event.type == BTN_EVT_PRESS) || (event.type == BTN_EVT_REPEAT)) {
+            ShowDisplayMenus(currCtrlMode, event.button);
+        } else if ((event.type == BTN_EVT_LONG_PRESS) && (event.button == BTN_ESC)) {
+            plausibility.ClearFaults();
+        } else if ((event.type == BTN_EVT_LONG_PRESS) && (event.button == BTN_OK)) {
+            if (blackBox.Trigger(BLACKBOX_CAUSE_MANUAL, millis())) {
+                LogSerialn("Black box capture started", true);
+            }
+        }
+    }
+}
+
+#if MODBUS_ENABLED
+/* Input registers, read only */
+enum ModbusInputReg_t {
+    MB_IN_STATUS,          /* Bit 0 well empty, 1 cistern empty, 2 pump 1 on, 3 pump 2 on, 4 boost, 5 schedule allows pumping, 6 schedule override */
+    MB_IN_FAULTS,          /* Sensor faults, bit 7 fill time alarm */
+    MB_IN_P1_FILLS,        /* Fill cycles measured */
+    MB_IN_P2_FILLS,
+    MB_IN_P1_FILL_MEAN_S,  /* Mean pumping time per fill cycle */
+    MB_IN_P2_FILL_MEAN_S,
+    MB_IN_FLOW_RATE,       /* mL/min */
+    MB_IN_P1_LITERS_HI,
+    MB_IN_P1_LITERS_LO,
+    MB_IN_P2_LITERS_HI,
+    MB_IN_P2_LITERS_LO,
+    MB_IN_CURRENT_MA,
+    MB_IN_LEVEL_PCT,
+    MB_IN_BUS_ERRORS,      /* Frames dropped by the transport */
+    MB_IN_AWAKE_PERMILLE,  /* Share of time the CPU was awake */
+    MB_IN_BOARD_X10MA,     /* Average supply current of the board, tenths of mA */
+    MB_IN_COUNT
+};
+
+/* Holding registers, read and write */
+enum ModbusHoldingReg_t {
+    MB_HOLD_CTRL_MODE,     /* CtrlModeSel_t, only the automatic modes can be written */
+    MB_HOLD_P1_CYCLE_H,
+    MB_HOLD_P1_CYCLE_M,
+    MB_HOLD_P1_CYCLE_S,
+    MB_HOLD_P2_CYCLE_H,
+    MB_HOLD_P2_CYCLE_M,
+    MB_HOLD_P2_CYCLE_S,
+    MB_HOLD_FAULT_ACK,     /* Write 1 to acknowledge the sensor faults and fill time alarms, reads 0 */
+    MB_HOLD_COUNT
+};
+
+static bool modbusCyclesWritten = false;
+
+/**
+ * @brief Reads an input register from the live controller state.
+ * @param addr The register address, a ModbusInputReg_t.
+ * @return The register value.
+ */
+uint16_t ModbusReadInput(uint16_t addr) {
+    switch (addr) {
+        case MB_IN_STATUS:
+            return ((wellSensor.isSensorActive() == SENSOR_EMPTY_LEVEL) ? 0x01 : 0) |
+                   ((cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL) ? 0x02 : 0) |
+                   (pump1.isActive() ? 0x04 : 0) |
+                   (pump2.isActive() ? 0x08 : 0) |
+                   (demandBoost.isActive() ? 0x10 : 0) |
+                   (scheduleAllowed ? 0x20 : 0) |
+                   (pumpSchedule.isOverrideActive() ? 0x40 : 0);
+        case MB_IN_FAULTS:
+            return (pumpStats.isAnyAlarm() ? 0x80 : 0) | plausibility.getFaults();
+        case MB_IN_P1_FILLS:
+        case MB_IN_P2_FILLS:
+            return pumpStats.getFillTime(addr - MB_IN_P1_FILLS).getCount();
+        case MB_IN_P1_FILL_MEAN_S:
+        case MB_IN_P2_FILL_MEAN_S:
+            return (uint16_t)min(pumpStats.getFillTime(addr - MB_IN_P1_FILL_MEAN_S).getMean(), 0xFFFFUL);
+        case MB_IN_FLOW_RATE:
+            return (uint16_t)min(flowMeter.getRateMlPerMin(), 0xFFFFUL);
+        case MB_IN_P1_LITERS_HI:
+            return flowMeter.getLiters(0) >> 16;
+        case MB_IN_P1_LITERS_LO:
+            return flowMeter.getLiters(0) & 0xFFFF;
+        case MB_IN_P2_LITERS_HI:
+            return flowMeter.getLiters(1) >> 16;
+        case MB_IN_P2_LITERS_LO:
+            return flowMeter.getLiters(1) & 0xFFFF;
+        case MB_IN_CURRENT_MA:
+            return GetPumpCurrentMa();
+        case MB_IN_LEVEL_PCT:
+            return GetCisternLevelPercent();
+        case MB_IN_BUS_ERRORS:
+            return ModbusUart_GetErrorCount();
+        case MB_IN_AWAKE_PERMILLE:
+            return PowerSave_GetAwakePermille();
+        case MB_IN_BOARD_X10MA:
+            return PowerSave_GetAverageCurrentX10Ma();
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Reads a holding register from the live configuration.
+ * @param addr The register address, a ModbusHoldingReg_t.
+ * @return The register value.
+ */
+uint16_t ModbusReadHolding(uint16_t addr) {
+    switch (addr) {
+        case MB_HOLD_CTRL_MODE:
+            return currentCtrlMode;
+        case MB_HOLD_P1_CYCLE_H:
+        case MB_HOLD_P2_CYCLE_H:
+            return PumpCyclesTimes[(addr - MB_HOLD_P1_CYCLE_H) / 3].hour;
+        case MB_HOLD_P1_CYCLE_M:
+        case MB_HOLD_P2_CYCLE_M:
+            return PumpCyclesTimes[(addr - MB_HOLD_P1_CYCLE_M) / 3].minute;
+        case MB_HOLD_P1_CYCLE_S:
+        case MB_HOLD_P2_CYCLE_S:
+            return PumpCyclesTimes[(addr - MB_HOLD_P1_CYCLE_S) / 3].second;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Checks a value before it is written to a holding register, with the limits of the configuration screens.
+ * @param addr The register address, a ModbusHoldingReg_t.
+ * @param value The value to write.
+ * @return MODBUS_EX_NONE if the value can be written, MODBUS_EX_ILLEGAL_VALUE otherwise.
+ */
+uint8_t ModbusValidateHolding(uint16_t addr, uint16_t value) {
+    bool valid;
+    switch (addr) {
+        case MB_HOLD_CTRL_MODE:
+            valid = (value == CTRL_AUTO_BY_SENSORS) || (value == CTRL_AUTO_BY_TIMER);
+            break;
+        case MB_HOLD_P1_CYCLE_H:
+        case MB_HOLD_P2_CYCLE_H:
+            valid = (value <= 23);
+            break;
+        case MB_HOLD_P1_CYCLE_M:
+        case MB_HOLD_P2_CYCLE_M:
+        case MB_HOLD_P1_CYCLE_S:
+        case MB_HOLD_P2_CYCLE_S:
+            valid = (value <= 59);
+            break;
+        case MB_HOLD_FAULT_ACK:
+            valid = (value <= 1);
+            break;
+        default:
+            valid = false;
+            break;
+    }
+    return valid ? MODBUS_EX_NONE : MODBUS_EX_ILLEGAL_VALUE;
+}
+
+/**
+ * @brief Writes a validated value to a holding register.
+ * The control mode is not persisted, same as when it is changed from the display.
+ * @param addr The register address, a ModbusHoldingReg_t.
+ * @param value The value to write.
+ */
+void ModbusWriteHolding(uint16_t addr, uint16_t value) {
+    switch (addr) {
+        case MB_HOLD_CTRL_MODE:
+            currentCtrlMode = (CtrlModeSel_t)value;
+            break;
+        case MB_HOLD_P1_CYCLE_H:
+        case MB_HOLD_P2_CYCLE_H:
+            PumpCyclesTimes[(addr - MB_HOLD_P1_CYCLE_H) / 3].hour = value;
+            modbusCyclesWritten = true;
+            break;
+        case MB_HOLD_P1_CYCLE_M:
+        case MB_HOLD_P2_CYCLE_M:
+            PumpCyclesTimes[(addr - MB_HOLD_P1_CYCLE_M) / 3].minute = value;
+            modbusCyclesWritten = true;
+            break;
+        case MB_HOLD_P1_CYCLE_S:
+        case MB_HOLD_P2_CYCLE_S:
+            PumpCyclesTimes[(addr - MB_HOLD_P1_CYCLE_S) / 3].second = value;
+            modbusCyclesWritten = true;
+            break;
+        case MB_HOLD_FAULT_ACK:
+            if (value == 1) {
+                plausibility.ClearFaults();
+                pumpStats.ClearAlarms();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Applies the pump cycle times once after a write request, so a multiple register write
+ * of h/m/s is saved to EEPROM a single time.
+ */
+void ModbusCommitWrites(void) {
+    if (modbusCyclesWritten) {
+        modbusCyclesWritten = false;
+        ApplyPumpCycles(true);
+    }
+}
+
+const ModbusRegisterMap modbusRegisters = {
+    MB_HOLD_COUNT,
+    MB_IN_COUNT,
+    ModbusReadHolding,
+    ModbusReadInput,
+    ModbusValidateHolding,
+    ModbusWriteHolding,
+    ModbusCommitWrites
+};
+
+/**
+ * @brief Answers the Modbus request received in the background, if any.
+ * The registers are read and written between control ticks, so a request always sees a consistent state.
+ */
+void ProcessModbus(void) {
+    static uint8_t request[MODBUS_FRAME_MAX];
+    static uint8_t response[MODBUS_FRAME_MAX];
+
+    uint8_t length = ModbusUart_TakeFrame(request);
+    if (length == 0) {
+        return;
+    }
+    length = ModbusRtu_HandleFrame(MODBUS_SLAVE_ADDR, modbusRegisters, request, length, response);
+    if (length > 0) {
+        ModbusUart_Send(response, length);
+    } else {
+        ModbusUart_ReleaseFrame();
+    }
+}
+#endif
+
+#if COORD_ENABLED
+/**
+ * @brief Passes the frames received on the coordination bus to the coordinator and sends its own.
+ * @param nowMs Current time in milliseconds.
+ */
+void ProcessCoordinatorBus(uint32_t nowMs) {
+    static uint8_t frame[MODBUS_FRAME_MAX];
+
+    uint8_t length = ModbusUart_TakeFrame(frame);
+    if (length > 0) {
+        ModbusUart_ReleaseFrame();
+        pumpCoordinator.HandleFrame(frame, length, nowMs);
+    }
+    length = pumpCoordinator.Poll(nowMs, frame);
+    if (length > 0) {
+        ModbusUart_Send(frame, length);
+    }
+}
+#endif
+
+#if CONFIG_LINK_ENABLED
+ConfigLinkParser configLink;
+
+/**
+ * @brief Reads the configuration stored in the EEPROM, as the board loads it at start-up.
+ * @param image The image read.
+ */
+void ConfigReadImage(ConfigImage &image) {
+    PumpCycleTime cycles[2];
+    ScheduleWindow windows[SCHEDULE_MAX_WINDOWS];
+    I2C_EEPROM_ReadBytes(NVM_PUMP_CYCLES_ADDR, (uint8_t*)cycles, sizeof(cycles));
+    I2C_EEPROM_ReadBytes(NVM_SCHEDULE_ADDR, (uint8_t*)windows, sizeof(windows));
+
+    image.version = CONFIG_IMAGE_VERSION;
+    for (uint8_t i = 0; i < CONFIG_NUM_PUMPS; i++) {
+        image.cycles[i].hour = cycles[i].hour;
+        image.cycles[i].minute = cycles[i].minute;
+        image.cycles[i].second = cycles[i].second;
+    }
+    for (uint8_t i = 0; i < CONFIG_NUM_WINDOWS; i++) {
+        image.windows[i].days = windows[i].days;
+        image.windows[i].startHour = windows[i].startHour;
+        image.windows[i].startMinute = windows[i].startMinute;
+        image.windows[i].endHour = windows[i].endHour;
+        image.windows[i].endMinute = windows[i].endMinute;
+    }
+}
+
+/**
+ * @brief Applies a validated configuration, it is saved to the EEPROM by the NVM task of the same loop.
+ * @param image The image received.
+ */
+void ConfigWriteImage(const ConfigImage &image) {
+    for (uint8_t i = 0; i < CONFIG_NUM_PUMPS; i++) {
+        PumpCyclesTimes[i] = {image.cycles[i].hour, image.cycles[i].minute, image.cycles[i].second};
+    }
+    ApplyPumpCycles(true);
+    for (uint8_t i = 0; i < CONFIG_NUM_WINDOWS; i++) {
+        ScheduleWindow window = {image.windows[i].days, image.windows[i].startHour, image.windows[i].startMinute,
+                                 image.windows[i].endHour, image.windows[i].endMinute};
+        pumpSchedule.setWindow(i, window);
+    }
+    scheduleSavePending = true;
+    LogSerialn("Configuration written by the provisioning tool", true);
+}
+
+/**
+ * @brief Sets the RTC, same as from the clock menu.
+ * @param localTime Local time in seconds since 1970.
+ */
+void ConfigSetTime(uint32_t localTime) {
+    rtc_datetime.setDateTime(DateTime(localTime));
+    pumpSchedule.RequestRecompute();
+    LogSerialn("Clock set by the provisioning tool", true);
+}
+
+const ConfigLinkHandlers configLinkHandlers = {
+    ConfigReadImage,
+    ConfigWriteImage,
+    ConfigSetTime
+};
+
+/**
+ * @brief Answers the provisioning frames received on the serial port, the log text around them is ignored by the host.
+ * @param nowMs Current time in milliseconds.
+ */
+void ProcessConfigLink(uint32_t nowMs) {
+    static uint8_t response[CONFIG_LINK_FRAME_MAX];
+
+    while (Serial.available() > 0) {
+        ConfigLinkResult_t result = configLink.Feed((uint8_t)Serial.read(), nowMs);
+        if (result != CONFIG_LINK_NONE) {
+            uint8_t length = ConfigLink_HandleFrame(configLinkHandlers, configLink, result, response);
+            Serial.write(response, length);
+        }
+    }
+}
+#endif
+
 void setup() {
+    Watchdog_Begin(PumpsSafeState);
+#if MODBUS_ENABLED
+    ModbusUart_Begin(MODBUS_BAUD, RS485_DE_PIN);
+#elif COORD_ENABLED
+    ModbusUart_Begin(COORD_BAUD, RS485_DE_PIN);
+#elif BENCH_ENABLED
+    Serial.begin(115200);
+#else
     Serial.begin(9600);
+#endif
     Wire.begin(); 
+    Wire.setClock(I2C_BUS_CLOCK_HZ);
+    Wire.setWireTimeout(I2C_TIMEOUT_US, true);
+    if (IO_EXPANDER_INSTALLED) {
+        IoExpander_Add(IO_EXPANDER_TYPE, IO_EXPANDER_I2C_ADDR);
+    }
+    IoExpander_Begin(IO_EXPANDER_INT_PIN);
     LogSerialn("Starting Water Pump Control System", true);
+    ReportCrashRecord();
+    /** Printing the last incident blocks on the serial port, it is only done at start-up */
+    blackBox.Load();
+    blackBox.Report();
+    demandProfile.Load();
+    demandProfile.Report();
     lcdDisplay.init();
     rtc_datetime.begin();
     LoadPumpCyclesFromEEPROM(PumpCyclesTimes);
+    ApplyPumpCycles(false);
+    pumpSchedule.Load();
+
+    /** The schedule transitions are signaled by the RTC alarm on the INT/SQW pin */
+    pinMode(DI_RTC_ALARM, INPUT_PULLUP);
+    rtc_datetime.EnableAlarmInterrupt();
+    PinChange_Attach(DI_RTC_ALARM, OnRtcAlarmPinChange);
+
+    if (FLOW_METER_INSTALLED) {
+        flowMeter.Load();
+        flowMeter.begin();
+    }
+    AdcSampler_Begin();
+    lastButtonMs = millis();
+#if BENCH_ENABLED
+    Bench_Begin();
+#endif
+    Watchdog_TaskEnd(WDT_TASK_SETUP);
 }
 
 void loop() {
     static uint64_t lastSensorsMillis = 0;
     static uint64_t lastActuatorsMillis = 0;
-    static uint64_t lastDisplayMillis = 0;
-    static CtrlModeSel_t currentCtrlMode = CTRL_AUTO_BY_SENSORS;
+    static uint8_t tickedButtons = 0;
     uint64_t now = millis();
+    BENCH_BEGIN(BENCH_LOOP);
 
-    if (now - lastSensorsMillis >= POLL_ALL_SENSORS_TIMEOUT) {
+    if (now - lastSensorsMillis >= loopRate.getPollMs()) {
+        Watchdog_TaskBegin(WDT_TASK_POLL);
+        BENCH_BEGIN(BENCH_POLL_SENSORS);
         PollAllSensors();
+        BENCH_END(BENCH_POLL_SENSORS);
+        eventTrace.Inputs(cisternSensor.isSensorActive() == SENSOR_FULL_LEVEL,
+                          wellSensor.isSensorActive() == SENSOR_EMPTY_LEVEL, GetPumpsOnMask(), now);
+        blackBox.Record(GetBlackBoxSample(), now);
+        buttonEvents.UpdateEvents(now);
+        if (pbMode.isSensorActive() || pbPumpSel.isSensorActive()) {
+            WakeBacklight(now);
+        }
+        Watchdog_TaskEnd(WDT_TASK_POLL);
         lastSensorsMillis = now;
     }
 
-    if (now - lastActuatorsMillis >= CONTROL_PUMPS_TIMEOUT) {
-        currentCtrlMode = ControlModeSelection(currentCtrlMode);
-        
-        if(currentCtrlMode == CTRL_MODE_MANUAL) {
-            CntrlPumpsByManual();
-        } else if(currentCtrlMode == CTRL_AUTO_BY_SENSORS) {
-            CntrlPumpsBySensors();
-        } else if(currentCtrlMode == CTRL_AUTO_BY_TIMER) {
-            CntrlPumpsByTimer();
-        } else {
-            currentCtrlMode = CTRL_AUTO_BY_SENSORS;
+    /** The mode and pump selection buttons act on their release in the control tick. A change of either one
+     *  brings the tick forward to the next poll, so a press shorter than the control period is not lost */
+    uint8_t buttons = (pbMode.isSensorActive() ? 0x01 : 0) | (pbPumpSel.isSensorActive() ? 0x02 : 0);
+    if ((buttons != tickedButtons) || (now - lastActuatorsMillis >= loopRate.getControlMs())) {
+        Watchdog_TaskBegin(WDT_TASK_CONTROL);
+        BENCH_BEGIN(BENCH_CONTROL_TICK);
+        tickedButtons = buttons;
+        BENCH_BEGIN(BENCH_MODE_SELECTION);
+        currentCtrlMode = pumpControl.SelectMode(currentCtrlMode, (buttons & 0x01) != 0);
+        BENCH_END(BENCH_MODE_SELECTION);
+        UpdateModeLeds(currentCtrlMode);
+        UpdateSchedule(now);
+        scheduleAllowed = pumpSchedule.isPumpingAllowed(cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL, now);
+
+        PumpControlInputs inputs;
+        inputs.wellEmpty = (wellSensor.isSensorActive() == SENSOR_EMPTY_LEVEL);
+        inputs.cisternEmpty = (cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL);
+        inputs.pumpSelButton = (buttons & 0x02) != 0;
+        inputs.fault = plausibility.hasFault();
+        inputs.scheduleAllowed = scheduleAllowed;
+        inputs.coordAssigned = PUMP_CONTROL_NOT_COORDINATED;
+        UpdateDemandProfile(now);
+        inputs.prefill = demandProfile.UpdatePrefill(IsCisternLevelValid(), GetCisternLevelPercent(), inputs.cisternEmpty);
+#if COORD_ENABLED
+        if (pumpCoordinator.isCoordinated(now)) {
+            inputs.coordAssigned = (pumpCoordinator.isAssigned(0) ? 0x01 : 0) | (pumpCoordinator.isAssigned(1) ? 0x02 : 0);
+        }
+#endif
+        currentCtrlMode = pumpControl.Tick(currentCtrlMode, inputs, PumpCycleBudgetsMs, now);
+        pump1.setState(pumpControl.isPumpOn(0));
+        pump2.setState(pumpControl.isPumpOn(1));
+
+        /** A pump without flow latches a fault, which stops the automatic modes on the next tick */
+        if (FLOW_METER_INSTALLED) {
+            flowMeter.Update(pump1.isActive(), pump2.isActive(), now);
+        }
+        /** The boards on the coordination bus share the cistern, a pump of any of them may fill it */
+        bool anyPumpOn = pump1.isActive() || pump2.isActive();
+#if COORD_ENABLED
+        anyPumpOn = anyPumpOn || pumpCoordinator.isAnyPumpOn(now);
+#endif
+        plausibility.Update(wellSensor.isSensorActive() == SENSOR_EMPTY_LEVEL,
+                            cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL,
+                            anyPumpOn, FLOW_METER_INSTALLED && flowMeter.isNoFlow(), now);
+        UpdateBlackBoxTriggers(now);
+
+#if COORD_ENABLED
+        /** Only the sensors mode takes part in the coordination, the pumps of a dry well, or paused until
+         *  it recovered, are not available so the coordinator assigns pumps that can run instead */
+        bool coordAvailable = (currentCtrlMode == CTRL_AUTO_BY_SENSORS) && !plausibility.hasFault() && scheduleAllowed;
+        bool wellAvailable = coordAvailable && (wellSensor.isSensorActive() != SENSOR_EMPTY_LEVEL);
+        pumpCoordinator.UpdateLocal(coordAvailable && (cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL),
+                                    wellAvailable && !wellRecovery.isPausedByWell(0),
+                                    wellAvailable && !wellRecovery.isPausedByWell(1),
+                                    pump1.isActive(), pump2.isActive(), now);
+#endif
+
+        /** Expander outputs set during the tick are written together, one transaction per device that changed */
+        IoExpander_Flush();
+        eventTrace.Outputs(GetPumpsOnMask(), now);
+#if SERIAL_LOG_ENABLED
+        LogEventTraces();
+#endif
+
+        UpdateBacklight(now);
+        PowerSave_Update(backlightOn, now);
+
+        /** Poll and control fast while a pump runs or may start, slower while idle */
+        bool startPending = (currentCtrlMode != CTRL_MODE_MANUAL) && scheduleAllowed && !plausibility.hasFault() &&
+                            ((cisternSensor.isSensorActive() == SENSOR_EMPTY_LEVEL) || demandProfile.isPrefilling());
+        if (loopRate.Update(pump1.isActive() || pump2.isActive(), startPending, backlightOn, now)) {
+            LogSerialn("Loop rate " + String(LoopRate::getRateName(loopRate.getRate())), true);
         }
+        BENCH_END(BENCH_CONTROL_TICK);
+        Watchdog_TaskEnd(WDT_TASK_CONTROL);
 
         lastActuatorsMillis = now;
     }
 
-    if (now - lastDisplayMillis >= DISPLAY_UPDATE_TIMEOUT) {
-        ShowDisplayMenus(currentCtrlMode);
-        lastDisplayMillis = now;
+    /** User input is handled as soon as it is queued, independently of the display refresh */
+    Watchdog_TaskBegin(WDT_TASK_UI);
+    BENCH_BEGIN(BENCH_BUTTONS);
+    ProcessButtonEvents(currentCtrlMode);
+    BENCH_END(BENCH_BUTTONS);
+
+    Watchdog_TaskBegin(WDT_TASK_BUS);
+#if MODBUS_ENABLED
+    ProcessModbus();
+#elif COORD_ENABLED
+    ProcessCoordinatorBus(now);
+#elif CONFIG_LINK_ENABLED
+    ProcessConfigLink(now);
+#endif
+
+    /** Configuration changes are persisted here, never from the control tick */
+    Watchdog_TaskBegin(WDT_TASK_NVM);
+    BENCH_BEGIN(BENCH_NVM_SAVE);
+    if (pumpCyclesSavePending) {
+        SavePumpCyclesToEEPROM(PumpCyclesTimes);
+        pumpCyclesSavePending = false;
+    }
+    if (scheduleSavePending) {
+        pumpSchedule.Save();
+        scheduleSavePending = false;
+    }
+    if (flowMeter.isSavePending()) {
+        flowMeter.Save();
+    }
+    if (blackBox.isSavePending()) {
+        blackBox.Save(rtc_datetime.GetCurrentDateTime().unixtime(), now);
+    }
+    if (demandProfile.isSavePending()) {
+        demandProfile.Save();
+    }
+    BENCH_END(BENCH_NVM_SAVE);
+
+    /** Redraw only what changed on the current screen, throttled by the render state */
+    Watchdog_TaskBegin(WDT_TASK_UI);
+    if (uiRender.BeginFrame(now)) {
+        BENCH_BEGIN(BENCH_RENDER);
+        ShowDisplayMenus(currentCtrlMode, BTN_NONE);
+        uiRender.EndFrame();
+        BENCH_END(BENCH_RENDER);
     }
+    Watchdog_TaskEnd(WDT_TASK_UI);
+    BENCH_END(BENCH_LOOP);
+#if BENCH_ENABLED
+    Bench_Report(now);
+#endif
+
+    /** The watchdog is fed only once the sensor poll, the control tick and the UI have all run */
+    Watchdog_Feed();
+
+    /** Nothing else is due until an interrupt: the millis() tick, a pin change, the ADC or the USART */
+    PowerSave_Idle();
 }
@@ -0,0 +1,398 @@
+/*
+ * Host benchmark of the hot kernels of the firmware, run on a PC.
+ *
+ * The control modes, the mode selection, the debounce of DigitalSensor::PollSensorState(), the
+ * date/time formatting and the menu renderers are built unchanged from src and called with a
+ * scripted workload. Each kernel is timed over BENCH_REPS short runs of a fixed number of calls
+ * in CPU time of the thread, and the fastest run is kept, which filters out most of the other
+ * load of the PC. The heap allocations of all the runs are counted. The results are
+ * compared with a JSON baseline: a kernel slower than its baseline by more than the tolerance,
+ * or with more allocations, fails and the exit code is 1. The times depend on the PC, the
+ * baseline is written on the reference machine with --update. The cycle budgets of the board
+ * itself are checked by the nanoatmega328_bench build, see Bench.cpp.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++17 -O2 -Itools/host -Iinclude tools/bench/PumpBench.cpp src/DAL/PumpControl.cpp \
+ *       src/DAL/WellRecovery.cpp src/DAL/DemandBoost.cpp src/DAL/PumpStats.cpp src/DAL/Sensors.cpp \
+ *       src/DAL/UserInterface.cpp src/DAL/UiRender.cpp src/DAL/PumpSchedule.cpp src/HAL/RealTimeClock.cpp \
+ *       src/DAL/utilities.cpp -o pump_bench
+ * Run:
+ *   ./pump_bench [--baseline file] [--tolerance pct] [--update]
+ */
+
+#include <Arduino.h>
+#include "PumpControl.h"
+#include "Sensors.h"
+#include "RealTimeClock.h"
+#include "UserInterface.h"
+#include "AT24C32_nvm.h"
+
+#include <time.h>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#define BENCH_REPS            (201)
+#define BENCH_TOLERANCE_PCT   (10.0)    /* Default of --tolerance, the same as the board build */
+#define BENCH_BASELINE        "tools/bench/baseline.json"
+
+#define CONTROL_TICK_MS       (200UL)   /* LOOP_RATE_ACTIVE_CONTROL_MS */
+#define BOUNCE_STEP_MS        (10UL)    /* Time between two debounce calls, finer than the poll to see the bounce */
+
+/*
+ * Stand-ins for the HAL below the benchmarked code. They keep the inputs the workload sets
+ * and the rows the screens draw, without any bus traffic.
+ */
+
+static uint32_t hostMillis = 0;
+static bool hostPinLevel = false;
+static char lcdRows[LCD_DISPLAY_ROWS][LCD_DISPLAY_COLS + 1];
+static uint64_t allocations = 0;
+
+unsigned long millis() {
+    return hostMillis;
+}
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+DI_Inputs::DI_Inputs(uint8_t pin) : pin(pin) {}
+
+bool DI_Inputs::readInputPin() {
+    return hostPinLevel;
+}
+
+uint8_t DI_Inputs::getPin() {
+    return pin;
+}
+
+void AdcSampler_GetSums(uint8_t, AdcSums &sums) {
+    memset(&sums, 0, sizeof(sums));
+}
+
+PCF8574_Lcd::PCF8574_Lcd(uint8_t addr, uint8_t cols, uint8_t rows) : addr(addr), cols(cols), rows(rows) {}
+
+void LCD_Display::writeRow(uint8_t row, const char *text) {
+    strncpy(lcdRows[row % LCD_DISPLAY_ROWS], text, LCD_DISPLAY_COLS);
+}
+
+FlowMeter::FlowMeter(uint8_t pin) : pin(pin) {
+    liters[0] = 12345;
+    liters[1] = 6789;
+}
+
+uint32_t FlowMeter::getRateMlPerMin() {
+    return 18500;
+}
+
+uint32_t FlowMeter::getLiters(uint8_t pump) {
+    return liters[pump];
+}
+
+uint8_t FlowMeter::getVersion() {
+    return version;
+}
+
+void I2C_EEPROM_WriteBytes(uint16_t, const uint8_t *, uint16_t) {}
+
+void I2C_EEPROM_ReadBytes(uint16_t, uint8_t *data, uint16_t length) {
+    memset(data, 0xFF, length);
+}
+
+/*
+ * Kernels. Each one is called with the index of the call, counted on over the runs so the
+ * time of the modules never goes back, and drives its own state from it.
+ */
+
+struct Kernel {
+    const char *name;
+    uint32_t calls;
+    std::function<void(uint32_t)> call;
+};
+
+struct Result {
+    double nsPerCall;
+    uint64_t allocs;
+};
+
+/* Control tick inputs of a fill cycle: the cistern drains for 60 s, the well runs dry for 2 s every 40 s */
+static PumpControlInputs ScriptedInputs(uint32_t i) {
+    PumpControlInputs in;
+    in.cisternEmpty = (i % 600) < 300;
+    in.wellEmpty = (i % 200) >= 190;
+    in.pumpSelButton = false;
+    in.fault = false;
+    in.scheduleAllowed = true;
+    in.coordAssigned = PUMP_CONTROL_NOT_COORDINATED;
+    in.prefill = false;
+    return in;
+}
+
+struct ControlBench {
+    WellRecovery wellRecovery;
+    DemandBoost demandBoost;
+    PumpStats pumpStats;
+    PumpControl control;
+    uint32_t budgetsMs[PUMP_CONTROL_NUM_PUMPS] = {60000UL, 90000UL};
+    ControlBench() : control(wellRecovery, demandBoost, pumpStats) {}
+
+    void Tick(CtrlModeSel_t mode, uint32_t i) {
+        control.Tick(mode, ScriptedInputs(i), budgetsMs, i * CONTROL_TICK_MS);
+    }
+};
+
+struct UiBench {
+    LCD_Display lcd{LCD_DISPLAY_I2C_ADDR, LCD_DISPLAY_COLS, LCD_DISPLAY_ROWS};
+    UiRender render;
+    RealTimeClock rtc;
+    PumpStats pumpStats;
+    FlowMeter flowMeter{2};
+    PumpSchedule schedule;
+    PumpCycleTime cycleTimes[2] = {{0, 10, 0}, {0, 15, 30}};
+    CtrlModeSel_t mode = CTRL_AUTO_BY_SENSORS;
+
+    /* Every frame redraws the whole screen, the worst case of a screen change */
+    void Frame(uint32_t i, const std::function<void(bool)> &screen) {
+        render.InvalidateAll();
+        if (render.BeginFrame((i + 1) * UI_RENDER_MIN_INTERVAL_MS)) {
+            screen((i % 4) == 0);
+            render.EndFrame();
+        }
+    }
+};
+
+static std::vector<Kernel> MakeKernels(ControlBench &sensors, ControlBench &timer, ControlBench &modes,
+                                       DigitalSensor &sensor, UiBench &ui) {
+    static const DateTime epoch(2024, 6, 30, 23, 59, 0);
+    return {
+        {"mode_selection", 2000, [&](uint32_t i) {
+            /** The mode button is held for 4 calls out of 32 */
+            modes.control.SelectMode(CTRL_AUTO_BY_SENSORS, (i % 32) < 4);
+        }},
+        {"ctrl_sensors", 6000, [&](uint32_t i) {
+            sensors.Tick(CTRL_AUTO_BY_SENSORS, i);
+        }},
+        {"ctrl_timer", 6000, [&](uint32_t i) {
+            timer.Tick(CTRL_AUTO_BY_TIMER, i);
+        }},
+        {"sensor_poll", 2000, [&](uint32_t i) {
+            /** A contact that bounces for 30 ms on each edge, one edge a second */
+            hostMillis = i * BOUNCE_STEP_MS;
+            uint32_t phase = hostMillis % 1000;
+            hostPinLevel = (phase < 30) ? ((i & 1) != 0) : (hostMillis % 2000 < 1000);
+            sensor.PollSensorState();
+        }},
+        {"format_datetime", 6000, [&](uint32_t i) {
+            char buf[18];
+            RealTimeClock::FormatDateTime(epoch + TimeSpan((int32_t)i), buf, sizeof(buf));
+        }},
+        {"render_main", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool) {
+                DateTime now = epoch + TimeSpan((int32_t)(i / 10));
+                DisplayMain(false, ui.mode, ui.lcd, ui.render, now, (i % 64) < 8 ? 0x01 : 0, "Fault: well");
+            });
+        }},
+        {"render_main_cfgs", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool up) {
+                DisplayMainCfgs(false, false, false, up, ui.lcd, ui.render);
+            });
+        }},
+        {"render_ctrl_type", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool up) {
+                DisplayCfgControlTypes(false, false, up, false, ui.mode, ui.lcd, ui.render);
+            });
+        }},
+        {"render_rtc", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool up) {
+                DisplayCfgRtc(false, false, up, false, false, (i % 16) == 0, ui.lcd, ui.render, ui.rtc);
+            });
+        }},
+        {"render_pump1_cycle", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool up) {
+                DisplayCfgPump1Cycle(false, false, up, false, false, (i % 16) == 0, ui.cycleTimes, ui.lcd, ui.render);
+            });
+        }},
+        {"render_pump2_cycle", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool up) {
+                DisplayCfgPump2Cycle(false, false, up, false, false, (i % 16) == 0, ui.cycleTimes, ui.lcd, ui.render);
+            });
+        }},
+        {"render_pump_stats", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool up) {
+                DisplayPumpStats(false, false, up, false, (i % 16) == 0, false, ui.pumpStats, ui.flowMeter,
+                                 1850, 72, 125, 450, ui.lcd, ui.render);
+            });
+        }},
+        {"render_schedule", 2000, [&](uint32_t i) {
+            ui.Frame(i, [&](bool up) {
+                DisplayCfgSchedule(false, false, up, false, false, (i % 16) == 0, ui.schedule, ui.lcd, ui.render);
+            });
+        }},
+    };
+}
+
+/* CPU time of the thread, the time the PC spent on other tasks is not counted */
+static double ThreadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static Result Measure(const Kernel &k) {
+    double bestNs = 0;
+    uint64_t allocStart = allocations;
+    for (uint32_t rep = 0; rep < BENCH_REPS; rep++) {
+        double start = ThreadCpuNs();
+        for (uint32_t i = rep * k.calls; i < (rep + 1) * k.calls; i++) {
+            k.call(i);
+        }
+        double ns = ThreadCpuNs() - start;
+        if ((rep == 0) || (ns < bestNs)) {
+            bestNs = ns;
+        }
+    }
+    return {bestNs / k.calls, allocations - allocStart};
+}
+
+/*
+ * Baseline file, one object per kernel:
+ *   {"kernels":{"name":{"ns_per_call":1.23,"allocs":0},...}}
+ * Only the file written by --update is read, so the parser just looks up the kernel names.
+ */
+
+static bool ReadFile(const char *path, std::string &text) {
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        text.append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool FindBaseline(const std::string &text, const char *name, Result &base) {
+    std::string key = std::string("\"") + name + "\"";
+    size_t pos = text.find(key);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    unsigned long long allocs = 0;
+    if (sscanf(text.c_str() + pos + key.length(), " : { \"ns_per_call\" : %lf , \"allocs\" : %llu",
+               &base.nsPerCall, &allocs) != 2) {
+        return false;
+    }
+    base.allocs = allocs;
+    return true;
+}
+
+static bool WriteBaseline(const char *path, const std::vector<Kernel> &kernels, const std::vector<Result> &results) {
+    FILE *f = fopen(path, "w");
+    if (f == nullptr) {
+        return false;
+    }
+    fprintf(f, "{\n  \"kernels\": {\n");
+    for (size_t i = 0; i < kernels.size(); i++) {
+        fprintf(f, "    \"%s\": {\"ns_per_call\": %.2f, \"allocs\": %llu}%s\n", kernels[i].name,
+                results[i].nsPerCall, (unsigned long long)results[i].allocs, (i + 1 < kernels.size()) ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *baselinePath = BENCH_BASELINE;
+    double tolerancePct = BENCH_TOLERANCE_PCT;
+    bool update = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "--update") {
+            update = true;
+        } else if ((opt == "--baseline") && (i + 1 < argc)) {
+            baselinePath = argv[++i];
+        } else if ((opt == "--tolerance") && (i + 1 < argc)) {
+            tolerancePct = strtod(argv[++i], nullptr);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    ControlBench sensors;
+    ControlBench timer;
+    ControlBench modes;
+    DigitalSensor sensor(2);
+    UiBench ui;
+    std::vector<Kernel> kernels = MakeKernels(sensors, timer, modes, sensor, ui);
+
+    std::vector<Result> results;
+    for (const Kernel &k : kernels) {
+        results.push_back(Measure(k));
+    }
+
+    if (update) {
+        if (!WriteBaseline(baselinePath, kernels, results)) {
+            fprintf(stderr, "Cannot write %s\n", baselinePath);
+            return 2;
+        }
+        for (size_t i = 0; i < kernels.size(); i++) {
+            printf("%-20s %10.2f ns/call %8llu allocs\n", kernels[i].name, results[i].nsPerCall,
+                   (unsigned long long)results[i].allocs);
+        }
+        printf("Baseline written to %s\n", baselinePath);
+        return 0;
+    }
+
+    std::string baseline;
+    if (!ReadFile(baselinePath, baseline)) {
+        fprintf(stderr, "Cannot read %s, write it with --update\n", baselinePath);
+        return 2;
+    }
+
+    bool pass = true;
+    printf("%-20s %10s %10s %8s %8s %8s\n", "kernel", "ns/call", "baseline", "delta", "allocs", "baseline");
+    for (size_t i = 0; i < kernels.size(); i++) {
+        const Result &r = results[i];
+        Result base;
+        if (!FindBaseline(baseline, kernels[i].name, base)) {
+            printf("%-20s %10.2f %10s %8s %8llu %8s  FAIL no baseline\n", kernels[i].name, r.nsPerCall, "-", "-",
+                   (unsigned long long)r.allocs, "-");
+            pass = false;
+            continue;
+        }
+        double deltaPct = (base.nsPerCall > 0) ? (r.nsPerCall / base.nsPerCall - 1.0) * 100.0 : 0.0;
+        bool slower = deltaPct > tolerancePct;
+        bool allocated = r.allocs > base.allocs;
+        printf("%-20s %10.2f %10.2f %+7.1f%% %8llu %8llu%s%s\n", kernels[i].name, r.nsPerCall, base.nsPerCall,
+               deltaPct, (unsigned long long)r.allocs, (unsigned long long)base.allocs,
+               slower ? "  FAIL slower" : "", allocated ? "  FAIL new allocations" : "");
+        pass = pass && !slower && !allocated;
+    }
+
+    if (!pass) {
+        printf("BENCH FAIL: a kernel is over its baseline by more than %.1f %% or allocates more\n", tolerancePct);
+        return 1;
+    }
+    printf("BENCH PASS: all kernels within %.1f %% of the baseline\n", tolerancePct);
+    return 0;
+}
@@ -0,0 +1,590 @@
+/*
+ * In-process simulation of the pump coordination bus, run on a PC.
+ *
+ * N boards, each with the real PumpCoordinator, PumpControl in the sensors mode and
+ * SensorPlausibility, share one simulated RS-485 bus and one cistern. The bus delivers every frame to the other boards after
+ * its air time, corrupts the frames of two boards that transmit at the same time, and can corrupt
+ * frames at random or cut the frame of a board that dies while it transmits. The boards are stepped
+ * every millisecond with the call order of main.cpp: frames received, control tick, then Poll().
+ *
+ * A scripted scenario per node count boots the boards, kills and revives the coordinator, the
+ * token receiver and a board in the middle of a frame, adds line noise, dries a well, fills the
+ * cistern, and fills it with the pumps of a board off for longer than the plausibility settle
+ * time, then random events are played for --minutes. In the random events the cistern only gets
+ * full by pumping. Checked on every step:
+ *   - the pumps of the coordinated boards never exceed COORD_MAX_RUNNING_PUMPS;
+ *   - two boards never transmit at the same time, unless a frame lost to noise just before left
+ *     them both timing out;
+ *   - the bus is never silent longer than a token regeneration with two boards or more alive,
+ *     and not longer than a skip once it settled;
+ *   - no board latches FAULT_CISTERN_UNEXPECTED, the cistern never gets full without a pump on.
+ * The fill timeout and the stuck well faults follow the learned times, which the random cistern
+ * and wells do not keep to, so they are acknowledged at once and counted.
+ * Checked once the bus settled after a change:
+ *   - election: every board sees the lowest live node id, and only it, as the coordinator;
+ *   - every board is heard and follows the coordinator;
+ *   - the pumps running reach min(COORD_MAX_RUNNING_PUMPS, pumps available), 0 with the cistern full.
+ * The first failure is printed with the state of the boards and the exit code is 1.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++17 -O2 -Itools/host -Iinclude tools/coord/CoordSim.cpp src/DAL/PumpCoordinator.cpp \
+ *       src/DAL/ModbusRtu.cpp src/DAL/PumpControl.cpp src/DAL/WellRecovery.cpp src/DAL/DemandBoost.cpp \
+ *       src/DAL/PumpStats.cpp src/DAL/SensorPlausibility.cpp src/DAL/utilities.cpp -o coord_sim
+ * Run:
+ *   ./coord_sim [--nodes N] [--minutes N] [--seed N]
+ */
+
+#include <Arduino.h>
+#include "PumpCoordinator.h"
+#include "PumpControl.h"
+#include "SensorPlausibility.h"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define CONTROL_TICK_MS   (200UL)   /* LOOP_RATE_ACTIVE_CONTROL_MS */
+#define FRAME_AIR_MS      (10UL)    /* COORD_FRAME_LEN bytes of 10 bits at COORD_BAUD, plus the 3.5 characters of silence */
+
+/* Longest bus silence while the token circulates: a hold, or the reply timeout of a skipped id */
+#define TOKEN_SILENCE_MS  (max(COORD_TOKEN_HOLD_MS, COORD_REPLY_TIMEOUT_MS) + FRAME_AIR_MS + 2)
+/* Longest bus silence when the token is lost: the regeneration wait of the highest node id, or the
+ * listen time of boards that all reset together */
+#define LOST_SILENCE_MS   (max(COORD_LISTEN_MS, COORD_TOKEN_LOST_MS) + (COORD_MAX_NODES - 1) * COORD_REPLY_TIMEOUT_MS + FRAME_AIR_MS + 2)
+/* A board that died is forgotten, and the token regenerated, within this time of a change */
+#define SETTLE_MS         (COORD_NODE_TIMEOUT_MS + LOST_SILENCE_MS + COORD_MAX_NODES * TOKEN_SILENCE_MS)
+/* Pumps stopped by a reassignment stay off the minimum off time, then start one per round */
+#define PUMPS_SETTLE_MS   (SETTLE_MS + WELL_MIN_OFF_TIME_MS + COORD_MAX_RUNNING_PUMPS * PUMP_START_STAGGER_MS)
+/* Settled pumps dip below the target only while a rotation stops one and starts the next */
+#define TARGET_GRACE_MS   (WELL_MIN_OFF_TIME_MS)
+
+struct BusFrame {
+    uint8_t data[COORD_FRAME_LEN];
+    uint8_t length;
+    uint8_t src;
+    uint64_t startMs;
+    bool corrupt;
+};
+
+/* One board, its objects are created again when it is revived, like a reset */
+struct Board {
+    WellRecovery wellRecovery;
+    DemandBoost demandBoost;
+    PumpStats pumpStats;
+    PumpControl control;
+    PumpCoordinator coord;
+    SensorPlausibility plausibility;
+    bool coordinated = false;
+    bool pumpOn[2] = {false, false};
+    Board(uint8_t id) : control(wellRecovery, demandBoost, pumpStats), coord(id) {}
+};
+
+struct Node {
+    uint8_t id;
+    bool alive = false;
+    bool wellEmpty = false;
+    uint64_t bootMs = 0;
+    uint32_t tickPhaseMs = 0;    /* Offset of the control ticks from the boot */
+    std::unique_ptr<Board> board;
+};
+
+class Simulation
+{
+private:
+    std::vector<Node> nodes;
+    std::vector<BusFrame> bus;
+    std::mt19937_64 rng;
+    uint64_t nowMs = 0;
+    uint64_t lastTxMs = 0;
+    uint64_t reviveMs = 0;       /* Last board revived, a bus silent before it may stay silent while it listens */
+    uint64_t changeMs = 0;       /* Last change of the boards or the bus */
+    uint64_t pumpsChangeMs = 0;  /* Last change of the boards, the wells or the demand */
+    uint64_t targetMetMs = 0;
+    bool cisternEmpty = true;
+    uint64_t fillLeftMs = 0;     /* Pump time left until the cistern is full, 0 = only SetCisternEmpty() fills it */
+    double noise = 0;            /* Probability of a corrupted frame */
+    uint8_t killOnNext = 0;      /* Kill the board named by the next frame as it is received */
+    uint8_t killInFrame = 0;     /* Kill the board that transmits next, in the middle of its frame */
+    uint32_t frames = 0;
+    uint32_t corrupted = 0;
+    uint32_t collisions = 0;
+    uint32_t faultsCleared = 0;
+    uint64_t lostMs = 0;         /* Last frame lost to noise */
+    bool lostSeen = false;
+
+    uint32_t Local(const Node &n) const {
+        return (uint32_t)(nowMs - n.bootMs);
+    }
+
+    void Fail(const std::string &what) {
+        if (failed) {
+            return;
+        }
+        failed = true;
+        printf("FAIL at %.3f s: %s\n", nowMs / 1000.0, what.c_str());
+        for (const Node &n : nodes) {
+            if (!n.alive) {
+                printf("  node %u  dead\n", n.id);
+                continue;
+            }
+            PumpCoordinator &c = n.board->coord;
+            uint32_t local = Local(n);
+            printf("  node %u  coordinator %d  coordinated %d  nodes %u  pumps %d%d  well %s  faults 0x%02X\n", n.id,
+                   c.isCoordinator(local), c.isCoordinated(local), c.getNodeCount(local),
+                   n.board->pumpOn[0], n.board->pumpOn[1], n.wellEmpty ? "empty" : "ok",
+                   n.board->plausibility.getFaults());
+        }
+    }
+
+    void Transmit(Node &n, const uint8_t *data, uint8_t length) {
+        BusFrame f;
+        memcpy(f.data, data, length);
+        f.length = length;
+        f.src = n.id;
+        f.startMs = nowMs;
+        f.corrupt = std::bernoulli_distribution(noise)(rng);
+        if (f.corrupt) {
+            lostMs = nowMs;
+            lostSeen = true;
+        }
+        for (BusFrame &other : bus) {
+            if (nowMs < other.startMs + FRAME_AIR_MS) {
+                other.corrupt = true;
+                f.corrupt = true;
+                /** A lost frame can leave two boards timing out together, the collision is then recovered
+                 *  like any other lost frame. Without loss the token never lets two boards transmit */
+                if (lostSeen && (nowMs - lostMs <= LOST_SILENCE_MS)) {
+                    collisions++;
+                    lostMs = nowMs;
+                } else {
+                    Fail("node " + std::to_string(n.id) + " transmits over node " + std::to_string(other.src));
+                }
+            }
+        }
+        bus.push_back(f);
+        lastTxMs = nowMs;
+        frames++;
+        if (killInFrame == n.id) {
+            killInFrame = 0;
+            Kill(n.id);
+        }
+    }
+
+    void Deliver() {
+        for (size_t i = 0; i < bus.size();) {
+            BusFrame &f = bus[i];
+            if (nowMs < f.startMs + FRAME_AIR_MS) {
+                i++;
+                continue;
+            }
+            if (f.corrupt) {
+                f.data[3 + rng() % (COORD_FRAME_LEN - 3)] ^= 1U << (rng() % 8);
+                corrupted++;
+            }
+            for (Node &n : nodes) {
+                /** A board booted during the frame only hears its end, which it cannot decode */
+                if (n.alive && (n.id != f.src) && (n.bootMs <= f.startMs)) {
+                    n.board->coord.HandleFrame(f.data, f.length, Local(n));
+                }
+            }
+            if (!f.corrupt && (killOnNext != 0) && (f.data[2] == killOnNext)) {
+                Kill(killOnNext);
+                killOnNext = 0;
+            }
+            bus.erase(bus.begin() + i);
+        }
+    }
+
+    void Tick(Node &n) {
+        Board &b = *n.board;
+        uint32_t local = Local(n);
+        PumpControlInputs in;
+        in.wellEmpty = n.wellEmpty;
+        in.cisternEmpty = cisternEmpty;
+        in.pumpSelButton = false;
+        in.fault = b.plausibility.hasFault();
+        in.scheduleAllowed = true;
+        in.coordAssigned = PUMP_CONTROL_NOT_COORDINATED;
+        in.prefill = false;
+        b.coordinated = b.coord.isCoordinated(local);
+        if (b.coordinated) {
+            in.coordAssigned = (b.coord.isAssigned(0) ? 0x01 : 0) | (b.coord.isAssigned(1) ? 0x02 : 0);
+        }
+        b.control.Tick(CTRL_AUTO_BY_SENSORS, in, budgetsMs, local);
+        b.pumpOn[0] = b.control.isPumpOn(0);
+        b.pumpOn[1] = b.control.isPumpOn(1);
+        b.plausibility.Update(n.wellEmpty, cisternEmpty, b.pumpOn[0] || b.pumpOn[1] || b.coord.isAnyPumpOn(local),
+                              false, local);
+        if (b.plausibility.getFaults() & FAULT_CISTERN_UNEXPECTED) {
+            Fail("node " + std::to_string(n.id) + " latched an unexpected cistern full");
+        } else if (b.plausibility.hasFault()) {
+            b.plausibility.ClearFaults();
+            faultsCleared++;
+        }
+        bool available = !b.plausibility.hasFault() && !n.wellEmpty;
+        b.coord.UpdateLocal(!b.plausibility.hasFault() && cisternEmpty, available && !b.wellRecovery.isPausedByWell(0),
+                            available && !b.wellRecovery.isPausedByWell(1), b.pumpOn[0], b.pumpOn[1], local);
+    }
+
+    /* Fills the cistern with the pumps running, for the random events */
+    void Fill() {
+        if (!cisternEmpty || (fillLeftMs == 0)) {
+            return;
+        }
+        for (const Node &n : nodes) {
+            if (n.alive) {
+                uint64_t on = n.board->pumpOn[0] + n.board->pumpOn[1];
+                fillLeftMs -= min(on, fillLeftMs);
+            }
+        }
+        if (fillLeftMs == 0) {
+            SetCisternEmpty(false);
+        }
+    }
+
+    uint8_t AliveCount() const {
+        uint8_t count = 0;
+        for (const Node &n : nodes) {
+            count += n.alive;
+        }
+        return count;
+    }
+
+    void Check() {
+        uint8_t alive = AliveCount();
+        uint8_t lowest = 0;
+        uint8_t available = 0;
+        uint8_t running = 0;
+        uint8_t coordinatedRunning = 0;
+        for (const Node &n : nodes) {
+            if (!n.alive) {
+                continue;
+            }
+            if (lowest == 0) {
+                lowest = n.id;
+            }
+            available += n.wellEmpty ? 0 : 2;
+            uint8_t on = n.board->pumpOn[0] + n.board->pumpOn[1];
+            running += on;
+            coordinatedRunning += n.board->coordinated ? on : 0;
+        }
+
+        if (coordinatedRunning > COORD_MAX_RUNNING_PUMPS) {
+            Fail(std::to_string(coordinatedRunning) + " coordinated pumps running, limit " +
+                 std::to_string(COORD_MAX_RUNNING_PUMPS));
+        }
+        bool settled = (nowMs - changeMs >= SETTLE_MS);
+        uint64_t silenceMs = nowMs - max(lastTxMs, reviveMs);
+        if ((alive >= 2) && (silenceMs > (settled ? TOKEN_SILENCE_MS : LOST_SILENCE_MS))) {
+            Fail("bus silent for " + std::to_string(silenceMs) + " ms");
+        }
+        if (!settled || (nowMs % 100 != 0)) {
+            return;
+        }
+
+        for (const Node &n : nodes) {
+            if (!n.alive) {
+                continue;
+            }
+            PumpCoordinator &c = n.board->coord;
+            uint32_t local = Local(n);
+            if (c.isCoordinator(local) != (n.id == lowest)) {
+                Fail("node " + std::to_string(n.id) + (c.isCoordinator(local) ? " claims" : " does not claim") +
+                     " the coordinator, lowest live node is " + std::to_string(lowest));
+            }
+            if (c.getNodeCount(local) != alive) {
+                Fail("node " + std::to_string(n.id) + " sees " + std::to_string(c.getNodeCount(local)) +
+                     " nodes of " + std::to_string(alive));
+            }
+            if ((alive >= 2) && !c.isCoordinated(local)) {
+                Fail("node " + std::to_string(n.id) + " does not follow the coordinator");
+            }
+        }
+
+        uint8_t target = cisternEmpty ? min(COORD_MAX_RUNNING_PUMPS, available) : 0;
+        if ((alive < 2) || (running == target)) {
+            targetMetMs = nowMs;
+        } else if ((nowMs - pumpsChangeMs >= PUMPS_SETTLE_MS) && (nowMs - targetMetMs > TARGET_GRACE_MS)) {
+            Fail(std::to_string(running) + " pumps running, expected " + std::to_string(target));
+        }
+    }
+
+    void Changed(bool pumps) {
+        changeMs = nowMs;
+        if (pumps) {
+            pumpsChangeMs = nowMs;
+        }
+    }
+
+public:
+    bool failed = false;
+    uint32_t budgetsMs[PUMP_CONTROL_NUM_PUMPS] = {0, 0};
+
+    Simulation(uint8_t count, uint64_t seed) : rng(seed) {
+        for (uint8_t id = 1; id <= count; id++) {
+            Node n;
+            n.id = id;
+            nodes.push_back(std::move(n));
+        }
+    }
+
+    uint64_t Now() const {
+        return nowMs;
+    }
+
+    uint8_t NodeCount() const {
+        return (uint8_t)nodes.size();
+    }
+
+    bool isAlive(uint8_t id) const {
+        return nodes[id - 1].alive;
+    }
+
+    void Revive(uint8_t id) {
+        Node &n = nodes[id - 1];
+        if (n.alive) {
+            return;
+        }
+        n.alive = true;
+        n.bootMs = nowMs;
+        n.tickPhaseMs = rng() % CONTROL_TICK_MS;
+        n.board.reset(new Board(id));
+        reviveMs = nowMs;
+        Changed(true);
+    }
+
+    void Kill(uint8_t id) {
+        Node &n = nodes[id - 1];
+        if (!n.alive) {
+            return;
+        }
+        n.alive = false;
+        n.board.reset();
+        for (BusFrame &f : bus) {
+            if (f.src == id) {
+                f.corrupt = true;
+            }
+        }
+        Changed(true);
+    }
+
+    /* Kills the board the token is passed to next, as soon as it received it */
+    void KillTokenReceiver(uint8_t id) {
+        killOnNext = id;
+    }
+
+    /* Kills a board in the middle of its next frame, the token it passed is lost */
+    void KillInFrame(uint8_t id) {
+        killInFrame = id;
+    }
+
+    void SetWellEmpty(uint8_t id, bool empty) {
+        nodes[id - 1].wellEmpty = empty;
+        Changed(true);
+    }
+
+    void SetCisternEmpty(bool empty) {
+        cisternEmpty = empty;
+        fillLeftMs = 0;
+        Changed(true);
+    }
+
+    /* Draws water from the cistern, it gets full again once the pumps ran fillPumpMs more in total */
+    void DrawCistern(uint64_t fillPumpMs) {
+        if (!cisternEmpty) {
+            SetCisternEmpty(true);
+        }
+        fillLeftMs += fillPumpMs;
+    }
+
+    void SetNoise(double probability) {
+        noise = probability;
+        Changed(false);
+    }
+
+    void Run(uint64_t durationMs) {
+        uint64_t endMs = nowMs + durationMs;
+        while ((nowMs < endMs) && !failed) {
+            nowMs++;
+            Deliver();
+            for (Node &n : nodes) {
+                if (n.alive && ((Local(n) % CONTROL_TICK_MS) == n.tickPhaseMs)) {
+                    Tick(n);
+                }
+            }
+            Fill();
+            for (Node &n : nodes) {
+                uint8_t frame[COORD_FRAME_LEN];
+                uint8_t length = n.alive ? n.board->coord.Poll(Local(n), frame) : 0;
+                if (length > 0) {
+                    Transmit(n, frame, length);
+                }
+            }
+            /** Noise keeps the bus from settling while it lasts */
+            if (noise > 0) {
+                changeMs = nowMs;
+            }
+            Check();
+        }
+    }
+
+    std::mt19937_64 &Rng() {
+        return rng;
+    }
+
+    void PrintStats() {
+        printf("  %u frames, %u corrupted, %u collisions after a lost frame, %u faults acknowledged\n", frames,
+               corrupted, collisions, faultsCleared);
+    }
+};
+
+/* Runs a phase of the scenario and reports it */
+static bool Phase(Simulation &sim, const char *name, uint64_t durationMs) {
+    sim.Run(durationMs);
+    if (!sim.failed) {
+        printf("  %-46s ok\n", name);
+    } else {
+        printf("  in phase: %s\n", name);
+    }
+    return !sim.failed;
+}
+
+/**
+ * Scripted scenario: every step is followed by enough time for the bus and the pumps to settle,
+ * so the steady state checks run at the end of each phase.
+ */
+static bool Scripted(uint8_t count, uint64_t seed) {
+    Simulation sim(count, seed);
+    uint64_t settle = PUMPS_SETTLE_MS + TARGET_GRACE_MS;
+    printf("%u nodes, scripted\n", count);
+
+    for (uint8_t id = 1; id <= count; id++) {
+        sim.Revive(id);
+        sim.Run(sim.Rng()() % 500);
+    }
+    if (!Phase(sim, "boot, lowest id elected", settle)) return false;
+
+    sim.Kill(1);
+    if (!Phase(sim, "coordinator killed, next id elected", settle)) return false;
+    sim.Revive(1);
+    if (!Phase(sim, "coordinator revived, elected again", settle)) return false;
+
+    uint8_t last = count;
+    sim.KillTokenReceiver(last);
+    if (!Phase(sim, "token receiver killed, skipped", settle)) return false;
+    sim.Revive(last);
+    if (!Phase(sim, "token receiver revived", settle)) return false;
+
+    sim.KillInFrame(1);
+    if (!Phase(sim, "token lost in a cut frame, regenerated", settle)) return false;
+    sim.Revive(1);
+    if (!Phase(sim, "board revived", settle)) return false;
+
+    sim.SetNoise(0.1);
+    if (!Phase(sim, "10 % of the frames corrupted", 60000)) return false;
+    sim.SetNoise(0);
+    if (!Phase(sim, "noise ended", settle)) return false;
+
+    sim.SetWellEmpty(1, true);
+    if (!Phase(sim, "well of the coordinator dry, pumps reassigned", settle)) return false;
+    sim.SetWellEmpty(1, false);
+    if (!Phase(sim, "well recovered", settle)) return false;
+
+    sim.SetCisternEmpty(false);
+    if (!Phase(sim, "cistern full, all pumps stopped", settle)) return false;
+    sim.SetCisternEmpty(true);
+    if (!Phase(sim, "cistern empty again", settle)) return false;
+
+    /** The pumps of the last board stay off while the others fill the cistern, it must not take the
+     *  cistern full for a sensor fault and drop out of the coordination */
+    sim.SetWellEmpty(count, true);
+    if (!Phase(sim, "well of the last board dry", settle + PLAUSIBILITY_PUMP_SETTLE_MS)) return false;
+    sim.SetCisternEmpty(false);
+    if (!Phase(sim, "cistern filled by the other boards", settle)) return false;
+    sim.SetWellEmpty(count, false);
+    sim.SetCisternEmpty(true);
+    if (!Phase(sim, "last board back in the rotation", settle)) return false;
+
+    for (uint8_t id = 2; id <= count; id++) {
+        sim.Kill(id);
+    }
+    if (!Phase(sim, "alone on the bus", settle)) return false;
+    for (uint8_t id = 2; id <= count; id++) {
+        sim.Revive(id);
+    }
+    if (!Phase(sim, "all boards back", settle)) return false;
+    sim.PrintStats();
+    return true;
+}
+
+/**
+ * Random events, several a minute: boards die, die in the middle of a frame or come back, line
+ * noise bursts, wells run dry and water is drawn from the cistern, which the running pumps fill
+ * again. The continuous checks run all along, the steady state ones whenever no event happened
+ * for long enough.
+ */
+static bool Random(uint8_t count, uint64_t minutes, uint64_t seed) {
+    Simulation sim(count, seed);
+    std::mt19937_64 &rng = sim.Rng();
+    printf("%u nodes, %llu random minutes\n", count, (unsigned long long)minutes);
+
+    for (uint8_t id = 1; id <= count; id++) {
+        sim.Revive(id);
+    }
+    sim.DrawCistern(60000 + rng() % 600000);
+    uint64_t endMs = minutes * 60000ULL;
+    while ((sim.Now() < endMs) && !sim.failed) {
+        uint8_t id = 1 + rng() % count;
+        switch (rng() % 10) {
+            case 0: sim.Kill(id); break;
+            case 1: sim.KillInFrame(id); break;
+            case 2: sim.KillTokenReceiver(id); break;
+            case 3: sim.SetNoise(0.05); break;
+            case 4: sim.SetWellEmpty(id, rng() % 2); break;
+            case 5: sim.DrawCistern(60000 + rng() % 600000); break;
+            default: sim.Revive(id); break;
+        }
+        sim.Run(1000 + rng() % 20000);
+        sim.SetNoise(0);
+        /** Sometimes long enough without events for the steady state checks */
+        if (rng() % 4 == 0) {
+            sim.Run(PUMPS_SETTLE_MS + TARGET_GRACE_MS);
+        }
+    }
+    if (sim.failed) {
+        printf("  seed %llu\n", (unsigned long long)seed);
+        return false;
+    }
+    printf("  ok\n");
+    sim.PrintStats();
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint8_t nodesMax = COORD_MAX_NODES;
+    uint64_t minutes = 600;
+    uint64_t seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        unsigned long long value = strtoull(argv[i + 1], nullptr, 10);
+        if (opt == "--nodes") {
+            nodesMax = (uint8_t)constrain(value, 2ULL, (unsigned long long)COORD_MAX_NODES);
+        } else if (opt == "--minutes") {
+            minutes = value;
+        } else if (opt == "--seed") {
+            seed = value;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    bool pass = true;
+    for (uint8_t count = 2; (count <= nodesMax) && pass; count++) {
+        pass = Scripted(count, seed + count) && Random(count, minutes, seed * 1000003ULL + count);
+    }
+    printf(pass ? "PASS\n" : "FAIL\n");
+    return pass ? 0 : 1;
+}
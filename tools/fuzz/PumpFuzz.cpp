@@ -0,0 +1,461 @@
+/*
+ * Property-based fuzzer of the pump safety invariants, run on a PC.
+ *
+ * A trace of well and cistern levels, button presses, faults, schedule and coordinator states,
+ * cistern top-up requests and time steps is played into the real PumpControl, WellRecovery, DemandBoost and PumpStats
+ * classes, in the call order of the control tick of main.cpp, and the pump outputs are checked
+ * after every tick. The first trace that breaks an invariant is shrunk and printed step by step.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++17 -O2 -pthread -Itools/host -Iinclude tools/fuzz/PumpFuzz.cpp \
+ *       src/DAL/PumpControl.cpp src/DAL/WellRecovery.cpp src/DAL/DemandBoost.cpp src/DAL/PumpStats.cpp \
+ *       src/DAL/utilities.cpp -o pump_fuzz
+ * Run:
+ *   ./pump_fuzz [--seconds N] [--steps N] [--threads N] [--seed N] [--out file] [--replay file]
+ *
+ * Coverage guided with libFuzzer instead of the random traces, libFuzzer minimizes the crash itself:
+ *   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -DPUMP_FUZZ_LIBFUZZER -Itools/host -Iinclude \
+ *       tools/fuzz/PumpFuzz.cpp src/DAL/PumpControl.cpp src/DAL/WellRecovery.cpp src/DAL/DemandBoost.cpp \
+ *       src/DAL/PumpStats.cpp src/DAL/utilities.cpp -o pump_libfuzzer
+ *   ./pump_libfuzzer -max_len=4096
+ * Both builds read the same input format, a crash file of libFuzzer is printed with --replay.
+ */
+
+#include <Arduino.h>
+#include "PumpControl.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define CONTROL_TICK_MS  (200UL)  /* LOOP_RATE_ACTIVE_CONTROL_MS, the shortest time between two ticks */
+
+/* Input: a header, then one step of three bytes per control tick */
+#define HDR_BUDGET1      (0)      /* Index in CycleBudgetsMs of the pump 1 cycle time */
+#define HDR_BUDGET2      (1)      /* Index in CycleBudgetsMs of the pump 2 cycle time */
+#define HDR_START        (2)      /* First tick this many 15 minutes before the millis() rollover, 0 = at power-up */
+#define HDR_SIZE         (3)
+#define STEP_SIZE        (3)
+
+/* First byte of a step */
+#define IN_WELL_EMPTY    (0x01)
+#define IN_CISTERN_EMPTY (0x02)
+#define IN_MODE_BUTTON   (0x04)
+#define IN_PUMP_BUTTON   (0x08)
+#define IN_FAULT         (0x10)
+#define IN_SCHED_BLOCKED (0x20)
+#define IN_COORDINATED   (0x40)
+#define IN_UI_WRITE      (0x80)   /* The display or Modbus writes an automatic mode before the tick */
+
+/* Second byte of a step */
+#define IN_ASSIGNED_MASK (0x03)   /* Pumps assigned by the coordinator */
+#define IN_UI_TIMER      (0x04)   /* Mode written by IN_UI_WRITE, timer or sensors */
+#define IN_DT_SCALE_POS  (3)      /* Time since the last tick: DtScaleMs[scale] * (1 + mult) */
+#define IN_DT_MULT_POS   (6)
+
+/* Third byte of a step */
+#define IN_PREFILL       (0x01)   /* Cistern below the top-up target ahead of a demand peak */
+
+static const uint32_t CycleBudgetsMs[8] = {0, 15000, 30000, 60000, 300000, 1800000, 3600000, 28800000};
+static const uint32_t DtScaleMs[8] = {CONTROL_TICK_MS, 1000, 5000, 15000, 60000, 300000, 1800000, 14400000};
+
+struct Failure {
+    bool failed = false;
+    size_t step = 0;
+    const char *invariant = "";
+};
+
+/* Pump outputs as seen by the motors, kept by the harness independently of the well recovery */
+struct PumpHistory {
+    bool on = false;
+    bool everStopped = false;
+    uint32_t stopMs = 0;
+};
+
+static const char *ModeName(CtrlModeSel_t mode) {
+    switch (mode) {
+        case CTRL_AUTO_BY_SENSORS: return "sensors";
+        case CTRL_MODE_MANUAL:     return "manual ";
+        case CTRL_AUTO_BY_TIMER:   return "timer  ";
+        default:                   return "unknown";
+    }
+}
+
+/**
+ * Plays a trace into a new controller and checks the invariants after every tick.
+ * @param print Prints every tick, for a counterexample.
+ * @return The first broken invariant, if any.
+ */
+static Failure Run(const uint8_t *data, size_t size, bool print) {
+    Failure failure;
+    if (size < HDR_SIZE) {
+        return failure;
+    }
+
+    WellRecovery wellRecovery;
+    PumpStats pumpStats;
+    DemandBoost demandBoost;
+    PumpControl control(wellRecovery, demandBoost, pumpStats);
+
+    const uint32_t budgets[PUMP_CONTROL_NUM_PUMPS] = {CycleBudgetsMs[data[HDR_BUDGET1] & 0x07],
+                                                      CycleBudgetsMs[data[HDR_BUDGET2] & 0x07]};
+    const uint32_t startMs = (uint32_t)(0 - (uint32_t)data[HDR_START] * 900000UL);
+    uint32_t now = startMs;
+    CtrlModeSel_t mode = CTRL_AUTO_BY_SENSORS;
+    PumpHistory pumps[PUMP_CONTROL_NUM_PUMPS];
+    bool everStarted = false;
+    uint32_t lastStartMs = 0;
+    bool topUpDone = false;       /* A pump ran with the cistern full since it last read empty */
+    uint32_t topUpStartMs = 0;
+
+    if (print) {
+        printf("cycle times %lu ms / %lu ms, first tick at millis() %lu\n",
+               (unsigned long)budgets[0], (unsigned long)budgets[1], (unsigned long)startMs);
+    }
+
+    size_t steps = (size - HDR_SIZE) / STEP_SIZE;
+    for (size_t n = 0; n < steps; n++) {
+        uint8_t b0 = data[HDR_SIZE + n * STEP_SIZE];
+        uint8_t b1 = data[HDR_SIZE + n * STEP_SIZE + 1];
+        uint8_t b2 = data[HDR_SIZE + n * STEP_SIZE + 2];
+        uint32_t dtMs = DtScaleMs[(b1 >> IN_DT_SCALE_POS) & 0x07] * (1 + (b1 >> IN_DT_MULT_POS));
+        if (n > 0) {
+            now += dtMs;
+        }
+
+        if (b0 & IN_UI_WRITE) {
+            mode = (b1 & IN_UI_TIMER) ? CTRL_AUTO_BY_TIMER : CTRL_AUTO_BY_SENSORS;
+        }
+        mode = control.SelectMode(mode, b0 & IN_MODE_BUTTON);
+
+        PumpControlInputs in;
+        in.wellEmpty = b0 & IN_WELL_EMPTY;
+        in.cisternEmpty = b0 & IN_CISTERN_EMPTY;
+        in.pumpSelButton = b0 & IN_PUMP_BUTTON;
+        in.fault = b0 & IN_FAULT;
+        in.scheduleAllowed = !(b0 & IN_SCHED_BLOCKED);
+        in.coordAssigned = (b0 & IN_COORDINATED) ? (b1 & IN_ASSIGNED_MASK) : PUMP_CONTROL_NOT_COORDINATED;
+        in.prefill = b2 & IN_PREFILL;
+        mode = control.Tick(mode, in, budgets, now);
+
+        bool autoMode = (mode != CTRL_MODE_MANUAL);
+        /** Only the sensors mode tops up, for itself, once per float cycle and for a bounded time */
+        if (in.cisternEmpty) {
+            topUpDone = false;
+        } else if ((control.isPumpOn(0) || control.isPumpOn(1)) && !topUpDone) {
+            topUpDone = true;
+            topUpStartMs = now;
+        }
+        bool topUp = in.prefill && (mode == CTRL_AUTO_BY_SENSORS) && (in.coordAssigned == PUMP_CONTROL_NOT_COORDINATED) &&
+                     (now - topUpStartMs < PUMP_PREFILL_MAX_MS);
+        for (uint8_t i = 0; (i < PUMP_CONTROL_NUM_PUMPS) && !failure.failed; i++) {
+            PumpHistory &p = pumps[i];
+            bool on = control.isPumpOn(i);
+            bool started = on && !p.on;
+            const char *broken = nullptr;
+
+            if (on && !in.cisternEmpty && !topUp) {
+                broken = "pump on with the cistern full";
+            } else if (on && in.wellEmpty) {
+                broken = "pump on with the well empty";
+            } else if (on && autoMode && in.fault) {
+                broken = "automatic mode pump on with a fault latched";
+            } else if (on && autoMode && !in.scheduleAllowed) {
+                broken = "automatic mode pump on outside the schedule";
+            } else if (on && (mode == CTRL_AUTO_BY_SENSORS) && (in.coordAssigned != PUMP_CONTROL_NOT_COORDINATED) &&
+                       !(in.coordAssigned & (1U << i))) {
+                broken = "pump on while not assigned by the coordinator";
+            } else if (on && (mode == CTRL_AUTO_BY_TIMER) && ((budgets[0] == 0) || (budgets[1] == 0))) {
+                broken = "timer mode pump on without cycle times";
+            } else if (started && autoMode && p.everStopped && (now - p.stopMs < WELL_MIN_OFF_TIME_MS)) {
+                broken = "automatic mode pump restarted before the minimum off time";
+            } else if (started && autoMode && everStarted && (now - lastStartMs < PUMP_START_STAGGER_MS)) {
+                broken = "automatic mode pump starts not staggered";
+            }
+
+            if (started) {
+                lastStartMs = now;
+                everStarted = true;
+            } else if (!on && p.on) {
+                p.stopMs = now;
+                p.everStopped = true;
+            }
+            p.on = on;
+
+            if (broken != nullptr) {
+                failure.failed = true;
+                failure.step = n;
+                failure.invariant = broken;
+            }
+        }
+
+        if (print) {
+            printf("%4u  t=%10.1f s  %s  well %s  cistern %s%s%s%s%s", (unsigned)n, (now - startMs) / 1000.0,
+                   ModeName(mode), in.wellEmpty ? "empty" : "full ", in.cisternEmpty ? "empty" : "full ",
+                   (b0 & IN_MODE_BUTTON) ? "  mode btn" : "", (b0 & IN_PUMP_BUTTON) ? "  pump btn" : "",
+                   in.fault ? "  fault" : "", in.scheduleAllowed ? "" : "  sched off");
+            if (in.coordAssigned != PUMP_CONTROL_NOT_COORDINATED) {
+                printf("  coord %u", (unsigned)in.coordAssigned);
+            }
+            if (b0 & IN_UI_WRITE) {
+                printf("  ui write");
+            }
+            if (in.prefill) {
+                printf("  top-up");
+            }
+            printf("  ->  P1 %s  P2 %s\n", pumps[0].on ? "ON " : "off", pumps[1].on ? "ON " : "off");
+        }
+        if (failure.failed) {
+            if (print) {
+                printf("invariant broken at step %u: %s\n", (unsigned)failure.step, failure.invariant);
+            }
+            break;
+        }
+    }
+    return failure;
+}
+
+#ifdef PUMP_FUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (Run(data, size, false).failed) {
+        Run(data, size, true);
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+/* Input levels persist over many ticks and buttons are short presses, so the traces reach the
+ * fill, pause and alternation states instead of flickering every tick */
+static std::vector<uint8_t> RandomTrace(std::mt19937_64 &rng, size_t steps) {
+    auto chance = [&rng](uint32_t perMille) { return (rng() % 1000) < perMille; };
+    static const uint16_t ScaleWeights[8] = {600, 150, 100, 50, 50, 30, 15, 5};
+
+    std::vector<uint8_t> trace(HDR_SIZE + steps * STEP_SIZE);
+    trace[HDR_BUDGET1] = chance(100) ? 0 : (uint8_t)(rng() % 8);
+    trace[HDR_BUDGET2] = chance(100) ? 0 : (uint8_t)(rng() % 8);
+    trace[HDR_START] = chance(500) ? 0 : (uint8_t)rng();
+
+    uint8_t levels = IN_CISTERN_EMPTY;
+    uint8_t assigned = 0;
+    bool uiTimer = false;
+    uint8_t prefill = 0;
+    for (size_t n = 0; n < steps; n++) {
+        if (chance(40)) levels ^= IN_WELL_EMPTY;
+        if (chance(50)) levels ^= IN_CISTERN_EMPTY;
+        if (chance(5)) levels ^= IN_FAULT;
+        if (chance(10)) levels ^= IN_SCHED_BLOCKED;
+        if (chance(10)) levels ^= IN_COORDINATED;
+        if (chance(50)) assigned = (uint8_t)(rng() & IN_ASSIGNED_MASK);
+        if (chance(5)) uiTimer = !uiTimer;
+        if (chance(20)) prefill ^= IN_PREFILL;
+
+        uint8_t b0 = levels;
+        if (chance(20)) b0 |= IN_MODE_BUTTON;
+        if (chance(20)) b0 |= IN_PUMP_BUTTON;
+        if (chance(5)) b0 |= IN_UI_WRITE;
+
+        uint32_t pick = rng() % 1000;
+        uint8_t scale = 0;
+        while ((scale < 7) && (pick >= ScaleWeights[scale])) {
+            pick -= ScaleWeights[scale];
+            scale++;
+        }
+        uint8_t b1 = assigned | (uiTimer ? IN_UI_TIMER : 0) | (scale << IN_DT_SCALE_POS) |
+                     ((uint8_t)(rng() & 0x03) << IN_DT_MULT_POS);
+
+        trace[HDR_SIZE + n * STEP_SIZE] = b0;
+        trace[HDR_SIZE + n * STEP_SIZE + 1] = b1;
+        trace[HDR_SIZE + n * STEP_SIZE + 2] = prefill;
+    }
+    return trace;
+}
+
+static bool BreaksSame(const std::vector<uint8_t> &trace, const char *invariant) {
+    Failure f = Run(trace.data(), trace.size(), false);
+    return f.failed && (strcmp(f.invariant, invariant) == 0);
+}
+
+/**
+ * Shrinks a failing trace while it breaks the same invariant: drops the steps after the failure,
+ * then removes chunks of steps of halving size, then clears the inputs and shortens the time
+ * steps one at a time, until nothing else can be removed.
+ */
+static std::vector<uint8_t> Shrink(std::vector<uint8_t> trace) {
+    Failure f = Run(trace.data(), trace.size(), false);
+    const char *invariant = f.invariant;
+    trace.resize(HDR_SIZE + (f.step + 1) * STEP_SIZE);
+
+    bool progress = true;
+    while (progress) {
+        progress = false;
+
+        for (size_t chunk = (trace.size() - HDR_SIZE) / STEP_SIZE / 2; chunk >= 1; chunk /= 2) {
+            size_t i = 0;
+            while (HDR_SIZE + (i + chunk) * STEP_SIZE <= trace.size()) {
+                std::vector<uint8_t> candidate(trace);
+                candidate.erase(candidate.begin() + HDR_SIZE + i * STEP_SIZE,
+                                candidate.begin() + HDR_SIZE + (i + chunk) * STEP_SIZE);
+                if (BreaksSame(candidate, invariant)) {
+                    trace.swap(candidate);
+                    progress = true;
+                } else {
+                    i++;
+                }
+            }
+        }
+
+        for (size_t pos = 0; pos < trace.size(); pos++) {
+            bool stepByte = (pos >= HDR_SIZE);
+            for (uint8_t bit = 0x80; bit != 0; bit >>= 1) {
+                if (!(trace[pos] & bit)) {
+                    continue;
+                }
+                /** Clear a bit, or for the time step of a tick, lower its scale or multiplier */
+                std::vector<uint8_t> candidate(trace);
+                candidate[pos] &= (uint8_t)~bit;
+                if (stepByte && ((pos - HDR_SIZE) % STEP_SIZE == 1) && (bit >= (1U << IN_DT_SCALE_POS))) {
+                    if (bit >= (1U << IN_DT_MULT_POS)) {
+                        candidate[pos] = trace[pos] - (1U << IN_DT_MULT_POS);
+                    } else {
+                        candidate[pos] = trace[pos] - (1U << IN_DT_SCALE_POS);
+                    }
+                }
+                if (BreaksSame(candidate, invariant)) {
+                    trace.swap(candidate);
+                    progress = true;
+                }
+            }
+        }
+    }
+    return trace;
+}
+
+static bool ReadFile(const char *path, std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool WriteFile(const char *path, const std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    bool ok = (fwrite(data.data(), 1, data.size(), f) == data.size());
+    fclose(f);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    double seconds = 10;
+    size_t steps = 2000;
+    unsigned threads = std::thread::hardware_concurrency();
+    uint64_t seed = 1;
+    const char *outPath = nullptr;
+    const char *replayPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+        if (!strcmp(argv[i], "--seconds") && hasValue) {
+            seconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--steps") && hasValue) {
+            steps = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--threads") && hasValue) {
+            threads = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--seed") && hasValue) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--out") && hasValue) {
+            outPath = argv[++i];
+        } else if (!strcmp(argv[i], "--replay") && hasValue) {
+            replayPath = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--seconds N] [--steps N] [--threads N] [--seed N] [--out file] [--replay file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (replayPath != nullptr) {
+        std::vector<uint8_t> trace;
+        if (!ReadFile(replayPath, trace)) {
+            fprintf(stderr, "cannot read %s\n", replayPath);
+            return 2;
+        }
+        return Run(trace.data(), trace.size(), true).failed ? 1 : 0;
+    }
+
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (steps == 0) {
+        steps = 1;
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> traceCount(0);
+    std::atomic<uint64_t> tickCount(0);
+    std::mutex failMutex;
+    std::vector<uint8_t> failing;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threads; w++) {
+        workers.emplace_back([&, w]() {
+            std::mt19937_64 rng(seed * 0x9E3779B97F4A7C15ULL + w);
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::vector<uint8_t> trace = RandomTrace(rng, steps);
+                Failure f = Run(trace.data(), trace.size(), false);
+                traceCount.fetch_add(1, std::memory_order_relaxed);
+                tickCount.fetch_add(f.failed ? f.step + 1 : steps, std::memory_order_relaxed);
+                if (f.failed) {
+                    std::lock_guard<std::mutex> lock(failMutex);
+                    if (failing.empty()) {
+                        failing = trace;
+                    }
+                    stop = true;
+                }
+            }
+        });
+    }
+    while (!stop && (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stop = true;
+    for (std::thread &t : workers) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%llu traces, %llu ticks in %.1f s on %u threads, %.1f M ticks/s\n",
+           (unsigned long long)traceCount.load(), (unsigned long long)tickCount.load(), elapsed, threads,
+           tickCount.load() / elapsed / 1e6);
+
+    if (failing.empty()) {
+        printf("no invariant broken\n");
+        return 0;
+    }
+
+    std::vector<uint8_t> shrunk = Shrink(failing);
+    printf("counterexample, shrunk from %u to %u ticks:\n", (unsigned)((failing.size() - HDR_SIZE) / STEP_SIZE),
+           (unsigned)((shrunk.size() - HDR_SIZE) / STEP_SIZE));
+    Run(shrunk.data(), shrunk.size(), true);
+    if ((outPath != nullptr) && !WriteFile(outPath, shrunk)) {
+        fprintf(stderr, "cannot write %s\n", outPath);
+    }
+    return 1;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/* The part of the Arduino API used by the portable DAL classes, so the host tools can build
+ * them unchanged on a PC. The log goes nowhere, the tools report their own results */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+#define HEX (16)
+#define DEC (10)
+
+typedef uint8_t byte;
+
+/* Flash strings are plain strings on a PC */
+#define F(s) (s)
+
+/* Milliseconds since power-up, defined by the tools that build modules reading the time */
+unsigned long millis();
+
+class String
+{
+private:
+    std::string text;
+public:
+    String(const char *s = "") : text(s) {}
+    String(const std::string &s) : text(s) {}
+    String(char c) : text(1, c) {}
+    template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+    String(T value, int base = DEC) {
+        char buf[24];
+        if (base == HEX) {
+            snprintf(buf, sizeof(buf), "%llX", (unsigned long long)value);
+        } else if (std::is_signed<T>::value) {
+            snprintf(buf, sizeof(buf), "%lld", (long long)value);
+        } else {
+            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
+        }
+        text = buf;
+    }
+    String(double value, int decimals = 2) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+        text = buf;
+    }
+    String &operator+=(const String &other) { text += other.text; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a.text + b.text); }
+    friend String operator+(const String &a, const char *b) { return String(a.text + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.text); }
+    const char *c_str() const { return text.c_str(); }
+    size_t length() const { return text.length(); }
+};
+
+class HostSerial
+{
+public:
+    template <typename T> size_t print(const T &) { return 0; }
+    template <typename T> size_t println(const T &) { return 0; }
+};
+inline HostSerial Serial;
+
+template <typename A, typename B>
+inline typename std::common_type<A, B>::type min(A a, B b) { return (b < a) ? b : a; }
+template <typename A, typename B>
+inline typename std::common_type<A, B>::type max(A a, B b) { return (a < b) ? b : a; }
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+#endif
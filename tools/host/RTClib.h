@@ -0,0 +1,96 @@
+#ifndef HOST_RTCLIB_H
+#define HOST_RTCLIB_H
+
+/* The part of RTClib used by the firmware, so the host tools can build the DAL classes and the
+ * RealTimeClock wrapper on a PC. The DS3231 keeps the time set last, it does not run */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum Ds3231SqwPinMode { DS3231_OFF = 0x1C };
+enum Ds3231Alarm1Mode { DS3231_A1_Day = 0x10 };
+
+class TimeSpan
+{
+private:
+    int32_t secs;
+public:
+    TimeSpan(int32_t seconds = 0) : secs(seconds) {}
+    int32_t totalseconds() const { return secs; }
+};
+
+class DateTime
+{
+private:
+    uint16_t y;
+    uint8_t m, d, hh, mm, ss;
+
+    /* Days since 1970-01-01 of a proleptic Gregorian date */
+    static int32_t DaysFromCivil(int32_t year, uint8_t month, uint8_t day) {
+        year -= (month <= 2);
+        int32_t era = (year >= 0 ? year : year - 399) / 400;
+        uint32_t yoe = (uint32_t)(year - era * 400);
+        uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + (int32_t)doe - 719468;
+    }
+public:
+    DateTime(uint32_t t = 946684800UL) {
+        int32_t z = (int32_t)(t / 86400UL) + 719468;
+        uint32_t secOfDay = t % 86400UL;
+        int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+        uint32_t doe = (uint32_t)(z - era * 146097);
+        uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        uint32_t mp = (5 * doy + 2) / 153;
+        d = (uint8_t)(doy - (153 * mp + 2) / 5 + 1);
+        m = (uint8_t)(mp < 10 ? mp + 3 : mp - 9);
+        y = (uint16_t)(yoe + era * 400 + (m <= 2));
+        hh = secOfDay / 3600;
+        mm = secOfDay / 60 % 60;
+        ss = secOfDay % 60;
+    }
+    DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0)
+        : y(year), m(month), d(day), hh(hour), mm(min), ss(sec) {}
+    /* __DATE__ "Mmm dd yyyy" and __TIME__ "hh:mm:ss" */
+    DateTime(const char *date, const char *time) {
+        static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        m = 1;
+        while ((m < 12) && (strncmp(months + (m - 1) * 3, date, 3) != 0)) {
+            m++;
+        }
+        d = (uint8_t)atoi(date + 4);
+        y = (uint16_t)atoi(date + 7);
+        hh = (uint8_t)atoi(time);
+        mm = (uint8_t)atoi(time + 3);
+        ss = (uint8_t)atoi(time + 6);
+    }
+    uint16_t year() const { return y; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+    uint8_t dayOfTheWeek() const { return (uint8_t)((DaysFromCivil(y, m, d) + 4) % 7); }
+    uint32_t unixtime() const { return (uint32_t)DaysFromCivil(y, m, d) * 86400UL + hh * 3600UL + mm * 60UL + ss; }
+    DateTime operator+(const TimeSpan &span) const { return DateTime(unixtime() + span.totalseconds()); }
+    DateTime operator-(const TimeSpan &span) const { return DateTime(unixtime() - span.totalseconds()); }
+};
+
+class RTC_DS3231
+{
+private:
+    DateTime time;
+public:
+    bool begin() { return true; }
+    bool lostPower() { return false; }
+    DateTime now() { return time; }
+    void adjust(const DateTime &dt) { time = dt; }
+    void writeSqwPinMode(Ds3231SqwPinMode) {}
+    void disableAlarm(uint8_t) {}
+    void clearAlarm(uint8_t) {}
+    bool setAlarm1(const DateTime &, Ds3231Alarm1Mode) { return true; }
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+/* Only the declarations of the I2C drivers are built on a PC, the bus is never used.
+ * BUFFER_LENGTH is left undefined so the drivers fall back to the AVR buffer size */
+
+class TwoWire
+{
+};
+inline TwoWire Wire;
+
+#endif
@@ -0,0 +1,475 @@
+/*
+ * Host check of the Modbus RTU slave frame handling, run on a PC.
+ *
+ * Request frames are fed to the real ModbusRtu_HandleFrame, as ProcessModbus() of main.cpp does
+ * with a frame received by the UART, against a register map held in arrays. Every response is
+ * compared byte for byte with the expected frame, CRC included, and the register image, the
+ * write calls and the commits are checked after every request. Covered:
+ *   - 0x03 and 0x04 reads, up to the longest response, past the end of the map, bad quantities;
+ *   - 0x06 writes, valid, out of range and past the end of the map;
+ *   - 0x10 writes, valid, and rejected on a value, an address, a quantity or a byte count, in
+ *     which case no register is written and nothing is committed;
+ *   - bad CRC, every single bit error of a request, short frames, another slave address,
+ *     broadcast writes without response and an unsupported function code;
+ *   - the receive timing of ModbusUart.cpp at every baud rate from 9600 to 115200: frames sent
+ *     with the longest gap allowed inside a frame (t1.5) and only t3.5 apart, with the receive
+ *     interrupt delayed by up to ISR_LATENCY_US, must come out with their length, none dropped,
+ *     split or merged, without an overrun, and the baud rate error must stay within MAX_BAUD_ERROR.
+ * The first difference is printed with both frames and the exit code is 1.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++17 -O2 -Iinclude tools/modbus/ModbusCheck.cpp src/DAL/ModbusRtu.cpp -o modbus_check
+ * Run:
+ *   ./modbus_check [--verbose 1]
+ */
+
+#include "ModbusRtu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#define SLAVE_ADDR     (1)        /* MODBUS_SLAVE_ADDR */
+#define NUM_HOLDING    (32)       /* More than a write request holds, so its limit is reached */
+#define NUM_INPUT      (40)       /* More than a read response holds */
+#define READ_MAX       ((MODBUS_FRAME_MAX - 5) / 2)
+#define WRITE_MAX      ((MODBUS_FRAME_MAX - 9) / 2)
+#define HOLDING_LIMIT  (59)       /* Largest value accepted by the holding registers, like a cycle time */
+
+#define CPU_HZ         (16000000UL)
+#define TIMER_TICK_US  (16)       /* MODBUS_UART_TIMER_TICK_US */
+#define ISR_LATENCY_US (50)       /* Longest wait of the receive interrupt behind the other interrupts and the atomic sections */
+#define MAX_BAUD_ERROR (0.025)    /* Half of the about 4.5 % the USART receiver tolerates, the rest is left to the master */
+
+typedef std::vector<uint8_t> Frame;
+
+/* Register image and the calls made by the frame handling */
+static uint16_t holding[NUM_HOLDING];
+static uint16_t input[NUM_INPUT];
+static unsigned writeCalls = 0;
+static unsigned commitCalls = 0;
+static bool verbose = false;
+static bool failed = false;
+
+static uint16_t ReadHolding(uint16_t addr) {
+    return holding[addr];
+}
+
+static uint16_t ReadInput(uint16_t addr) {
+    return input[addr];
+}
+
+static uint8_t ValidateHolding(uint16_t, uint16_t value) {
+    return (value <= HOLDING_LIMIT) ? MODBUS_EX_NONE : MODBUS_EX_ILLEGAL_VALUE;
+}
+
+static void WriteHolding(uint16_t addr, uint16_t value) {
+    holding[addr] = value;
+    writeCalls++;
+}
+
+static void CommitWrites(void) {
+    commitCalls++;
+}
+
+static const ModbusRegisterMap registers = {
+    NUM_HOLDING,
+    NUM_INPUT,
+    ReadHolding,
+    ReadInput,
+    ValidateHolding,
+    WriteHolding,
+    CommitWrites
+};
+
+/* Fills the registers with values that differ from each other and from the ones written */
+static void Reset() {
+    for (uint16_t i = 0; i < NUM_HOLDING; i++) {
+        holding[i] = i % (HOLDING_LIMIT + 1);
+    }
+    for (uint16_t i = 0; i < NUM_INPUT; i++) {
+        input[i] = (uint16_t)(0xA000 + i * 0x0101);
+    }
+    writeCalls = 0;
+    commitCalls = 0;
+}
+
+static std::string Hex(const Frame &frame) {
+    std::string text;
+    char byte[4];
+    for (uint8_t b : frame) {
+        snprintf(byte, sizeof(byte), "%02X ", b);
+        text += byte;
+    }
+    return text.empty() ? "(none)" : text.substr(0, text.size() - 1);
+}
+
+/* Appends the CRC, low byte first */
+static Frame WithCrc(Frame frame) {
+    uint16_t crc = ModbusRtu_Crc16(frame.data(), (uint16_t)frame.size());
+    frame.push_back(crc & 0xFF);
+    frame.push_back(crc >> 8);
+    return frame;
+}
+
+static void PutU16(Frame &frame, uint16_t value) {
+    frame.push_back(value >> 8);
+    frame.push_back(value & 0xFF);
+}
+
+static Frame Read(uint8_t addr, uint8_t function, uint16_t start, uint16_t quantity) {
+    Frame frame = {addr, function};
+    PutU16(frame, start);
+    PutU16(frame, quantity);
+    return WithCrc(frame);
+}
+
+static Frame WriteSingle(uint8_t addr, uint16_t reg, uint16_t value) {
+    Frame frame = {addr, MODBUS_FC_WRITE_SINGLE};
+    PutU16(frame, reg);
+    PutU16(frame, value);
+    return WithCrc(frame);
+}
+
+static Frame WriteMulti(uint8_t addr, uint16_t start, const std::vector<uint16_t> &values) {
+    Frame frame = {addr, MODBUS_FC_WRITE_MULTI};
+    PutU16(frame, start);
+    PutU16(frame, (uint16_t)values.size());
+    frame.push_back((uint8_t)(values.size() * 2));
+    for (uint16_t value : values) {
+        PutU16(frame, value);
+    }
+    return WithCrc(frame);
+}
+
+static Frame Exception(uint8_t function, uint8_t exception) {
+    return WithCrc({SLAVE_ADDR, (uint8_t)(function | 0x80), exception});
+}
+
+static Frame Handle(const Frame &request) {
+    uint8_t response[MODBUS_FRAME_MAX];
+    memset(response, 0xEE, sizeof(response));
+    uint8_t length = ModbusRtu_HandleFrame(SLAVE_ADDR, registers, request.data(), (uint8_t)request.size(), response);
+    Frame frame(response, response + length);
+    if (verbose) {
+        printf("    > %s\n    < %s\n", Hex(request).c_str(), Hex(frame).c_str());
+    }
+    return frame;
+}
+
+static bool Check(bool condition, const std::string &what) {
+    if (!condition && !failed) {
+        failed = true;
+        printf("FAIL: %s\n", what.c_str());
+    }
+    return condition;
+}
+
+/* Sends a request and checks the response, and that the registers and the calls match */
+static bool Expect(const Frame &request, const Frame &response, const uint16_t expectedHolding[NUM_HOLDING],
+                   unsigned expectedWrites, unsigned expectedCommits) {
+    Frame actual = Handle(request);
+    bool ok = Check(actual == response, "request " + Hex(request) + "\n  response " + Hex(actual) +
+                                        "\n  expected " + Hex(response));
+    for (uint16_t i = 0; ok && (i < NUM_HOLDING); i++) {
+        ok = Check(holding[i] == expectedHolding[i], "request " + Hex(request) + "\n  holding register " +
+                   std::to_string(i) + " is " + std::to_string(holding[i]) + ", expected " +
+                   std::to_string(expectedHolding[i]));
+    }
+    ok = ok && Check(writeCalls == expectedWrites, "request " + Hex(request) + "\n  " + std::to_string(writeCalls) +
+                     " registers written, expected " + std::to_string(expectedWrites));
+    ok = ok && Check(commitCalls == expectedCommits, "request " + Hex(request) + "\n  " + std::to_string(commitCalls) +
+                     " commits, expected " + std::to_string(expectedCommits));
+    return ok;
+}
+
+/* Sends a request that must leave everything unchanged */
+static bool ExpectUnchanged(const Frame &request, const Frame &response) {
+    uint16_t before[NUM_HOLDING];
+    memcpy(before, holding, sizeof(before));
+    return Expect(request, response, before, writeCalls, commitCalls);
+}
+
+static Frame ReadResponse(uint8_t function, uint16_t start, uint16_t quantity) {
+    Frame frame = {SLAVE_ADDR, function, (uint8_t)(quantity * 2)};
+    for (uint16_t i = 0; i < quantity; i++) {
+        PutU16(frame, (function == MODBUS_FC_READ_HOLDING) ? holding[start + i] : input[start + i]);
+    }
+    return WithCrc(frame);
+}
+
+static void Section(const char *name, bool ok) {
+    printf("  %-52s %s\n", name, ok ? "ok" : "FAIL");
+}
+
+static bool ReadRegisters() {
+    bool ok = true;
+    for (uint8_t function : {MODBUS_FC_READ_HOLDING, MODBUS_FC_READ_INPUT}) {
+        uint16_t count = (function == MODBUS_FC_READ_HOLDING) ? NUM_HOLDING : NUM_INPUT;
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, 0, 1), ReadResponse(function, 0, 1));
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, 3, 5), ReadResponse(function, 3, 5));
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, count - READ_MAX, READ_MAX),
+                                   ReadResponse(function, count - READ_MAX, READ_MAX));
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, count - 1, 1), ReadResponse(function, count - 1, 1));
+        /** Past the end of the map, also through an overflow of the 16-bit address */
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, count - 1, 2), Exception(function, MODBUS_EX_ILLEGAL_ADDRESS));
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, count, 1), Exception(function, MODBUS_EX_ILLEGAL_ADDRESS));
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, 0xFFFF, 2), Exception(function, MODBUS_EX_ILLEGAL_ADDRESS));
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, 0, 0), Exception(function, MODBUS_EX_ILLEGAL_VALUE));
+        ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, function, 0, READ_MAX + 1), Exception(function, MODBUS_EX_ILLEGAL_VALUE));
+        /** A read has a fixed length */
+        Frame longer = Read(SLAVE_ADDR, function, 0, 1);
+        longer.resize(6);
+        longer.push_back(0);
+        ok = ok && ExpectUnchanged(WithCrc(longer), Exception(function, MODBUS_EX_ILLEGAL_VALUE));
+    }
+    return ok;
+}
+
+static bool WriteSingleRegister() {
+    uint16_t expected[NUM_HOLDING];
+    memcpy(expected, holding, sizeof(expected));
+    expected[4] = HOLDING_LIMIT;
+    Frame request = WriteSingle(SLAVE_ADDR, 4, HOLDING_LIMIT);
+    bool ok = Expect(request, request, expected, 1, 1);
+    ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, MODBUS_FC_READ_HOLDING, 4, 1), ReadResponse(MODBUS_FC_READ_HOLDING, 4, 1));
+    ok = ok && ExpectUnchanged(WriteSingle(SLAVE_ADDR, 5, HOLDING_LIMIT + 1),
+                               Exception(MODBUS_FC_WRITE_SINGLE, MODBUS_EX_ILLEGAL_VALUE));
+    ok = ok && ExpectUnchanged(WriteSingle(SLAVE_ADDR, NUM_HOLDING, 0),
+                               Exception(MODBUS_FC_WRITE_SINGLE, MODBUS_EX_ILLEGAL_ADDRESS));
+    return ok;
+}
+
+static bool WriteMultipleRegisters() {
+    std::vector<uint16_t> values;
+    uint16_t expected[NUM_HOLDING];
+    memcpy(expected, holding, sizeof(expected));
+    for (uint16_t i = 0; i < WRITE_MAX; i++) {
+        values.push_back(HOLDING_LIMIT - i);
+        expected[2 + i] = HOLDING_LIMIT - i;
+    }
+    Frame response = {SLAVE_ADDR, MODBUS_FC_WRITE_MULTI};
+    PutU16(response, 2);
+    PutU16(response, WRITE_MAX);
+    /** The whole request is written, then committed once */
+    bool ok = Expect(WriteMulti(SLAVE_ADDR, 2, values), WithCrc(response), expected, WRITE_MAX, 1);
+    ok = ok && ExpectUnchanged(Read(SLAVE_ADDR, MODBUS_FC_READ_HOLDING, 2, WRITE_MAX),
+                               ReadResponse(MODBUS_FC_READ_HOLDING, 2, WRITE_MAX));
+    return ok;
+}
+
+static bool RejectedMultipleWrite() {
+    /** One value out of range, first, in the middle or last, rejects the whole request */
+    bool ok = true;
+    for (uint16_t bad : {0, 1, 2}) {
+        std::vector<uint16_t> values = {1, 2, 3};
+        values[bad] = HOLDING_LIMIT + 1;
+        ok = ok && ExpectUnchanged(WriteMulti(SLAVE_ADDR, 10, values), Exception(MODBUS_FC_WRITE_MULTI, MODBUS_EX_ILLEGAL_VALUE));
+    }
+    std::vector<uint16_t> values(WRITE_MAX, 7);
+    values.back() = 0xFFFF;
+    ok = ok && ExpectUnchanged(WriteMulti(SLAVE_ADDR, 0, values), Exception(MODBUS_FC_WRITE_MULTI, MODBUS_EX_ILLEGAL_VALUE));
+
+    /** Valid values running past the end of the map */
+    ok = ok && ExpectUnchanged(WriteMulti(SLAVE_ADDR, NUM_HOLDING - 2, {1, 2, 3}),
+                               Exception(MODBUS_FC_WRITE_MULTI, MODBUS_EX_ILLEGAL_ADDRESS));
+    ok = ok && ExpectUnchanged(WriteMulti(SLAVE_ADDR, 0xFFFF, {1, 2}),
+                               Exception(MODBUS_FC_WRITE_MULTI, MODBUS_EX_ILLEGAL_ADDRESS));
+
+    /** Bad quantities and byte counts, one register more than the limit does not fit in a frame */
+    ok = ok && ExpectUnchanged(WriteMulti(SLAVE_ADDR, 0, std::vector<uint16_t>(WRITE_MAX + 1, 1)), {});
+    Frame frame = {SLAVE_ADDR, MODBUS_FC_WRITE_MULTI, 0, 0, 0, 0, 0};
+    ok = ok && ExpectUnchanged(WithCrc(frame), Exception(MODBUS_FC_WRITE_MULTI, MODBUS_EX_ILLEGAL_VALUE));
+    frame = {SLAVE_ADDR, MODBUS_FC_WRITE_MULTI, 0, 0, 0, 2, 2, 0, 1, 0, 2};
+    ok = ok && ExpectUnchanged(WithCrc(frame), Exception(MODBUS_FC_WRITE_MULTI, MODBUS_EX_ILLEGAL_VALUE));
+    frame = {SLAVE_ADDR, MODBUS_FC_WRITE_MULTI, 0, 0, 0, 2, 4, 0, 1, 0};
+    ok = ok && ExpectUnchanged(WithCrc(frame), Exception(MODBUS_FC_WRITE_MULTI, MODBUS_EX_ILLEGAL_VALUE));
+    return ok;
+}
+
+static bool BadFrames() {
+    Frame write = WriteMulti(SLAVE_ADDR, 0, {11, 12, 13});
+    Frame read = Read(SLAVE_ADDR, MODBUS_FC_READ_INPUT, 0, 4);
+
+    /** The CRC detects every single bit error, nothing is answered or written */
+    bool ok = true;
+    for (const Frame &request : {write, read}) {
+        for (size_t bit = 0; ok && (bit < request.size() * 8); bit++) {
+            Frame corrupt = request;
+            corrupt[bit / 8] ^= 1U << (bit % 8);
+            ok = ExpectUnchanged(corrupt, {});
+        }
+    }
+    Frame swapped = write;
+    std::swap(swapped[swapped.size() - 2], swapped[swapped.size() - 1]);
+    ok = ok && ExpectUnchanged(swapped, {});
+    Frame truncated(write.begin(), write.end() - 1);
+    ok = ok && ExpectUnchanged(truncated, {});
+
+    /** Too short to hold an address, a function code and a CRC, or longer than a frame */
+    ok = ok && ExpectUnchanged({}, {});
+    ok = ok && ExpectUnchanged(WithCrc({SLAVE_ADDR}), {});
+    Frame tooLong(MODBUS_FRAME_MAX - 1, 0);
+    tooLong[0] = SLAVE_ADDR;
+    tooLong[1] = MODBUS_FC_WRITE_MULTI;
+    ok = ok && ExpectUnchanged(WithCrc(tooLong), {});
+    return ok;
+}
+
+static bool Addressing() {
+    /** Another slave is not answered and nothing is written */
+    bool ok = ExpectUnchanged(WriteSingle(SLAVE_ADDR + 1, 0, 1), {});
+    ok = ok && ExpectUnchanged(Read(247, MODBUS_FC_READ_HOLDING, 0, 1), {});
+
+    /** A broadcast write is executed without a response, a rejected one writes nothing */
+    uint16_t expected[NUM_HOLDING];
+    memcpy(expected, holding, sizeof(expected));
+    expected[0] = 21;
+    expected[1] = 22;
+    ok = ok && Expect(WriteMulti(MODBUS_BROADCAST_ADDR, 0, {21, 22}), {}, expected, writeCalls + 2, commitCalls + 1);
+    expected[3] = 23;
+    ok = ok && Expect(WriteSingle(MODBUS_BROADCAST_ADDR, 3, 23), {}, expected, writeCalls + 1, commitCalls + 1);
+    ok = ok && ExpectUnchanged(WriteMulti(MODBUS_BROADCAST_ADDR, 0, {1, HOLDING_LIMIT + 1}), {});
+    ok = ok && ExpectUnchanged(Read(MODBUS_BROADCAST_ADDR, MODBUS_FC_READ_HOLDING, 0, 1), {});
+
+    /** Unsupported function codes */
+    ok = ok && ExpectUnchanged(WithCrc({SLAVE_ADDR, 0x05, 0, 0, 0xFF, 0}), Exception(0x05, MODBUS_EX_ILLEGAL_FUNCTION));
+    ok = ok && ExpectUnchanged(WithCrc({SLAVE_ADDR, 0x41}), Exception(0x41, MODBUS_EX_ILLEGAL_FUNCTION));
+    return ok;
+}
+
+/* Received frame lengths and the errors of the receiver model */
+struct RxResult {
+    std::vector<unsigned> lengths;
+    bool overrun = false;
+};
+
+/* Receiver of ModbusUart.cpp: each receive interrupt restarts Timer2 from 0 while its prescaler keeps
+ * running, and the compare flag is set at the t35Ticks-th prescaler tick after it. The timer interrupt has
+ * priority over the receive interrupt, so the frame ends if the flag is set before the next receive
+ * interrupt runs, which would clear it. The USART holds 2 received bytes, the third one overruns.
+ * A complete frame is taken at once, as the loop does long before the master sends the next one */
+static RxResult Receive(uint32_t baud, const std::vector<unsigned> &frames, double gapUs, int latencyPattern,
+                        double phaseUs) {
+    double charUs = MODBUS_CHAR_BITS * 1e6 / baud;
+    uint32_t t35Us = ModbusRtu_T35Us(baud);
+    uint32_t t35Ticks = std::min<uint32_t>((t35Us + TIMER_TICK_US - 1) / TIMER_TICK_US, 255);
+    std::vector<double> done;
+    std::vector<bool> last;
+    double t = 0;
+    for (unsigned length : frames) {
+        for (unsigned i = 0; i < length; i++) {
+            t += charUs;
+            done.push_back(t);
+            last.push_back(i + 1 == length);
+            if (i + 1 < length) {
+                t += gapUs;
+            }
+        }
+        t += t35Us;
+    }
+
+    /** Pattern 1 delays every receive interrupt, 2 the last byte of each frame, 3 every other byte */
+    std::vector<double> isr(done.size());
+    for (size_t k = 0; k < done.size(); k++) {
+        double latency = 0;
+        switch (latencyPattern) {
+            case 1: latency = ISR_LATENCY_US; break;
+            case 2: latency = last[k] ? ISR_LATENCY_US : 0; break;
+            case 3: latency = (k & 1) ? ISR_LATENCY_US : 0; break;
+        }
+        isr[k] = std::max(done[k] + latency, (k > 0) ? isr[k - 1] : 0.0);
+    }
+
+    RxResult result;
+    unsigned rxLength = 0;
+    for (size_t k = 0; k < done.size(); k++) {
+        if ((k + 2 < done.size()) && (isr[k] >= done[k + 2])) {
+            result.overrun = true;
+        }
+        rxLength++;
+        double firstTick = phaseUs + (floor((isr[k] - phaseUs) / TIMER_TICK_US) + 1) * TIMER_TICK_US;
+        double flag = firstTick + (t35Ticks - 1) * TIMER_TICK_US;
+        if ((k + 1 == done.size()) || (flag < isr[k + 1])) {
+            result.lengths.push_back(rxLength);
+            rxLength = 0;
+        }
+    }
+    return result;
+}
+
+static bool Timing() {
+    const uint32_t bauds[] = {9600, 19200, 38400, 57600, 115200};
+    const std::vector<unsigned> frames = {8, MODBUS_FRAME_MAX, 8, 9, MODBUS_FRAME_MAX, 8};
+    bool ok = true;
+    for (uint32_t baud : bauds) {
+        /** UBRR of ModbusUart_Begin(), double speed mode */
+        uint32_t ubrr = (CPU_HZ / 8 + baud / 2) / baud - 1;
+        double error = (double)CPU_HZ / 8 / (ubrr + 1) / baud - 1;
+        ok = ok && Check(fabs(error) <= MAX_BAUD_ERROR, std::to_string(baud) + " baud: rate error " +
+                         std::to_string(error * 100) + " %");
+        double t15Us = (baud > 19200) ? MODBUS_FAST_T15_US : 1.5e6 * MODBUS_CHAR_BITS / baud;
+        for (double gapUs : {0.0, t15Us}) {
+            for (int pattern = 0; ok && (pattern < 4); pattern++) {
+                for (double phase = 0; ok && (phase < TIMER_TICK_US); phase += 0.5) {
+                    RxResult rx = Receive(baud, frames, gapUs, pattern, phase);
+                    std::string what = std::to_string(baud) + " baud, gap " + std::to_string((unsigned)gapUs) +
+                                       " us, latency pattern " + std::to_string(pattern) + ", timer phase " +
+                                       std::to_string(phase) + " us";
+                    ok = Check(!rx.overrun, what + ": receive overrun");
+                    ok = ok && Check(rx.lengths == std::vector<unsigned>(frames.begin(), frames.end()),
+                                     what + ": " + std::to_string(rx.lengths.size()) + " frames received instead of " +
+                                     std::to_string(frames.size()));
+                }
+            }
+        }
+        if (verbose) {
+            uint32_t t35Ticks = (ModbusRtu_T35Us(baud) + TIMER_TICK_US - 1) / TIMER_TICK_US;
+            printf("    %6u baud: error %+.2f %%, t3.5 %u us, timer %u-%u us\n", (unsigned)baud, error * 100,
+                   (unsigned)ModbusRtu_T35Us(baud), (unsigned)((t35Ticks - 1) * TIMER_TICK_US),
+                   (unsigned)(t35Ticks * TIMER_TICK_US));
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--verbose") {
+            verbose = (atoi(argv[i + 1]) != 0);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    struct {
+        const char *name;
+        bool (*run)();
+    } sections[] = {
+        {"0x03 / 0x04 read, limits and exceptions", ReadRegisters},
+        {"0x06 write single register", WriteSingleRegister},
+        {"0x10 write multiple registers, one commit", WriteMultipleRegisters},
+        {"0x10 rejected write leaves every register unchanged", RejectedMultipleWrite},
+        {"bad CRC, single bit errors, bad lengths", BadFrames},
+        {"other slave, broadcast, unsupported function", Addressing},
+        {"RTU timing, 9600-115200 baud, no frame lost or split", Timing},
+    };
+    printf("Slave %u, %u holding and %u input registers\n", SLAVE_ADDR, NUM_HOLDING, NUM_INPUT);
+    for (const auto &section : sections) {
+        Reset();
+        bool ok = section.run();
+        Section(section.name, ok);
+        if (!ok) {
+            break;
+        }
+    }
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed ? 1 : 0;
+}
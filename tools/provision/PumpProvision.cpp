@@ -0,0 +1,364 @@
+/*
+ * Provisioning tool of the pump controller, run on a PC connected to the USB serial port of a board.
+ *
+ * A configuration file with the pump cycle times and the pumping windows is sent to the board in
+ * one CRC-checked frame. The board saves it to its EEPROM, the tool reads the stored image back to
+ * verify it, then sets the RTC from the clock of the PC. Text file format, one setting per line:
+ *   pump1_cycle 00:30:00              pump cycle time of the timer mode, hh:mm:ss
+ *   pump2_cycle 00:30:00
+ *   window mon,tue,wed 22:00-06:00    up to 4 weekly pumping windows, days or "all", end before start crosses midnight
+ * Lines starting with # are comments. "read" prints the configuration of a board in the same format.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++17 -O2 -Iinclude tools/provision/PumpProvision.cpp src/DAL/ConfigLink.cpp src/DAL/ModbusRtu.cpp \
+ *       -o pump_provision
+ * Run:
+ *   ./pump_provision PORT [--baud N] provision FILE   write, verify and set the clock
+ *   ./pump_provision PORT [--baud N] write FILE       write and verify
+ *   ./pump_provision PORT [--baud N] read             print the configuration stored on the board
+ *   ./pump_provision PORT [--baud N] time             set the clock
+ *   ./pump_provision check FILE                       parse a file without a board
+ * Opening the port resets a Nano, the tool waits for the start-up before the first request.
+ */
+
+#include "ConfigLink.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#define START_UP_WAIT_MS  (3000)  /* Bootloader and setup() after the reset by the port opening */
+#define RESPONSE_TIMEOUT  (2000)  /* ms */
+#define RETRIES           (3)
+
+static const char *const DayNames[7] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+
+static uint32_t HostMs() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char *StatusText(uint8_t status) {
+    switch (status) {
+        case CONFIG_STATUS_OK:         return "ok";
+        case CONFIG_STATUS_BAD_CRC:    return "bad CRC";
+        case CONFIG_STATUS_BAD_LENGTH: return "bad length";
+        case CONFIG_STATUS_BAD_VALUE:  return "value out of range";
+        case CONFIG_STATUS_BAD_CMD:    return "unknown command";
+        case CONFIG_STATUS_VERSION:    return "configuration version not supported by the firmware";
+        default:                       return "unknown status";
+    }
+}
+
+/* ---- Configuration file ---- */
+
+static bool ParseDays(const char *text, uint8_t &days) {
+    if (!strcmp(text, "all")) {
+        days = 0x7F;
+        return true;
+    }
+    days = 0;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", text);
+    for (char *save = nullptr, *tok = strtok_r(buf, ",", &save); tok != nullptr; tok = strtok_r(nullptr, ",", &save)) {
+        bool found = false;
+        for (uint8_t d = 0; d < 7; d++) {
+            if (!strcmp(tok, DayNames[d])) {
+                days |= (1U << d);
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return days != 0;
+}
+
+static bool LoadConfigFile(const char *path, ConfigImage &image) {
+    FILE *f = fopen(path, "r");
+    if (f == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    memset(&image, 0, sizeof(image));
+    image.version = CONFIG_IMAGE_VERSION;
+
+    char line[256];
+    unsigned lineNo = 0;
+    uint8_t windows = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char key[32], arg1[64], arg2[32];
+        int n = sscanf(line, " %31s %63s %31s", key, arg1, arg2);
+        if ((n <= 0) || (key[0] == '#')) {
+            continue;
+        }
+        unsigned h, m, s, h2, m2;
+        if ((!strcmp(key, "pump1_cycle") || !strcmp(key, "pump2_cycle")) && (n == 2) &&
+            (sscanf(arg1, "%u:%u:%u", &h, &m, &s) == 3) && (h <= 23) && (m <= 59) && (s <= 59)) {
+            uint8_t pump = (key[4] == '1') ? 0 : 1;
+            image.cycles[pump].hour = h;
+            image.cycles[pump].minute = m;
+            image.cycles[pump].second = s;
+        } else if (!strcmp(key, "window") && (n == 3) && (windows < CONFIG_NUM_WINDOWS) &&
+                   ParseDays(arg1, image.windows[windows].days) &&
+                   (sscanf(arg2, "%u:%u-%u:%u", &h, &m, &h2, &m2) == 4) && (h <= 23) && (m <= 59) && (h2 <= 23) && (m2 <= 59)) {
+            image.windows[windows].startHour = h;
+            image.windows[windows].startMinute = m;
+            image.windows[windows].endHour = h2;
+            image.windows[windows].endMinute = m2;
+            windows++;
+        } else {
+            fprintf(stderr, "%s:%u: invalid setting: %s", path, lineNo, line);
+            ok = false;
+        }
+    }
+    fclose(f);
+    return ok && (ConfigLink_ValidateImage(image) == CONFIG_STATUS_OK);
+}
+
+static void PrintConfig(const ConfigImage &image) {
+    for (uint8_t i = 0; i < CONFIG_NUM_PUMPS; i++) {
+        printf("pump%u_cycle %02u:%02u:%02u\n", i + 1, image.cycles[i].hour, image.cycles[i].minute, image.cycles[i].second);
+    }
+    for (uint8_t i = 0; i < CONFIG_NUM_WINDOWS; i++) {
+        uint8_t days = image.windows[i].days;
+        if ((days == 0) || (days & 0x80)) {
+            continue;
+        }
+        char list[32] = "";
+        if (days == 0x7F) {
+            snprintf(list, sizeof(list), "all");
+        } else {
+            for (uint8_t d = 0; d < 7; d++) {
+                if (days & (1U << d)) {
+                    strcat(list, list[0] ? "," : "");
+                    strcat(list, DayNames[d]);
+                }
+            }
+        }
+        printf("window %s %02u:%02u-%02u:%02u\n", list, image.windows[i].startHour, image.windows[i].startMinute,
+               image.windows[i].endHour, image.windows[i].endMinute);
+    }
+}
+
+/* ---- Serial port ---- */
+
+static int OpenPort(const char *path, unsigned baud) {
+    speed_t speed;
+    switch (baud) {
+        case 9600:   speed = B9600;   break;
+        case 19200:  speed = B19200;  break;
+        case 38400:  speed = B38400;  break;
+        case 57600:  speed = B57600;  break;
+        case 115200: speed = B115200; break;
+        default:
+            fprintf(stderr, "unsupported baud rate %u\n", baud);
+            return -1;
+    }
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        perror("tcgetattr");
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        perror("tcsetattr");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Sends a request and waits for its response, the log text of the board is skipped.
+ * @return True with the response payload, false if the board did not answer after the retries.
+ */
+static bool Transact(int fd, uint8_t command, const uint8_t *payload, uint8_t length, uint8_t *response, uint8_t &responseLength) {
+    uint8_t frame[CONFIG_LINK_FRAME_MAX];
+    uint8_t frameLength = ConfigLink_BuildFrame(command, payload, length, frame);
+
+    for (int attempt = 0; attempt < RETRIES; attempt++) {
+        tcflush(fd, TCIFLUSH);
+        if (write(fd, frame, frameLength) != frameLength) {
+            perror("write");
+            return false;
+        }
+        ConfigLinkParser parser;
+        uint32_t start = HostMs();
+        while (HostMs() - start < RESPONSE_TIMEOUT) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            uint8_t buf[64];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            for (ssize_t i = 0; i < n; i++) {
+                ConfigLinkResult_t result = parser.Feed(buf[i], HostMs());
+                if ((result != CONFIG_LINK_FRAME) || (parser.getCommand() != (command | CONFIG_CMD_RESPONSE)) ||
+                    (parser.getPayloadLength() < 1)) {
+                    continue;
+                }
+                if (parser.getPayload()[0] == CONFIG_STATUS_BAD_CRC) {
+                    break;  /* The request was damaged on the way, send it again */
+                }
+                responseLength = parser.getPayloadLength();
+                memcpy(response, parser.getPayload(), responseLength);
+                return true;
+            }
+        }
+        fprintf(stderr, "no valid response, attempt %d of %d\n", attempt + 1, RETRIES);
+    }
+    return false;
+}
+
+static bool ReadImage(int fd, ConfigImage &image) {
+    uint8_t response[CONFIG_LINK_PAYLOAD_MAX];
+    uint8_t length = 0;
+    if (!Transact(fd, CONFIG_CMD_READ, nullptr, 0, response, length)) {
+        return false;
+    }
+    if ((response[0] != CONFIG_STATUS_OK) || (length != 1 + sizeof(image))) {
+        fprintf(stderr, "read failed: %s\n", StatusText(response[0]));
+        return false;
+    }
+    memcpy(&image, &response[1], sizeof(image));
+    return true;
+}
+
+static bool WriteImage(int fd, const ConfigImage &image) {
+    uint8_t response[CONFIG_LINK_PAYLOAD_MAX];
+    uint8_t length = 0;
+    if (!Transact(fd, CONFIG_CMD_WRITE, (const uint8_t *)&image, sizeof(image), response, length)) {
+        return false;
+    }
+    if (response[0] != CONFIG_STATUS_OK) {
+        fprintf(stderr, "write failed: %s\n", StatusText(response[0]));
+        return false;
+    }
+
+    /** The board answers before the NVM task saved the image, give it the EEPROM write time */
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ConfigImage stored;
+    if (!ReadImage(fd, stored)) {
+        return false;
+    }
+    if (memcmp(&stored, &image, sizeof(image)) != 0) {
+        fprintf(stderr, "verify failed, the board stored:\n");
+        PrintConfig(stored);
+        return false;
+    }
+    printf("configuration written and verified\n");
+    return true;
+}
+
+static bool SetTime(int fd) {
+    /** The DS3231 keeps the local time, sent on a second boundary so the board is not late by a fraction */
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    std::this_thread::sleep_for(std::chrono::nanoseconds(1000000000L - ts.tv_nsec));
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    uint32_t localTime = (uint32_t)timegm(&local);
+
+    uint8_t payload[4] = {(uint8_t)localTime, (uint8_t)(localTime >> 8), (uint8_t)(localTime >> 16), (uint8_t)(localTime >> 24)};
+    uint8_t response[CONFIG_LINK_PAYLOAD_MAX];
+    uint8_t length = 0;
+    if (!Transact(fd, CONFIG_CMD_SET_TIME, payload, sizeof(payload), response, length)) {
+        return false;
+    }
+    if (response[0] != CONFIG_STATUS_OK) {
+        fprintf(stderr, "set time failed: %s\n", StatusText(response[0]));
+        return false;
+    }
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    printf("clock set to %s\n", text);
+    return true;
+}
+
+static int Usage(const char *name) {
+    fprintf(stderr, "usage: %s PORT [--baud N] provision FILE | write FILE | read | time\n"
+                    "       %s check FILE\n", name, name);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    if ((argc == 3) && !strcmp(argv[1], "check")) {
+        ConfigImage image;
+        if (!LoadConfigFile(argv[2], image)) {
+            return 1;
+        }
+        PrintConfig(image);
+        return 0;
+    }
+    if (argc < 3) {
+        return Usage(argv[0]);
+    }
+
+    const char *port = argv[1];
+    unsigned baud = 9600;
+    int arg = 2;
+    if ((argc > arg + 1) && !strcmp(argv[arg], "--baud")) {
+        baud = strtoul(argv[arg + 1], nullptr, 10);
+        arg += 2;
+    }
+    if (arg >= argc) {
+        return Usage(argv[0]);
+    }
+    const char *command = argv[arg];
+    const char *file = (arg + 1 < argc) ? argv[arg + 1] : nullptr;
+    bool needsFile = !strcmp(command, "provision") || !strcmp(command, "write");
+    if ((needsFile && (file == nullptr)) ||
+        (!needsFile && strcmp(command, "read") && strcmp(command, "time"))) {
+        return Usage(argv[0]);
+    }
+
+    ConfigImage image;
+    if (needsFile && !LoadConfigFile(file, image)) {
+        return 1;
+    }
+
+    int fd = OpenPort(port, baud);
+    if (fd < 0) {
+        return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(START_UP_WAIT_MS));
+
+    bool ok;
+    if (!strcmp(command, "read")) {
+        ok = ReadImage(fd, image);
+        if (ok) {
+            PrintConfig(image);
+        }
+    } else if (!strcmp(command, "time")) {
+        ok = SetTime(fd);
+    } else if (!strcmp(command, "write")) {
+        ok = WriteImage(fd, image);
+    } else {
+        ok = WriteImage(fd, image) && SetTime(fd);
+    }
+    close(fd);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+/*
+ * Monte Carlo parameter sweep of the pump control, run on a PC.
+ *
+ * Every parameter set is simulated against the same randomized scenarios (cistern, well, pump
+ * flow, daily demand and sensor glitches) over a simulated year. The firmware scheduler and the
+ * debounce of DigitalSensor::PollSensorState() are mirrored here, the pumps are driven by the real
+ * PumpControl class in the sensors or timer mode. The parameter sets that are not dominated on
+ * pump starts, dry run time, fill latency and wear imbalance are printed.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++17 -O2 -pthread -Itools/host -Iinclude tools/sweep/PumpSweep.cpp src/DAL/PumpControl.cpp \
+ *       src/DAL/WellRecovery.cpp src/DAL/DemandBoost.cpp src/DAL/PumpStats.cpp src/DAL/utilities.cpp \
+ *       -o pump_sweep
+ * Run:
+ *   ./pump_sweep [--days N] [--scenarios N] [--random N] [--threads N] [--seed N] [--csv file]
+ */
+
+#include <Arduino.h>
+#include "PumpControl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define MS_PER_MIN      (60000.0)
+#define MS_PER_DAY      (86400000ULL)
+#define DEMAND_BLOCK_MS (900000ULL)  /* Demand rate is constant over blocks of 15 minutes */
+
+/* Firmware parameters of one run, cycleMin = 0 for the sensor mode, the cycle of both pumps in the timer mode otherwise */
+struct Params {
+    uint32_t pollMs;
+    uint32_t controlMs;
+    uint32_t debounceMs;
+    uint32_t cycleMin;
+};
+
+/* Results per simulated year, averaged over the scenarios */
+struct Metrics {
+    double starts = 0;         /* Pump starts */
+    double dryRunS = 0;        /* Pump on with the well drawn down to the intake */
+    double fillLatencyS = 0;   /* Mean time from the cistern at its low level to full */
+    double wearImbalance = 0;  /* |runtime 1 - runtime 2| / total runtime */
+    double cisternEmptyS = 0;  /* Demand not served, for information */
+};
+
+/* Physical installation and use, drawn at random per scenario */
+struct Scenario {
+    uint64_t seed;
+    double cisternCapL;
+    double pumpLpm[2];
+    double wellCapL;
+    double wellRechargeLpm;
+    double dailyDemandL;
+    double glitchPerHour;     /* Sensor glitches per hour and sensor */
+    double glitchMaxMs;
+};
+
+static const double HourlyDemandWeight[24] = {
+    0.2, 0.2, 0.2, 0.2, 0.2, 0.4, 2.5, 3.0, 2.0, 1.0, 1.0, 1.0,
+    1.5, 1.5, 1.0, 1.0, 1.0, 1.2, 2.0, 2.5, 2.0, 1.2, 0.5, 0.3
+};
+
+static Scenario MakeScenario(uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    Scenario s;
+    s.seed = seed;
+    s.cisternCapL = 1000 + 4000 * u(rng);
+    double lpm = 30 + 30 * u(rng);
+    s.pumpLpm[0] = lpm * (0.9 + 0.2 * u(rng));
+    s.pumpLpm[1] = lpm * (0.9 + 0.2 * u(rng));
+    s.wellCapL = 200 + 1800 * u(rng);
+    s.wellRechargeLpm = 10 + 70 * u(rng);
+    s.dailyDemandL = 500 + 2500 * u(rng);
+    s.glitchPerHour = 6 * u(rng);
+    s.glitchMaxMs = 20 + 380 * u(rng);
+    return s;
+}
+
+/* Level sensor reading with random glitches, the reading is inverted while a glitch lasts */
+class GlitchSource
+{
+private:
+    std::mt19937_64 rng;
+    double meanGapMs;
+    double maxMs;
+public:
+    uint64_t startMs = UINT64_MAX;
+    uint64_t endMs = 0;
+
+    GlitchSource(uint64_t seed, double perHour, double glitchMaxMs) : rng(seed), maxMs(glitchMaxMs) {
+        meanGapMs = (perHour > 0) ? 3600000.0 / perHour : 0;
+        Schedule(0);
+    }
+    void Schedule(uint64_t afterMs) {
+        if (meanGapMs <= 0) {
+            startMs = UINT64_MAX;
+            return;
+        }
+        std::exponential_distribution<double> gap(1.0 / meanGapMs);
+        std::uniform_real_distribution<double> len(10.0, maxMs);
+        startMs = afterMs + (uint64_t)gap(rng) + 1;
+        endMs = startMs + (uint64_t)len(rng);
+    }
+    bool Active(uint64_t nowMs) {
+        while (nowMs >= endMs && startMs != UINT64_MAX) {
+            Schedule(endMs);
+        }
+        return (nowMs >= startMs) && (nowMs < endMs);
+    }
+};
+
+/* Same algorithm as DigitalSensor::PollSensorState(), with the delay as a parameter */
+struct DebouncedInput {
+    bool state = false;
+    uint32_t lastActiveMs = 0;
+
+    void Poll(bool raw, uint32_t nowMs, uint32_t debounceMs) {
+        if (raw && (nowMs - lastActiveMs > debounceMs)) {
+            lastActiveMs = nowMs;
+            state = true;
+        } else if (!raw) {
+            state = false;
+        }
+    }
+};
+
+/* PumpControl in the sensors mode, or the timer mode with the same cycle time for both pumps. The
+ * installation has no schedule, faults, coordination, level transducer or buttons */
+class Controller
+{
+private:
+    WellRecovery wellRecovery;
+    DemandBoost demandBoost;
+    PumpStats pumpStats;
+    PumpControl control;
+    CtrlModeSel_t mode;
+    uint32_t budgetsMs[PUMP_CONTROL_NUM_PUMPS];
+public:
+    bool pump[2] = {false, false};
+
+    Controller(const Params &p) : control(wellRecovery, demandBoost, pumpStats) {
+        mode = (p.cycleMin == 0) ? CTRL_AUTO_BY_SENSORS : CTRL_AUTO_BY_TIMER;
+        budgetsMs[0] = p.cycleMin * 60000UL;
+        budgetsMs[1] = p.cycleMin * 60000UL;
+    }
+
+    /* With the cistern reading full and both pumps off, the next tick cannot start a pump */
+    bool isIdle() {
+        return !pump[0] && !pump[1];
+    }
+
+    void Tick(bool wellEmpty, bool cisternEmpty, uint32_t nowMs) {
+        PumpControlInputs in;
+        in.wellEmpty = wellEmpty;
+        in.cisternEmpty = cisternEmpty;
+        in.pumpSelButton = false;
+        in.fault = false;
+        in.scheduleAllowed = true;
+        in.coordAssigned = PUMP_CONTROL_NOT_COORDINATED;
+        in.prefill = false;
+        mode = control.Tick(mode, in, budgetsMs, nowMs);
+        pump[0] = control.isPumpOn(0);
+        pump[1] = control.isPumpOn(1);
+    }
+};
+
+static uint64_t CeilTo(uint64_t t, uint64_t period) {
+    return (t + period - 1) / period * period;
+}
+
+/**
+ * Simulates one parameter set against one scenario. While the pumps are off and no sensor edge
+ * is pending the time jumps to the next physical event, otherwise the poll and control ticks
+ * are stepped on their own grids like the firmware scheduler.
+ */
+static Metrics Simulate(const Params &p, const Scenario &s, uint32_t days) {
+    const double cisternLowL = 0.25 * s.cisternCapL;   /* Float drops to empty below this */
+    const double cisternHighL = 0.90 * s.cisternCapL;  /* and rises to full above this */
+    const double wellSensorL = 0.20 * s.wellCapL;      /* Well sensor above the pump intake */
+    const uint64_t endMs = days * MS_PER_DAY;
+
+    std::mt19937_64 demandRng(s.seed ^ 0xD3A1D);
+    std::uniform_real_distribution<double> blockFactor(0.3, 1.7);
+    std::uniform_real_distribution<double> dayFactor(0.7, 1.3);
+    double weightSum = 0;
+    for (double w : HourlyDemandWeight) {
+        weightSum += w;
+    }
+    GlitchSource cisternGlitch(s.seed ^ 0xC15, s.glitchPerHour, s.glitchMaxMs);
+    GlitchSource wellGlitch(s.seed ^ 0x3E11, s.glitchPerHour, s.glitchMaxMs);
+
+    Controller ctrl(p);
+    DebouncedInput cisternIn;
+    DebouncedInput wellIn;
+
+    double cisternL = s.cisternCapL;
+    double wellL = s.wellCapL;
+    bool cisternRawEmpty = false;
+    double todayFactor = dayFactor(demandRng);
+    double demandLpms = 0;
+    uint64_t blockEndMs = 0;
+
+    bool prevPump[2] = {false, false};
+    uint64_t startCount = 0;
+    double runMs[2] = {0, 0};
+    double dryMs = 0;
+    double emptyMs = 0;
+    bool filling = false;
+    uint64_t fillStartMs = 0;
+    double fillSumMs = 0;
+    uint64_t fills = 0;
+
+    uint64_t t = 0;
+    uint64_t nextPollMs = 0;
+    uint64_t nextControlMs = 0;
+
+    /* Moves the physics from t to target with the pump outputs held */
+    auto integrate = [&](uint64_t target) {
+        while (t < target) {
+            if (t >= blockEndMs) {
+                if ((t % MS_PER_DAY) < DEMAND_BLOCK_MS) {
+                    todayFactor = dayFactor(demandRng);
+                }
+                uint32_t hour = (uint32_t)((t % MS_PER_DAY) / 3600000ULL);
+                double dayLpms = s.dailyDemandL / (double)MS_PER_DAY;
+                demandLpms = dayLpms * HourlyDemandWeight[hour] * 24.0 / weightSum * todayFactor * blockFactor(demandRng);
+                blockEndMs = t - (t % DEMAND_BLOCK_MS) + DEMAND_BLOCK_MS;
+            }
+            uint64_t stepEnd = std::min(target, blockEndMs);
+            double dt = (double)(stepEnd - t);
+
+            double requestL = 0;
+            for (int i = 0; i < 2; i++) {
+                if (ctrl.pump[i]) {
+                    requestL += s.pumpLpm[i] / MS_PER_MIN * dt;
+                    runMs[i] += dt;
+                }
+            }
+            double availableL = wellL + s.wellRechargeLpm / MS_PER_MIN * dt;
+            double deliveredL = std::min(availableL, requestL);
+            if (requestL > 0) {
+                dryMs += dt * (ctrl.pump[0] + ctrl.pump[1]) * (1.0 - deliveredL / requestL);
+            }
+            wellL = std::min(availableL - deliveredL, s.wellCapL);
+
+            double drawnL = demandLpms * dt;
+            double newCisternL = cisternL + deliveredL - drawnL;
+            if (newCisternL < 0) {
+                if (drawnL > 0) {
+                    emptyMs += dt * (-newCisternL / drawnL);
+                }
+                newCisternL = 0;
+            }
+            cisternL = std::min(newCisternL, s.cisternCapL);
+            t = stepEnd;
+        }
+        if (cisternL < cisternLowL) {
+            cisternRawEmpty = true;
+            if (!filling) {
+                filling = true;
+                fillStartMs = t;
+            }
+        } else if (cisternL > cisternHighL) {
+            cisternRawEmpty = false;
+            if (filling) {
+                filling = false;
+                fillSumMs += (double)(t - fillStartMs);
+                fills++;
+            }
+        }
+    };
+
+    while (t < endMs) {
+        bool cisternRaw = cisternRawEmpty ^ cisternGlitch.Active(t);
+        bool wellRaw = (wellL < wellSensorL) ^ wellGlitch.Active(t);
+
+        /** Quiet: jump to the next block, glitch, or level crossing, then resume the ticks on their grids */
+        if (ctrl.isIdle() && !cisternRaw && !cisternIn.state && (wellRaw == wellIn.state)) {
+            uint64_t target = std::min({endMs, blockEndMs, cisternGlitch.startMs, wellGlitch.startMs});
+            if ((demandLpms > 0) && (cisternL > cisternLowL)) {
+                target = std::min(target, t + (uint64_t)((cisternL - cisternLowL) / demandLpms) + 1);
+            }
+            if ((wellL < wellSensorL) && (s.wellRechargeLpm > 0)) {
+                target = std::min(target, t + (uint64_t)((wellSensorL - wellL) / (s.wellRechargeLpm / MS_PER_MIN)) + 1);
+            }
+            if (target > nextPollMs) {
+                integrate(target);
+                nextPollMs = CeilTo(t, p.pollMs);
+                nextControlMs = CeilTo(t, p.controlMs);
+                continue;
+            }
+        }
+
+        uint64_t target = std::min({nextPollMs, nextControlMs, endMs});
+        integrate(target);
+        if (t >= endMs) {
+            break;
+        }
+        if (t == nextPollMs) {
+            cisternIn.Poll(cisternRawEmpty ^ cisternGlitch.Active(t), (uint32_t)t, p.debounceMs);
+            wellIn.Poll((wellL < wellSensorL) ^ wellGlitch.Active(t), (uint32_t)t, p.debounceMs);
+            nextPollMs += p.pollMs;
+        }
+        if (t == nextControlMs) {
+            ctrl.Tick(wellIn.state, cisternIn.state, (uint32_t)t);
+            for (int i = 0; i < 2; i++) {
+                if (ctrl.pump[i] && !prevPump[i]) {
+                    startCount++;
+                }
+                prevPump[i] = ctrl.pump[i];
+            }
+            nextControlMs += p.controlMs;
+        }
+    }
+
+    double years = days / 365.0;
+    Metrics m;
+    m.starts = startCount / years;
+    m.dryRunS = dryMs / 1000.0 / years;
+    m.fillLatencyS = (fills > 0) ? fillSumMs / fills / 1000.0 : 0;
+    m.wearImbalance = (runMs[0] + runMs[1] > 0) ? std::fabs(runMs[0] - runMs[1]) / (runMs[0] + runMs[1]) : 0;
+    m.cisternEmptyS = emptyMs / 1000.0 / years;
+    return m;
+}
+
+/**
+ * Thread pool where every worker takes jobs from the back of its own queue and, once it is
+ * empty, steals from the front of the others, so long and short runs even out across the cores.
+ */
+class WorkStealingPool
+{
+private:
+    struct JobQueue {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+    std::vector<JobQueue> queues;
+
+    bool Take(size_t worker, size_t &job) {
+        {
+            std::lock_guard<std::mutex> guard(queues[worker].lock);
+            if (!queues[worker].jobs.empty()) {
+                job = queues[worker].jobs.back();
+                queues[worker].jobs.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++) {
+            JobQueue &victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+public:
+    explicit WorkStealingPool(size_t workers) : queues(workers) {}
+
+    void Run(size_t jobCount, const std::function<void(size_t)> &work) {
+        for (size_t j = 0; j < jobCount; j++) {
+            queues[j % queues.size()].jobs.push_back(j);
+        }
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < queues.size(); w++) {
+            threads.emplace_back([this, w, &work]() {
+                size_t job;
+                while (Take(w, job)) {
+                    work(job);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+static bool Dominates(const Metrics &a, const Metrics &b) {
+    bool noWorse = (a.starts <= b.starts) && (a.dryRunS <= b.dryRunS) &&
+                   (a.fillLatencyS <= b.fillLatencyS) && (a.wearImbalance <= b.wearImbalance);
+    bool better = (a.starts < b.starts) || (a.dryRunS < b.dryRunS) ||
+                  (a.fillLatencyS < b.fillLatencyS) || (a.wearImbalance < b.wearImbalance);
+    return noWorse && better;
+}
+
+static std::vector<Params> GridParams() {
+    static const uint32_t polls[] = {25, 50, 100, 200};
+    static const uint32_t controls[] = {100, 200, 500, 1000};
+    static const uint32_t debounces[] = {0, 50, 100, 250, 500};
+    static const uint32_t cycles[] = {0, 5, 15, 30, 60};
+    std::vector<Params> list;
+    for (uint32_t poll : polls) {
+        for (uint32_t control : controls) {
+            if (control < poll) {
+                continue;
+            }
+            for (uint32_t debounce : debounces) {
+                for (uint32_t cycle : cycles) {
+                    list.push_back({poll, control, debounce, cycle});
+                }
+            }
+        }
+    }
+    return list;
+}
+
+static std::vector<Params> RandomParams(size_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint32_t> poll(10, 250);
+    std::uniform_int_distribution<uint32_t> debounce(0, 1000);
+    std::uniform_int_distribution<uint32_t> cycle(0, 90);
+    std::vector<Params> list;
+    for (size_t i = 0; i < count; i++) {
+        Params p;
+        p.pollMs = poll(rng);
+        p.controlMs = p.pollMs * std::uniform_int_distribution<uint32_t>(1, 10)(rng);
+        p.debounceMs = debounce(rng);
+        p.cycleMin = cycle(rng);
+        p.cycleMin = (p.cycleMin < 3) ? 0 : p.cycleMin;  /* Sensor mode for a share of the sets */
+        list.push_back(p);
+    }
+    return list;
+}
+
+static void PrintRow(FILE *out, const Params &p, const Metrics &m, const char *sep) {
+    fprintf(out, "%u%s%u%s%u%s%u%s%.0f%s%.0f%s%.0f%s%.3f%s%.0f\n",
+            p.pollMs, sep, p.controlMs, sep, p.debounceMs, sep, p.cycleMin, sep,
+            m.starts, sep, m.dryRunS, sep, m.fillLatencyS, sep, m.wearImbalance, sep, m.cisternEmptyS);
+}
+
+int main(int argc, char **argv) {
+    uint32_t days = 365;
+    uint32_t scenarios = 8;
+    size_t randomCount = 0;
+    uint64_t seed = 1;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const char *csvPath = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        unsigned long long value = strtoull(argv[i + 1], nullptr, 10);
+        if (opt == "--days") {
+            days = (uint32_t)value;
+        } else if (opt == "--scenarios") {
+            scenarios = (uint32_t)value;
+        } else if (opt == "--random") {
+            randomCount = (size_t)value;
+        } else if (opt == "--threads") {
+            threads = std::max(1u, (unsigned)value);
+        } else if (opt == "--seed") {
+            seed = value;
+        } else if (opt == "--csv") {
+            csvPath = argv[i + 1];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::vector<Params> params = (randomCount > 0) ? RandomParams(randomCount, seed) : GridParams();
+    std::vector<Scenario> scenarioList;
+    for (uint32_t i = 0; i < scenarios; i++) {
+        scenarioList.push_back(MakeScenario(seed * 1000003ULL + i));
+    }
+
+    /** One job per parameter set and scenario, summed per parameter set afterwards */
+    std::vector<Metrics> runs(params.size() * scenarioList.size());
+    std::atomic<size_t> done(0);
+    auto startTime = std::chrono::steady_clock::now();
+    WorkStealingPool pool(threads);
+    pool.Run(runs.size(), [&](size_t job) {
+        runs[job] = Simulate(params[job / scenarioList.size()], scenarioList[job % scenarioList.size()], days);
+        size_t n = ++done;
+        if (n % 256 == 0) {
+            fprintf(stderr, "\r%zu / %zu runs", n, runs.size());
+        }
+    });
+    double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    fprintf(stderr, "\r%zu runs of %u days on %u threads in %.1f s\n", runs.size(), days, threads, elapsedS);
+
+    std::vector<Metrics> results(params.size());
+    for (size_t i = 0; i < runs.size(); i++) {
+        Metrics &r = results[i / scenarioList.size()];
+        const Metrics &m = runs[i];
+        double n = (double)scenarioList.size();
+        r.starts += m.starts / n;
+        r.dryRunS += m.dryRunS / n;
+        r.fillLatencyS += m.fillLatencyS / n;
+        r.wearImbalance += m.wearImbalance / n;
+        r.cisternEmptyS += m.cisternEmptyS / n;
+    }
+
+    if (csvPath != nullptr) {
+        FILE *csv = fopen(csvPath, "w");
+        if (csv == nullptr) {
+            fprintf(stderr, "Cannot write %s\n", csvPath);
+            return 1;
+        }
+        fprintf(csv, "poll_ms,control_ms,debounce_ms,cycle_min,starts,dry_run_s,fill_latency_s,wear_imbalance,cistern_empty_s\n");
+        for (size_t i = 0; i < params.size(); i++) {
+            PrintRow(csv, params[i], results[i], ",");
+        }
+        fclose(csv);
+    }
+
+    std::vector<size_t> front;
+    for (size_t i = 0; i < results.size(); i++) {
+        bool dominated = false;
+        for (size_t j = 0; (j < results.size()) && !dominated; j++) {
+            dominated = (j != i) && Dominates(results[j], results[i]);
+        }
+        if (!dominated) {
+            front.push_back(i);
+        }
+    }
+    std::sort(front.begin(), front.end(), [&](size_t a, size_t b) { return results[a].starts < results[b].starts; });
+
+    printf("Pareto front: %zu of %zu parameter sets, per year averaged over %u scenarios (cycle 0 = sensor mode)\n",
+           front.size(), params.size(), scenarios);
+    printf("poll_ms\tctrl_ms\tdebounce\tcycle_min\tstarts\tdry_run_s\tfill_s\twear\tempty_s\n");
+    for (size_t i : front) {
+        PrintRow(stdout, params[i], results[i], "\t");
+    }
+    return 0;
+}